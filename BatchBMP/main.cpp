@@ -0,0 +1,524 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../ImageBMP/ImageBMP.h"
+#include "../ImageBMP/AsyncImageWriter.h"
+
+using namespace std;
+
+/*
+BatchBMP - applies one list of operations to many BMP files, with no prompts (for scripts and nightly jobs)
+
+    BatchBMP <manifest> [more input files or folders...] [--workers N] [--readers N] [--queue N]
+
+The manifest has one entry per line ('#' starts a comment):
+    output <folder>                              where the results go, under the same file names (default: batch_output)
+    workers <N>, readers <N>, queue <N>          same as the options (the options win)
+    limits <max width> <max height> <max pixels> larger inputs fail to decode, before their pixels are allocated
+    input <file or folder>                       a folder means every .bmp in it (two inputs may not share a file name)
+    convert <32|24|565|555|8>                    output bit depth
+    resize <width> <height>                      nearest neighbour
+    rotate <90|180|270>                          clockwise
+    fill <x> <y> <width> <height> <AARRGGBB>
+    text <x> <y> <scale> <AARRGGBB> <text...>    glyphs A-H and 1-8 (see drawPixelText)
+The operations are applied to every input, in the order they are listed.
+
+Three stages, with bounded queues between them (a slow stage holds the others back instead of filling memory):
+    reader threads  - load the file bytes
+    worker threads  - decode, apply the operations
+    one writer      - encode and write (AsyncImageWriter)
+*/
+
+struct Operation {
+    enum class Kind { Convert, Resize, Rotate, Fill, Text };
+
+    Kind kind;
+    vector<int> numbers;
+    Color color;
+    string text;
+    PixelFormat format = PixelFormat::BGRA32;
+};
+
+struct BatchSettings {
+    string outputFolder = "batch_output";
+    vector<string> inputs;
+    vector<Operation> operations;
+    unsigned int workers = 0;  // 0 -> one per hardware thread
+    unsigned int readers = 2;
+    unsigned int queueSize = 16;
+    DecodeLimits limits;  // unlimited unless the manifest sets them
+};
+
+// A queue that blocks the producer when full and the consumer when empty - until close()
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(max<size_t>(capacity, 1)) {}
+
+    void push(T item) {
+        unique_lock<mutex> lock(guard);
+        notFull.wait(lock, [this] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    // false once the queue is closed AND empty
+    bool pop(T& item) {
+        unique_lock<mutex> lock(guard);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        lock_guard<mutex> lock(guard);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+private:
+    size_t capacity;
+    deque<T> items;
+    bool closed = false;
+    mutex guard;
+    condition_variable notFull;
+    condition_variable notEmpty;
+};
+
+struct ReadFile {
+    size_t index = 0;
+    vector<unsigned char> bytes;
+    BMPError error = BMPError::None;
+};
+
+// Time spent in each stage, summed over its threads
+struct StageTimes {
+    atomic<long long> readNanoseconds{ 0 };
+    atomic<long long> processNanoseconds{ 0 };
+    atomic<unsigned long long> bytesRead{ 0 };
+};
+
+class StageTimer {
+public:
+    explicit StageTimer(atomic<long long>& total) : total(total), start(chrono::steady_clock::now()) {}
+    ~StageTimer() {
+        total += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    atomic<long long>& total;
+    chrono::steady_clock::time_point start;
+};
+
+static bool isBMPFile(const filesystem::path& path) {
+    string extension = path.extension().string();
+    transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)tolower(c); });
+    return extension == ".bmp";
+}
+
+static void addInput(const string& path, vector<string>& inputs) {
+    error_code error;
+    if (filesystem::is_directory(path, error)) {
+        vector<string> files;
+        for (auto& entry : filesystem::directory_iterator(path, error)) {
+            if (entry.is_regular_file() && isBMPFile(entry.path())) {
+                files.push_back(entry.path().string());
+            }
+        }
+        sort(files.begin(), files.end());
+        inputs.insert(inputs.end(), files.begin(), files.end());
+    } else {
+        inputs.push_back(path);
+    }
+}
+
+// Outputs keep only the file name, so two inputs with the same name from different folders would overwrite each other
+static bool checkOutputNames(const vector<string>& inputs) {
+    map<string, string> inputFor;  // output file name -> the input written to it
+    bool ok = true;
+    for (const string& input : inputs) {
+        string name = filesystem::path(input).filename().string();
+        auto [taken, added] = inputFor.emplace(name, input);
+        if (!added) {
+            cerr << taken->second << " and " << input << " would both be written to " << name << "\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Digits only - so "-1", "4x" or a number too big for 32 bits are rejected instead of wrapping or throwing
+static bool parseCount(const string& text, unsigned int& value) {
+    if (text.empty() || !all_of(text.begin(), text.end(), [](unsigned char c) { return isdigit(c) != 0; })) {
+        return false;
+    }
+    istringstream digits(text);
+    return (bool)(digits >> value);
+}
+
+static bool parseColor(const string& hex, Color& color) {
+    if (hex.size() != 8 || !all_of(hex.begin(), hex.end(), [](unsigned char c) { return isxdigit(c) != 0; })) {
+        return false;
+    }
+    color = Color((unsigned int)stoul(hex, nullptr, 16));
+    return true;
+}
+
+static bool parseFormat(const string& bits, PixelFormat& format) {
+    if (bits == "32") format = PixelFormat::BGRA32;
+    else if (bits == "24") format = PixelFormat::BGR24;
+    else if (bits == "565" || bits == "16") format = PixelFormat::RGB565;
+    else if (bits == "555") format = PixelFormat::RGB555;
+    else if (bits == "8") format = PixelFormat::Gray8;
+    else return false;
+    return true;
+}
+
+// Reads `count` integers from the line - false if there aren't that many
+static bool readNumbers(istringstream& line, size_t count, vector<int>& numbers) {
+    numbers.resize(count);
+    for (auto& number : numbers) {
+        if (!(line >> number)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Problems are reported as "manifest:line: ..." and make the whole run stop before anything is read
+static bool readManifest(const string& manifestPath, BatchSettings& settings) {
+    ifstream manifest(manifestPath);
+    if (!manifest) {
+        cerr << "Cannot open manifest " << manifestPath << "\n";
+        return false;
+    }
+
+    string text;
+    int lineNumber = 0;
+    while (getline(manifest, text)) {
+        ++lineNumber;
+        text = text.substr(0, text.find('#'));
+
+        istringstream line(text);
+        string keyword;
+        if (!(line >> keyword)) {
+            continue;  // blank or comment
+        }
+
+        Operation operation;
+        bool ok = true;
+
+        if (keyword == "output") {
+            ok = (bool)(line >> settings.outputFolder);
+        } else if (keyword == "input") {
+            string path;
+            ok = (bool)(line >> ws) && getline(line, path) && !path.empty();
+            if (ok) {
+                addInput(path, settings.inputs);
+            }
+        } else if (keyword == "workers") {
+            ok = (bool)(line >> settings.workers);
+        } else if (keyword == "readers") {
+            ok = (bool)(line >> settings.readers) && settings.readers > 0;
+        } else if (keyword == "queue") {
+            ok = (bool)(line >> settings.queueSize) && settings.queueSize > 0;
+        } else if (keyword == "limits") {
+            DecodeLimits& limits = settings.limits;
+            ok = (bool)(line >> limits.maxWidth >> limits.maxHeight >> limits.maxPixels);
+        } else if (keyword == "convert") {
+            string bits;
+            operation.kind = Operation::Kind::Convert;
+            ok = (line >> bits) && parseFormat(bits, operation.format);
+            settings.operations.push_back(operation);
+        } else if (keyword == "resize") {
+            operation.kind = Operation::Kind::Resize;
+            ok = readNumbers(line, 2, operation.numbers) && operation.numbers[0] > 0 && operation.numbers[1] > 0;
+            settings.operations.push_back(operation);
+        } else if (keyword == "rotate") {
+            operation.kind = Operation::Kind::Rotate;
+            ok = readNumbers(line, 1, operation.numbers)
+                && (operation.numbers[0] == 90 || operation.numbers[0] == 180 || operation.numbers[0] == 270);
+            settings.operations.push_back(operation);
+        } else if (keyword == "fill") {
+            string hex;
+            operation.kind = Operation::Kind::Fill;
+            ok = readNumbers(line, 4, operation.numbers) && operation.numbers[2] >= 0 && operation.numbers[3] >= 0
+                && (line >> hex) && parseColor(hex, operation.color);
+            settings.operations.push_back(operation);
+        } else if (keyword == "text") {
+            string hex;
+            operation.kind = Operation::Kind::Text;
+            ok = readNumbers(line, 3, operation.numbers) && operation.numbers[2] > 0
+                && (line >> hex) && parseColor(hex, operation.color)
+                && (line >> ws) && getline(line, operation.text);
+            settings.operations.push_back(operation);
+        } else {
+            cerr << manifestPath << ":" << lineNumber << ": unknown entry '" << keyword << "'\n";
+            return false;
+        }
+
+        if (!ok) {
+            cerr << manifestPath << ":" << lineNumber << ": bad arguments for '" << keyword << "'\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// The format writeImageFile would use for this image now
+static PixelFormat outputFormatOf(const InfoHeader& header) {
+    switch (header.getBitsPerPixel()) {
+    case 24: return PixelFormat::BGR24;
+    case 16: return header.getSixteenBitLayout();
+    case 8: return PixelFormat::Gray8;
+    default: return PixelFormat::BGRA32;
+    }
+}
+
+// A blank image of the new size, writing the same format as `image`
+static ImageBMP blankLike(const ImageBMP& image, unsigned int width, unsigned int height) {
+    ImageBMP result(width, height, Color());
+    result.setOutputFormat(outputFormatOf(image.infoHeader));
+    return result;
+}
+
+static ImageBMP resized(const ImageBMP& image, unsigned int width, unsigned int height) {
+    ImageBMP result = blankLike(image, width, height);
+    unsigned int oldWidth = image.infoHeader.imageWidth;
+    unsigned int oldHeight = image.infoHeader.imageHeight;
+
+    vector<unsigned int> sourceColumn(width);
+    for (unsigned int x = 0; x < width; ++x) {
+        sourceColumn[x] = (unsigned int)((unsigned long long)x * oldWidth / width);
+    }
+
+    for (unsigned int y = 0; y < height; ++y) {
+        PixelRow<const Color> source = image.pixelData.pixelMatrix[(size_t)((unsigned long long)y * oldHeight / height)];
+        PixelRow<Color> destination = result.pixelData.pixelMatrix[y];
+        for (unsigned int x = 0; x < width; ++x) {
+            destination[x] = source[sourceColumn[x]];
+        }
+    }
+    return result;
+}
+
+static void applyOperations(ImageBMP& image, const vector<Operation>& operations) {
+    for (const Operation& operation : operations) {
+        switch (operation.kind) {
+        case Operation::Kind::Convert:
+            image.setOutputFormat(operation.format);
+            break;
+        case Operation::Kind::Resize:
+            image.untilePixelData();  // (resized reads rows - a rotate leaves the image tiled)
+            image = resized(image, (unsigned int)operation.numbers[0], (unsigned int)operation.numbers[1]);
+            break;
+        case Operation::Kind::Rotate:
+            // A quarter turn at a time, tile by tile (see ImageBMP::rotateClockwise) - the writer encodes tiled images directly
+            for (int turn = 0; turn < operation.numbers[0] / 90; ++turn) {
+                image.rotateClockwise();
+            }
+            break;
+        case Operation::Kind::Fill: {
+            // Clipped to the image, like the view it is drawn through
+            int x = max(operation.numbers[0], 0);
+            int y = max(operation.numbers[1], 0);
+            int width = operation.numbers[2] - (x - operation.numbers[0]);
+            int height = operation.numbers[3] - (y - operation.numbers[1]);
+            if (width > 0 && height > 0) {
+                image.view((unsigned int)x, (unsigned int)y, (unsigned int)width, (unsigned int)height).fill(operation.color);
+            }
+            break;
+        }
+        case Operation::Kind::Text:
+            drawPixelText(image.view(), operation.numbers[0], operation.numbers[1], operation.text, operation.color,
+                (unsigned int)operation.numbers[2]);
+            break;
+        }
+    }
+}
+
+static BMPError readFileBytes(const string& path, vector<unsigned char>& bytes) {
+    ifstream fin(path, ios::binary | ios::ate);
+    if (!fin) {
+        return BMPError::FileNotFound;
+    }
+    streamoff size = fin.tellg();
+    fin.seekg(0, ios::beg);
+    bytes.resize(size > 0 ? (size_t)size : 0);
+    fin.read(reinterpret_cast<char*>(bytes.data()), (streamsize)bytes.size());
+    return fin ? BMPError::None : BMPError::ReadFailed;
+}
+
+static void printUsage() {
+    cerr << "usage: BatchBMP <manifest> [more input files or folders...] [--workers N] [--readers N] [--queue N]\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printUsage();
+        return 2;
+    }
+
+    BatchSettings settings;
+    if (!readManifest(argv[1], settings)) {
+        return 2;
+    }
+
+    for (int i = 2; i < argc; ++i) {
+        string argument = argv[i];
+        if ((argument == "--workers" || argument == "--readers" || argument == "--queue") && i + 1 < argc) {
+            unsigned int value = 0;
+            if (!parseCount(argv[++i], value)) {
+                cerr << "Bad value for " << argument << ": " << argv[i] << "\n";
+                printUsage();
+                return 2;
+            }
+            if (argument == "--workers") settings.workers = value;
+            else if (argument == "--readers") settings.readers = max(value, 1u);
+            else settings.queueSize = max(value, 1u);
+        } else if (argument.rfind("--", 0) == 0) {
+            printUsage();
+            return 2;
+        } else {
+            addInput(argument, settings.inputs);
+        }
+    }
+
+    if (!checkOutputNames(settings.inputs)) {
+        return 2;
+    }
+
+    if (settings.workers == 0) {
+        settings.workers = max(thread::hardware_concurrency(), 1u);
+    }
+
+    error_code folderError;
+    filesystem::create_directories(settings.outputFolder, folderError);
+    if (folderError) {
+        cerr << "Cannot create " << settings.outputFolder << ": " << folderError.message() << "\n";
+        return 2;
+    }
+
+    const vector<string>& inputs = settings.inputs;
+    vector<future<BMPStatus>> written(inputs.size());
+    vector<BMPStatus> readStatus(inputs.size(), BMPError::None);
+    StageTimes times;
+
+    auto startTime = chrono::steady_clock::now();
+
+    {
+        BoundedQueue<ReadFile> readQueue(settings.queueSize);
+        AsyncImageWriter writer(settings.queueSize);
+        atomic<size_t> nextInput{ 0 };
+
+        // Stage 1: file bytes only - no decoding, so these threads mostly wait on the disk
+        vector<thread> readers;
+        atomic<unsigned int> readersLeft{ settings.readers };
+        for (unsigned int r = 0; r < settings.readers; ++r) {
+            readers.emplace_back([&] {
+                for (size_t i = nextInput++; i < inputs.size(); i = nextInput++) {
+                    ReadFile file;
+                    file.index = i;
+                    {
+                        StageTimer timer(times.readNanoseconds);
+                        file.error = readFileBytes(inputs[i], file.bytes);
+                    }
+                    times.bytesRead += file.bytes.size();
+                    readQueue.push(std::move(file));
+                }
+                if (--readersLeft == 0) {
+                    readQueue.close();
+                }
+            });
+        }
+
+        // Stage 2: decode + operations; stage 3 (encode + write) is the writer's thread
+        vector<thread> workers;
+        for (unsigned int w = 0; w < settings.workers; ++w) {
+            workers.emplace_back([&] {
+                ReadFile file;
+                while (readQueue.pop(file)) {
+                    ImageBMP image;
+                    BMPStatus status = file.error;
+                    {
+                        StageTimer timer(times.processNanoseconds);
+                        if (status) {
+                            status = image.decodeFromMemory(file.bytes.data(), file.bytes.size(), false, settings.limits);
+                        }
+                        if (status) {
+                            applyOperations(image, settings.operations);
+                        }
+                    }
+                    file.bytes = vector<unsigned char>();
+
+                    if (!status) {
+                        readStatus[file.index] = status;
+                        continue;
+                    }
+
+                    string outputPath = (filesystem::path(settings.outputFolder) / filesystem::path(inputs[file.index]).filename()).string();
+                    written[file.index] = writer.save(std::move(image), outputPath);  // (blocks while the writer is behind)
+                }
+            });
+        }
+
+        for (auto& reader : readers) reader.join();
+        for (auto& worker : workers) worker.join();
+        writer.waitUntilIdle();
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    size_t succeeded = 0;
+    unsigned long long bytesWritten = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        BMPStatus status = readStatus[i];
+        if (status && written[i].valid()) {
+            try {
+                status = written[i].get();
+            } catch (const exception& failure) {
+                cerr << inputs[i] << ": " << failure.what() << "\n";
+                continue;
+            }
+        }
+
+        if (!status) {
+            cerr << inputs[i] << ": " << status.message() << "\n";
+            continue;
+        }
+
+        ++succeeded;
+        error_code sizeError;
+        bytesWritten += filesystem::file_size(filesystem::path(settings.outputFolder) / filesystem::path(inputs[i]).filename(), sizeError);
+    }
+
+    double megabyte = 1024.0 * 1024.0;
+    cout << "files:      " << succeeded << " converted, " << inputs.size() - succeeded << " failed\n";
+    cout << "wall time:  " << seconds << " s (" << (seconds > 0 ? inputs.size() / seconds : 0) << " files/s)\n";
+    cout << "read:       " << times.bytesRead / megabyte << " MB ("
+         << (seconds > 0 ? times.bytesRead / megabyte / seconds : 0) << " MB/s)\n";
+    cout << "written:    " << bytesWritten / megabyte << " MB ("
+         << (seconds > 0 ? bytesWritten / megabyte / seconds : 0) << " MB/s)\n";
+    cout << "stage time: read " << times.readNanoseconds / 1e9 << " s over " << settings.readers << " threads, "
+         << "decode+operations " << times.processNanoseconds / 1e9 << " s over " << settings.workers << " threads\n";
+
+    return succeeded == inputs.size() ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+#include "AsyncImageWriter.h"
+#include "PixelBufferPool.h"
+
+#include<exception>
+#include<utility>
+
+AsyncImageWriter::AsyncImageWriter(size_t maxQueuedImages)
+	: maxQueuedImages(maxQueuedImages > 0 ? maxQueuedImages : 1), ioThread(&AsyncImageWriter::ioLoop, this)
+{
+}
+
+AsyncImageWriter::~AsyncImageWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobAdded.notify_all();
+
+	ioThread.join();
+}
+
+std::future<BMPStatus> AsyncImageWriter::save(ImageBMP&& image, const string& filename)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	jobTaken.wait(lock, [this] { return jobs.size() < maxQueuedImages; });
+
+	return enqueue(std::move(image), filename);
+}
+
+bool AsyncImageWriter::trySave(ImageBMP&& image, const string& filename, std::future<BMPStatus>& result)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	if (jobs.size() >= maxQueuedImages)
+	{
+		return false;
+	}
+
+	result = enqueue(std::move(image), filename);
+	return true;
+}
+
+std::future<BMPStatus> AsyncImageWriter::enqueue(ImageBMP&& image, const string& filename)
+{
+	//(caller holds the mutex)
+	jobs.push_back(Job{ std::move(image), filename, std::promise<BMPStatus>() });
+	std::future<BMPStatus> result = jobs.back().done.get_future();
+
+	jobAdded.notify_one();
+
+	return result;
+}
+
+void AsyncImageWriter::waitUntilIdle()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return jobs.empty() && !writing; });
+}
+
+size_t AsyncImageWriter::getQueuedCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return jobs.size();
+}
+
+void AsyncImageWriter::ioLoop()
+{
+	while (true)
+	{
+		Job job;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobAdded.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+			if (jobs.empty()) //(so stopping - and everything queued has been written)
+			{
+				return;
+			}
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+			writing = true;
+		}
+		jobTaken.notify_one();
+
+		//encode + write with no lock held - save() can queue the next frame meanwhile
+		try
+		{
+			job.done.set_value(job.image.tryWriteImageFile(job.filename));
+		}
+		catch (...)
+		{
+			job.done.set_exception(std::current_exception());
+		}
+
+		//the image (and its pixel buffer) goes now, not when the next job replaces it
+		//- a pooled buffer lands in THIS thread's cache, which only ever gives buffers back, so it is moved on to the shared shelves:
+		job.image = ImageBMP();
+		PixelBufferPool::instance().flushThreadCache();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			writing = false;
+		}
+		idle.notify_all();
+	}
+}
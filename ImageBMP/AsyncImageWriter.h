@@ -0,0 +1,65 @@
+#pragma once
+
+#include<condition_variable>
+#include<deque>
+#include<future>
+#include<mutex>
+#include<string>
+#include<thread>
+
+#include "ImageBMP.h"
+
+/*writes BMP files on a background I/O thread, so the caller can get on with the next frame
+- save() takes the image over (move it in, or pass image.clone() to keep drawing on the original)
+- at most maxQueuedImages wait to be written; save() blocks while the queue is full (backpressure),
+trySave() returns false instead
+- each save gets a future with the write's BMPStatus (or the exception it threw)
+
+with maxQueuedImages = 1 this is double buffering: one frame being written while the next is drawn
+- and canvases made with ImageBMP::makePooled hand their buffer back to the pool's shared shelves once written
+(not to the I/O thread's own cache), so the next frame - drawn on another thread - reuses it instead of allocating*/
+class AsyncImageWriter
+{
+public:
+	explicit AsyncImageWriter(size_t maxQueuedImages = 2);
+
+	/*writes whatever is still queued, then stops the thread*/
+	~AsyncImageWriter();
+
+	AsyncImageWriter(const AsyncImageWriter&) = delete;
+	AsyncImageWriter& operator=(const AsyncImageWriter&) = delete;
+
+	std::future<BMPStatus> save(ImageBMP&& image, const string& filename);
+
+	/*never blocks - false (and `image` untouched) if the queue is full*/
+	bool trySave(ImageBMP&& image, const string& filename, std::future<BMPStatus>& result);
+
+	/*returns once the queue is empty AND the last file is written*/
+	void waitUntilIdle();
+
+	size_t getQueuedCount() const;
+
+private:
+	struct Job
+	{
+		ImageBMP image;
+		string filename;
+		std::promise<BMPStatus> done;
+	};
+
+	void ioLoop();
+
+	std::future<BMPStatus> enqueue(ImageBMP&& image, const string& filename);
+
+	size_t maxQueuedImages;
+	std::deque<Job> jobs;
+	bool writing = false;
+	bool stopping = false;
+
+	mutable std::mutex mutex;
+	std::condition_variable jobAdded;
+	std::condition_variable jobTaken; //(room in the queue)
+	std::condition_variable idle;
+
+	std::thread ioThread; //(last, so everything above exists before it starts)
+};
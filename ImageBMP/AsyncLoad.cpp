@@ -0,0 +1,441 @@
+#include "AsyncLoad.h"
+
+#ifdef IMAGEBMP_HAS_COROUTINES
+
+#include<deque>
+#include<memory>
+#include<new>
+#include<thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include<cerrno>
+#include<fcntl.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#define IMAGEBMP_HAS_PREAD 1
+#endif
+
+//io_uring is opt-in: build with -DIMAGEBMP_USE_IO_URING and link with -luring
+#if defined(IMAGEBMP_USE_IO_URING) && defined(__linux__) && __has_include(<liburing.h>)
+#include<liburing.h>
+#define IMAGEBMP_HAS_IO_URING 1
+#endif
+
+namespace
+{
+	/*the whole file in one buffer - plain blocking reads, for the pread backend*/
+	BMPError readWholeFileBlocking(const string& path, vector<unsigned char>& fileBytes)
+	{
+#ifdef IMAGEBMP_HAS_PREAD
+		int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+		if (fd < 0)
+		{
+			return BMPError::FileNotFound;
+		}
+
+		struct stat fileInfo {};
+		BMPError error = BMPError::None;
+
+		if (fstat(fd, &fileInfo) != 0)
+		{
+			error = BMPError::ReadFailed;
+		}
+		else
+		{
+			fileBytes.resize((size_t)fileInfo.st_size);
+			size_t done = 0;
+
+			while (done < fileBytes.size())
+			{
+				ssize_t got = pread(fd, fileBytes.data() + done, fileBytes.size() - done, (off_t)done);
+
+				if (got < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				if (got <= 0)
+				{
+					//(0 = the file got shorter since fstat - decoding will report what is missing)
+					if (got < 0)
+					{
+						error = BMPError::ReadFailed;
+					}
+					fileBytes.resize(done);
+					break;
+				}
+
+				done += (size_t)got;
+			}
+		}
+
+		close(fd);
+		return error;
+#else
+		ifstream fin{ path, std::ios::binary | std::ios::ate };
+
+		if (!fin)
+		{
+			return BMPError::FileNotFound;
+		}
+
+		std::streamoff size = fin.tellg();
+		fin.seekg(0, std::ios::beg);
+
+		fileBytes.resize(size > 0 ? (size_t)size : 0);
+		fin.read(reinterpret_cast<char*>(fileBytes.data()), (std::streamsize)fileBytes.size());
+
+		return fin ? BMPError::None : BMPError::ReadFailed;
+#endif
+	}
+
+	/*blocking reads on a few dedicated threads - more than there are cores, since they mostly wait*/
+	class PreadFileReadService : public FileReadService
+	{
+		static constexpr unsigned int ioThreadCount = 8;
+
+		ThreadPool ioThreads{ ioThreadCount };
+
+	public:
+		void readWholeFile(const string& path, Callback onDone) override
+		{
+			ioThreads.submit([path, onDone = std::move(onDone)]
+				{
+					vector<unsigned char> fileBytes;
+					BMPError error;
+
+					try
+					{
+						error = readWholeFileBlocking(path, fileBytes);
+					}
+					catch (const std::bad_alloc&)
+					{
+						fileBytes = vector<unsigned char>();
+						error = BMPError::ReadFailed;
+					}
+
+					onDone(std::move(fileBytes), error);
+				});
+		}
+
+		const char* getBackendName() const override
+		{
+#ifdef IMAGEBMP_HAS_PREAD
+			return "pread";
+#else
+			return "ifstream";
+#endif
+		}
+	};
+
+#ifdef IMAGEBMP_HAS_IO_URING
+	/*one thread, one ring, up to ringSize reads in flight
+	- files are opened (and sized) on the ring thread, then read with a single IORING_OP_READ each (resubmitted if short)*/
+	class IoUringFileReadService : public FileReadService
+	{
+		static constexpr unsigned int ringSize = 256;
+
+		struct Request
+		{
+			string path;
+			Callback onDone;
+			int fd = -1;
+			vector<unsigned char> fileBytes;
+			size_t done = 0;
+		};
+
+		io_uring ring{};
+		bool ringReady = false;
+
+		std::mutex mutex;
+		std::condition_variable requestAdded;
+		std::deque<std::unique_ptr<Request>> pending; //(guarded by mutex)
+		bool stopping = false; //(guarded by mutex)
+
+		size_t inFlight = 0; //(ring thread only)
+
+		std::thread ringThread;
+
+		void finish(Request* request, BMPError error)
+		{
+			std::unique_ptr<Request> owned(request);
+
+			if (owned->fd >= 0)
+			{
+				close(owned->fd);
+			}
+			owned->onDone(std::move(owned->fileBytes), error);
+		}
+
+		void submitRead(Request* request)
+		{
+			io_uring_sqe* entry = io_uring_get_sqe(&ring); //(never null - at most ringSize reads are in flight)
+
+			io_uring_prep_read(entry, request->fd, request->fileBytes.data() + request->done,
+				(unsigned int)std::min<size_t>(request->fileBytes.size() - request->done, 1u << 30), request->done);
+			io_uring_sqe_set_data(entry, request);
+			++inFlight;
+		}
+
+		void start(std::unique_ptr<Request> request)
+		{
+			request->fd = open(request->path.c_str(), O_RDONLY | O_CLOEXEC);
+
+			if (request->fd < 0)
+			{
+				finish(request.release(), BMPError::FileNotFound);
+				return;
+			}
+
+			struct stat fileInfo {};
+
+			if (fstat(request->fd, &fileInfo) != 0)
+			{
+				finish(request.release(), BMPError::ReadFailed);
+				return;
+			}
+
+			try
+			{
+				request->fileBytes.resize((size_t)fileInfo.st_size);
+			}
+			catch (const std::bad_alloc&)
+			{
+				finish(request.release(), BMPError::ReadFailed);
+				return;
+			}
+
+			if (request->fileBytes.empty())
+			{
+				finish(request.release(), BMPError::None); //(decoding says what is wrong with an empty file)
+				return;
+			}
+
+			submitRead(request.release());
+		}
+
+		void complete(io_uring_cqe* completion)
+		{
+			Request* request = static_cast<Request*>(io_uring_cqe_get_data(completion));
+			int result = completion->res;
+			--inFlight;
+
+			if (result == -EINTR || result == -EAGAIN)
+			{
+				submitRead(request);
+				return;
+			}
+			if (result < 0)
+			{
+				finish(request, BMPError::ReadFailed);
+				return;
+			}
+			if (result == 0) //(the file got shorter since fstat)
+			{
+				request->fileBytes.resize(request->done);
+				finish(request, BMPError::None);
+				return;
+			}
+
+			request->done += (size_t)result;
+
+			if (request->done < request->fileBytes.size())
+			{
+				submitRead(request);
+			}
+			else
+			{
+				finish(request, BMPError::None);
+			}
+		}
+
+		void ringLoop()
+		{
+			while (true)
+			{
+				std::deque<std::unique_ptr<Request>> newRequests;
+
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+
+					if (inFlight == 0)
+					{
+						requestAdded.wait(lock, [this] { return stopping || !pending.empty(); });
+					}
+
+					if (stopping && pending.empty() && inFlight == 0)
+					{
+						return;
+					}
+
+					while (!pending.empty() && inFlight + newRequests.size() < ringSize)
+					{
+						newRequests.push_back(std::move(pending.front()));
+						pending.pop_front();
+					}
+				}
+
+				for (auto& request : newRequests)
+				{
+					start(std::move(request));
+				}
+
+				if (inFlight == 0)
+				{
+					continue;
+				}
+
+				io_uring_submit(&ring);
+
+				//wait a little for completions - then go back and pick up any new requests
+				io_uring_cqe* completion = nullptr;
+				__kernel_timespec timeout{ 0, 1'000'000 };
+
+				if (io_uring_wait_cqe_timeout(&ring, &completion, &timeout) == 0)
+				{
+					do
+					{
+						complete(completion);
+						io_uring_cqe_seen(&ring, completion);
+					} while (io_uring_peek_cqe(&ring, &completion) == 0);
+
+					io_uring_submit(&ring); //(resubmitted short reads)
+				}
+			}
+		}
+
+	public:
+		IoUringFileReadService()
+		{
+			ringReady = (io_uring_queue_init(ringSize, &ring, 0) == 0);
+
+			if (ringReady)
+			{
+				ringThread = std::thread(&IoUringFileReadService::ringLoop, this);
+			}
+		}
+
+		~IoUringFileReadService() override
+		{
+			if (!ringReady)
+			{
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			requestAdded.notify_all();
+
+			ringThread.join();
+			io_uring_queue_exit(&ring);
+		}
+
+		/*false if the kernel refused the ring (too old, or io_uring disabled) - the pread backend is used instead*/
+		bool isReady() const { return ringReady; }
+
+		void readWholeFile(const string& path, Callback onDone) override
+		{
+			auto request = std::make_unique<Request>();
+			request->path = path;
+			request->onDone = std::move(onDone);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				pending.push_back(std::move(request));
+			}
+			requestAdded.notify_one();
+		}
+
+		const char* getBackendName() const override { return "io_uring"; }
+	};
+#endif
+
+	std::unique_ptr<FileReadService> makeFileReadService()
+	{
+#ifdef IMAGEBMP_HAS_IO_URING
+		auto ioUring = std::make_unique<IoUringFileReadService>();
+
+		if (ioUring->isReady())
+		{
+			return ioUring;
+		}
+#endif
+		return std::make_unique<PreadFileReadService>();
+	}
+
+	/*what loadBMPBatch waits on*/
+	struct BatchState
+	{
+		std::mutex mutex;
+		std::condition_variable progress;
+		size_t inFlight = 0;
+		size_t remaining = 0;
+	};
+
+	DetachedCoroutine loadIntoSlot(string path, bool keep16BitStorage, DecodeLimits limits, LoadedBMP& slot, BatchState& state)
+	{
+		slot = co_await loadBMP(std::move(path), keep16BitStorage, limits);
+
+		//(notify while holding the lock - `state` is gone as soon as loadBMPBatch sees remaining == 0)
+		std::lock_guard<std::mutex> lock(state.mutex);
+		--state.inFlight;
+		--state.remaining;
+		state.progress.notify_all();
+	}
+}
+
+FileReadService& FileReadService::shared()
+{
+	static std::unique_ptr<FileReadService> service = makeFileReadService();
+	return *service;
+}
+
+BMPTask<LoadedBMP> loadBMP(string path, bool keep16BitStorage, DecodeLimits limits)
+{
+	LoadedBMP loaded;
+	loaded.path = path;
+
+	auto [fileBytes, error] = co_await readWholeFileAsync(path);
+
+	if (error != BMPError::None)
+	{
+		loaded.status = error;
+		co_return loaded;
+	}
+
+	//off the I/O thread, so it can get on with the next read while we decode:
+	co_await resumeOn(ThreadPool::shared());
+
+	loaded.status = loaded.image.decodeFromMemory(fileBytes.data(), fileBytes.size(), keep16BitStorage, limits);
+	co_return loaded;
+}
+
+vector<LoadedBMP> loadBMPBatch(const vector<string>& paths, size_t maxInFlight, bool keep16BitStorage,
+	const DecodeLimits& limits)
+{
+	vector<LoadedBMP> results(paths.size());
+	BatchState state;
+	state.remaining = paths.size();
+
+	maxInFlight = std::max<size_t>(maxInFlight, 1);
+
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		{
+			std::unique_lock<std::mutex> lock(state.mutex);
+			state.progress.wait(lock, [&state, maxInFlight] { return state.inFlight < maxInFlight; });
+			++state.inFlight;
+		}
+
+		loadIntoSlot(paths[i], keep16BitStorage, limits, results[i], state);
+	}
+
+	std::unique_lock<std::mutex> lock(state.mutex);
+	state.progress.wait(lock, [&state] { return state.remaining == 0; });
+
+	return results;
+}
+
+#endif
@@ -0,0 +1,254 @@
+#pragma once
+
+/*coroutine-based loading - C++20 only (for earlier standards this header declares nothing)
+
+	BMPTask<LoadedBMP> loadSprite(string path)
+	{
+		LoadedBMP sprite = co_await loadBMP(path);
+		...
+	}
+
+or, for a whole batch from ordinary code: vector<LoadedBMP> sprites = loadBMPBatch(paths);
+
+the file is read by FileReadService (io_uring where it was built in and the kernel allows it, pread threads otherwise)
+and decoded on ThreadPool::shared(), so many reads and decodes overlap*/
+
+#if (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L) || __cplusplus >= 202002L
+#if __has_include(<coroutine>)
+#define IMAGEBMP_HAS_COROUTINES 1
+#endif
+#endif
+
+#ifdef IMAGEBMP_HAS_COROUTINES
+
+#include<condition_variable>
+#include<coroutine>
+#include<exception>
+#include<functional>
+#include<mutex>
+#include<optional>
+#include<utility>
+
+#include "ImageBMP.h"
+#include "ThreadPool.h"
+
+/*one loaded file - `image` is only meaningful if `status` is OK*/
+struct LoadedBMP
+{
+	string path;
+	ImageBMP image;
+	BMPStatus status;
+};
+
+/*a coroutine that produces a T - it starts when it is first co_awaited (or handed to runBlocking)*/
+template<typename T>
+class BMPTask
+{
+public:
+	struct promise_type
+	{
+		std::optional<T> value;
+		std::exception_ptr error;
+		std::coroutine_handle<> continuation; //whoever co_awaits us - resumed when we finish
+
+		BMPTask get_return_object() { return BMPTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+
+		std::suspend_always initial_suspend() noexcept { return {}; }
+
+		struct FinalAwaiter
+		{
+			bool await_ready() noexcept { return false; }
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> finished) noexcept
+			{
+				std::coroutine_handle<> continuation = finished.promise().continuation;
+				return continuation ? continuation : std::noop_coroutine();
+			}
+
+			void await_resume() noexcept {}
+		};
+
+		FinalAwaiter final_suspend() noexcept { return {}; }
+
+		template<typename U>
+		void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+
+		void unhandled_exception() { error = std::current_exception(); }
+	};
+
+	BMPTask(BMPTask&& other) noexcept : coroutine(std::exchange(other.coroutine, nullptr)) {}
+
+	BMPTask& operator=(BMPTask&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (coroutine)
+			{
+				coroutine.destroy();
+			}
+			coroutine = std::exchange(other.coroutine, nullptr);
+		}
+		return *this;
+	}
+
+	~BMPTask()
+	{
+		if (coroutine)
+		{
+			coroutine.destroy();
+		}
+	}
+
+	//co_await support:
+	bool await_ready() const noexcept { return false; }
+
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+	{
+		coroutine.promise().continuation = awaiting;
+		return coroutine; //(start us - symmetric transfer, so long chains don't grow the stack)
+	}
+
+	T await_resume()
+	{
+		promise_type& promise = coroutine.promise();
+
+		if (promise.error)
+		{
+			std::rethrow_exception(promise.error);
+		}
+		return std::move(*promise.value);
+	}
+
+private:
+	explicit BMPTask(std::coroutine_handle<promise_type> coroutine) : coroutine(coroutine) {}
+
+	std::coroutine_handle<promise_type> coroutine;
+};
+
+/*a coroutine nobody waits for - it starts at once and frees itself when done*/
+struct DetachedCoroutine
+{
+	struct promise_type
+	{
+		DetachedCoroutine get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+/*reads whole files without blocking the caller - each callback runs on one of the service's own threads*/
+class FileReadService
+{
+public:
+	using Callback = std::function<void(vector<unsigned char>&& fileBytes, BMPError error)>;
+
+	/*io_uring if the library was built with IMAGEBMP_USE_IO_URING (and linked with -luring) and the kernel allows it,
+	otherwise a few threads doing blocking pread (ifstream reads where there is no pread)*/
+	static FileReadService& shared();
+
+	virtual ~FileReadService() = default;
+
+	virtual void readWholeFile(const string& path, Callback onDone) = 0;
+
+	virtual const char* getBackendName() const = 0;
+};
+
+/*co_await readWholeFileAsync(path) -> (bytes, error) - we resume on the I/O thread*/
+struct ReadFileAwaiter
+{
+	FileReadService& service;
+	string path;
+
+	vector<unsigned char> fileBytes;
+	BMPError error = BMPError::None;
+
+	bool await_ready() const noexcept { return false; }
+
+	void await_suspend(std::coroutine_handle<> reader)
+	{
+		service.readWholeFile(path, [this, reader](vector<unsigned char>&& bytes, BMPError readError)
+			{
+				fileBytes = std::move(bytes);
+				error = readError;
+				reader.resume();
+			});
+	}
+
+	std::pair<vector<unsigned char>, BMPError> await_resume() { return { std::move(fileBytes), error }; }
+};
+
+inline ReadFileAwaiter readWholeFileAsync(const string& path, FileReadService& service = FileReadService::shared())
+{
+	return ReadFileAwaiter{ service, path, {}, BMPError::None };
+}
+
+/*co_await resumeOn(pool) - the rest of the coroutine runs on one of pool's workers*/
+struct ResumeOnAwaiter
+{
+	ThreadPool& pool;
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> coroutine) { pool.submit([coroutine] { coroutine.resume(); }); }
+	void await_resume() const noexcept {}
+};
+
+inline ResumeOnAwaiter resumeOn(ThreadPool& pool)
+{
+	return ResumeOnAwaiter{ pool };
+}
+
+/*reads `path` asynchronously, then decodes it on ThreadPool::shared() (within `limits` - see tryReadImageBMP)*/
+BMPTask<LoadedBMP> loadBMP(string path, bool keep16BitStorage = false, DecodeLimits limits = DecodeLimits());
+
+/*loads every file, keeping up to maxInFlight reads/decodes going at once, and returns them in the order of `paths`
+- blocks the calling thread (which must not be a ThreadPool::shared() worker) until all are done*/
+vector<LoadedBMP> loadBMPBatch(const vector<string>& paths, size_t maxInFlight = 64, bool keep16BitStorage = false,
+	const DecodeLimits& limits = DecodeLimits());
+
+/*starts `task` and waits for its result - the bridge from ordinary code into coroutines*/
+template<typename T>
+T runBlocking(BMPTask<T> task)
+{
+	struct Waiter
+	{
+		std::mutex mutex;
+		std::condition_variable finished;
+		bool done = false;
+		std::optional<T> result;
+		std::exception_ptr error;
+	};
+
+	Waiter waiter;
+
+	auto drive = [](BMPTask<T>& task, Waiter& waiter) -> DetachedCoroutine
+	{
+		try
+		{
+			waiter.result.emplace(co_await task);
+		}
+		catch (...)
+		{
+			waiter.error = std::current_exception();
+		}
+
+		//(notify while holding the lock - `waiter` is gone as soon as runBlocking sees done)
+		std::lock_guard<std::mutex> lock(waiter.mutex);
+		waiter.done = true;
+		waiter.finished.notify_all();
+	};
+
+	drive(task, waiter);
+
+	std::unique_lock<std::mutex> lock(waiter.mutex);
+	waiter.finished.wait(lock, [&waiter] { return waiter.done; });
+
+	if (waiter.error)
+	{
+		std::rethrow_exception(waiter.error);
+	}
+	return std::move(*waiter.result);
+}
+
+#endif
@@ -0,0 +1,238 @@
+#include "BMPRegionReader.h"
+
+#include<utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include<cerrno>
+#include<fcntl.h>
+#include<unistd.h>
+#define IMAGEBMP_HAS_PREAD 1
+#endif
+
+BMPRegionReader::~BMPRegionReader()
+{
+	close();
+}
+
+BMPStatus BMPRegionReader::open(const string& path)
+{
+	close();
+
+	ifstream fin{ path, std::ios::binary };
+
+	if (!fin)
+	{
+		return BMPError::FileNotFound;
+	}
+
+	//(streaming: more than 4 GB of pixels is fine here - only the rows of a region are ever read)
+	BMPStatus status = headers.readHeadersFromFile(fin, true);
+
+	if (!status)
+	{
+		headers = ImageBMP();
+		return status;
+	}
+
+	if (headers.infoHeader.getBitsPerPixel() == 16 && headers.infoHeader.getSixteenBitLayout() == PixelFormat::BGRA32)
+	{
+		headers = ImageBMP();
+		return BMPError::UnsupportedCompression;
+	}
+
+	const InfoHeader& info = headers.infoHeader;
+	bytesPerRow = ((size_t)info.imageWidth * info.getBitsPerPixel() + 31) / 32 * 4;
+
+	palette.fill(Color());
+	for (size_t i = 0; i < info.getColorPalette().size() && i < palette.size(); ++i)
+	{
+		palette[i] = Color(info.getColorPalette()[i] | 0xFF'00'00'00); //palette alpha is "reserved" (usually 0)
+	}
+
+#ifdef IMAGEBMP_HAS_PREAD
+	fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0)
+	{
+		headers = ImageBMP();
+		return BMPError::FileNotFound;
+	}
+#else
+	stream = std::move(fin);
+#endif
+
+	filePath = path;
+	return BMPError::None;
+}
+
+void BMPRegionReader::close()
+{
+#ifdef IMAGEBMP_HAS_PREAD
+	if (fd >= 0)
+	{
+		::close(fd);
+		fd = -1;
+	}
+#endif
+	if (stream.is_open())
+	{
+		stream.close();
+	}
+
+	filePath.clear();
+	headers = ImageBMP();
+}
+
+bool BMPRegionReader::isOpen() const
+{
+	return !filePath.empty();
+}
+
+bool BMPRegionReader::readAt(unsigned long long offset, unsigned char* destination, size_t count) const
+{
+#ifdef IMAGEBMP_HAS_PREAD
+	while (count > 0)
+	{
+		ssize_t got = pread(fd, destination, count, (off_t)offset);
+
+		if (got < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (got <= 0)
+		{
+			return false;
+		}
+
+		destination += got;
+		offset += (unsigned long long)got;
+		count -= (size_t)got;
+	}
+	return true;
+#else
+	std::lock_guard<std::mutex> lock(streamMutex);
+
+	stream.clear();
+	stream.seekg((std::streamoff)offset, std::ios::beg);
+	stream.read(reinterpret_cast<char*>(destination), (std::streamsize)count);
+
+	return !stream.fail();
+#endif
+}
+
+void BMPRegionReader::decodeRow(const unsigned char* source, Color* destination, size_t count) const
+{
+	unsigned int* pixels = reinterpret_cast<unsigned int*>(destination);
+
+	switch (headers.infoHeader.getBitsPerPixel())
+	{
+	case 32:
+		convertRow<FormatBGRA32, FormatBGRA32>(reinterpret_cast<const unsigned int*>(source), pixels, count);
+		break;
+	case 24:
+		convertRow<FormatBGR24, FormatBGRA32>(reinterpret_cast<const BGR*>(source), pixels, count);
+		break;
+	case 16:
+		if (headers.infoHeader.getSixteenBitLayout() == PixelFormat::RGB565)
+		{
+			convertRow<FormatRGB565, FormatBGRA32>(reinterpret_cast<const unsigned short*>(source), pixels, count);
+		}
+		else
+		{
+			convertRow<FormatRGB555, FormatBGRA32>(reinterpret_cast<const unsigned short*>(source), pixels, count);
+		}
+		break;
+	case 8:
+		for (size_t i = 0; i < count; ++i)
+		{
+			destination[i] = palette[source[i]];
+		}
+		break;
+	}
+}
+
+BMPStatus BMPRegionReader::readRegion(unsigned int x0, unsigned int y0, const ImageView& target) const
+{
+	if (!isOpen())
+	{
+		return BMPError::FileNotFound;
+	}
+
+	unsigned int regionWidth = target.getWidth();
+	unsigned int regionHeight = target.getHeight();
+
+	if (regionWidth == 0 || regionHeight == 0
+		|| (unsigned long long)x0 + regionWidth > getWidth() || (unsigned long long)y0 + regionHeight > getHeight())
+	{
+		return BMPError::BadDimensions;
+	}
+
+	size_t bytesPerPixel = (size_t)headers.infoHeader.getBitsPerPixel() / 8;
+	size_t spanBytes = regionWidth * bytesPerPixel;
+	unsigned long long firstByte = headers.fileHeader.getIndexOfPixelData() + (unsigned long long)x0 * bytesPerPixel;
+
+	//(one row's worth of raw bytes - a 256-wide tile needs at most 1 KB per row)
+	vector<unsigned char> rowBytes(spanBytes);
+
+	for (unsigned int y = 0; y < regionHeight; ++y)
+	{
+		unsigned int row = y0 + y;
+		unsigned int fileRow = headers.infoHeader.isTopDown() ? getHeight() - 1 - row : row;
+
+		if (!readAt(firstByte + (unsigned long long)fileRow * bytesPerRow, rowBytes.data(), spanBytes))
+		{
+			return BMPError::TruncatedPixelData; //(the file got shorter since open - validateHeaders checked its size)
+		}
+
+		decodeRow(rowBytes.data(), target[y].data(), regionWidth);
+	}
+
+	return BMPError::None;
+}
+
+BMPStatus BMPRegionReader::readRegion(unsigned int x0, unsigned int y0, unsigned int regionWidth, unsigned int regionHeight,
+	ImageBMP& region) const
+{
+	if (!isOpen())
+	{
+		return BMPError::FileNotFound;
+	}
+
+	if (regionWidth == 0 || regionHeight == 0
+		|| (unsigned long long)x0 + regionWidth > getWidth() || (unsigned long long)y0 + regionHeight > getHeight())
+	{
+		return BMPError::BadDimensions;
+	}
+
+	region = ImageBMP(regionWidth, regionHeight, Color());
+
+	BMPStatus status = readRegion(x0, y0, region.view());
+
+	if (!status)
+	{
+		region = ImageBMP();
+		return status;
+	}
+
+	//written back the way tryReadImageBMP would write the whole file:
+	const InfoHeader& info = headers.infoHeader;
+
+	switch (info.getBitsPerPixel())
+	{
+	case 24: region.setOutputFormat(PixelFormat::BGR24); break;
+	case 16: region.setOutputFormat(info.getSixteenBitLayout()); break;
+	case 8: region.setOutputFormat(info.hasGrayscalePalette() ? PixelFormat::Gray8 : PixelFormat::BGR24); break;
+	default: break;
+	}
+
+	return BMPError::None;
+}
+
+BMPStatus readBMPRegion(const string& path, unsigned int x0, unsigned int y0, unsigned int regionWidth, unsigned int regionHeight,
+	ImageBMP& region)
+{
+	BMPRegionReader reader;
+	BMPStatus status = reader.open(path);
+
+	return status ? reader.readRegion(x0, y0, regionWidth, regionHeight, region) : status;
+}
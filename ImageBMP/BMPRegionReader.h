@@ -0,0 +1,70 @@
+#pragma once
+
+#include<array>
+#include<mutex>
+#include<string>
+
+#include "ImageBMP.h"
+
+/*reads rectangles out of a BMP file WITHOUT loading the rest of it - eg: 256 x 256 tiles served from a multi-gigabyte scan
+- rows of an uncompressed BMP sit at fixed offsets (indexOfPixelData + row * padded stride), so each row of the rectangle
+is one positioned read (pread where there is one) of just its columns, decoded straight into the destination
+- the file stays open between reads, and readRegion can be called from several threads at once
+
+	BMPRegionReader reader;
+	if (reader.open("scan.bmp"))
+	{
+		ImageBMP tile;
+		reader.readRegion(4096, 8192, 256, 256, tile);
+	}*/
+class BMPRegionReader
+{
+public:
+	BMPRegionReader() = default;
+	~BMPRegionReader();
+
+	BMPRegionReader(const BMPRegionReader&) = delete;
+	BMPRegionReader& operator=(const BMPRegionReader&) = delete;
+
+	/*reads and checks the headers only (the checks of tryReadImageBMP, minus its 4 GB cap on the pixel data)
+	- on failure nothing is open*/
+	BMPStatus open(const string& path);
+
+	void close();
+
+	bool isOpen() const;
+
+	unsigned int getWidth() const { return headers.infoHeader.imageWidth; }
+	unsigned int getHeight() const { return headers.infoHeader.imageHeight; }
+
+	/*the file's headers (and an empty pixelMatrix)*/
+	const ImageBMP& getHeaders() const { return headers; }
+
+	/*the rectangle (x = column, y = row, row 0 = bottom) as a new image, with the file's output format
+	- BadDimensions if the rectangle is empty or not entirely inside the file's image*/
+	BMPStatus readRegion(unsigned int x0, unsigned int y0, unsigned int regionWidth, unsigned int regionHeight, ImageBMP& region) const;
+
+	/*the same into `target` (its size is the region's size) - nothing is allocated, so a tile server can reuse one buffer*/
+	BMPStatus readRegion(unsigned int x0, unsigned int y0, const ImageView& target) const;
+
+private:
+	/*`count` bytes at `offset` - false if the file ends (or the read fails) first*/
+	bool readAt(unsigned long long offset, unsigned char* destination, size_t count) const;
+
+	void decodeRow(const unsigned char* source, Color* destination, size_t count) const;
+
+	ImageBMP headers;
+	string filePath;
+	size_t bytesPerRow = 0;
+	array<Color, 256> palette{}; //(8-bit files)
+
+	int fd = -1; //(pread)
+
+	//where there is no pread: one stream, one read at a time
+	mutable ifstream stream;
+	mutable std::mutex streamMutex;
+};
+
+/*one rectangle from `path`, without reading the rest of the file (see BMPRegionReader)*/
+BMPStatus readBMPRegion(const string& path, unsigned int x0, unsigned int y0, unsigned int regionWidth, unsigned int regionHeight,
+	ImageBMP& region);
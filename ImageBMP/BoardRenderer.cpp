@@ -0,0 +1,210 @@
+#include "BoardRenderer.h"
+
+#include<algorithm>
+#include<mutex>
+
+#include "ThreadPool.h"
+
+namespace
+{
+	/*one string per distinct look - square color, piece, label (with separators that can't be in a name)*/
+	string tileKey(const BoardCell& cell)
+	{
+		string key(reinterpret_cast<const char*>(&cell.square.bgra), sizeof(cell.square.bgra));
+		key += '\0';
+		key += cell.piece;
+		key += '\0';
+		key += cell.label;
+		return key;
+	}
+}
+
+Board::Board(unsigned int rows, unsigned int columns, const Color& square)
+	: rows(rows), columns(columns), cells((size_t)rows * columns, BoardCell{ square, "", "" })
+{
+}
+
+Board Board::checkered(unsigned int rows, unsigned int columns, bool withCoordinates, const Color& light, const Color& dark)
+{
+	Board board(rows, columns, light);
+
+	for (unsigned int row = 0; row < rows; ++row)
+	{
+		for (unsigned int column = 0; column < columns; ++column)
+		{
+			BoardCell& cell = board.at(column, row);
+			cell.square = ((row + column) % 2 == 0) ? dark : light;
+
+			if (withCoordinates && row == 0)
+			{
+				cell.label += (char)('A' + column % 26);
+			}
+			if (withCoordinates && column == 0)
+			{
+				cell.label += std::to_string(row + 1);
+			}
+		}
+	}
+
+	return board;
+}
+
+BoardRenderer::BoardRenderer(BoardStyle style)
+	: style(std::move(style))
+{
+	assert(this->style.cellSize > 0);
+}
+
+unsigned int BoardRenderer::getImageWidth(const Board& board) const
+{
+	return board.columns * style.cellSize + 2 * style.borderWidth;
+}
+
+unsigned int BoardRenderer::getImageHeight(const Board& board) const
+{
+	return board.rows * style.cellSize + 2 * style.borderWidth;
+}
+
+ImageBMP BoardRenderer::render(const Board& board)
+{
+	//(no fill - renderInto writes every pixel: the border, then the tiles over the whole inside)
+	ImageBMP image = ImageBMP::makePooled(getImageWidth(board), getImageHeight(board));
+
+	ImageView whole(image.pixelData.pixelMatrix.data(), image.infoHeader.imageWidth, image.infoHeader.imageHeight,
+		image.infoHeader.imageWidth);
+
+	renderInto(board, whole);
+
+	return image;
+}
+
+void BoardRenderer::renderInto(const Board& board, const ImageView& target)
+{
+	assert(target.getWidth() >= getImageWidth(board) && target.getHeight() >= getImageHeight(board));
+	assert(board.cells.size() == (size_t)board.rows * board.columns);
+
+	unsigned int cellSize = style.cellSize;
+	unsigned int borderWidth = style.borderWidth;
+	unsigned int imageWidth = getImageWidth(board);
+	unsigned int imageHeight = getImageHeight(board);
+
+	//the border: full rows along the bottom and top, the two side strips on every row in between
+	for (unsigned int y = 0; y < imageHeight; ++y)
+	{
+		PixelRow<Color> row = target[y];
+
+		if (y < borderWidth || y >= imageHeight - borderWidth)
+		{
+			std::fill_n(row.begin(), imageWidth, style.border);
+		}
+		else
+		{
+			std::fill_n(row.begin(), borderWidth, style.border);
+			std::fill_n(row.begin() + (imageWidth - borderWidth), borderWidth, style.border);
+		}
+	}
+
+	//one row of cells at a time: look its tiles up once, then copy their rows
+	vector<const PixelMatrix*> rowTiles(board.columns);
+
+	for (unsigned int cellRow = 0; cellRow < board.rows; ++cellRow)
+	{
+		for (unsigned int column = 0; column < board.columns; ++column)
+		{
+			rowTiles[column] = &tileFor(board.at(column, cellRow));
+		}
+
+		for (unsigned int y = 0; y < cellSize; ++y)
+		{
+			Color* destination = target[borderWidth + cellRow * cellSize + y].data() + borderWidth;
+
+			for (unsigned int column = 0; column < board.columns; ++column)
+			{
+				const Color* source = (*rowTiles[column])[y].data();
+				std::copy(source, source + cellSize, destination + (size_t)column * cellSize);
+			}
+		}
+	}
+}
+
+vector<ImageBMP> BoardRenderer::renderAll(const vector<Board>& boards)
+{
+	vector<ImageBMP> images(boards.size());
+
+	ThreadPool::shared().parallelFor(0, boards.size(), [&](size_t i)
+		{
+			images[i] = render(boards[i]);
+		});
+
+	return images;
+}
+
+const PixelMatrix& BoardRenderer::tileFor(const BoardCell& cell)
+{
+	string key = tileKey(cell);
+
+	{
+		std::shared_lock<std::shared_mutex> lock(cacheMutex);
+		auto found = tiles.find(key);
+
+		if (found != tiles.end())
+		{
+			return *found->second;
+		}
+	}
+
+	//drawn with no lock held - if another thread drew the same tile meanwhile, theirs is kept and ours dropped
+	std::unique_ptr<PixelMatrix> tile = drawTile(cell);
+
+	std::unique_lock<std::shared_mutex> lock(cacheMutex);
+	return *tiles.emplace(std::move(key), std::move(tile)).first->second;
+}
+
+std::unique_ptr<PixelMatrix> BoardRenderer::drawTile(const BoardCell& cell) const
+{
+	unsigned int cellSize = style.cellSize;
+	auto tile = std::make_unique<PixelMatrix>(cellSize, cellSize, cell.square);
+	ImageView view(tile->data(), cellSize, cellSize, cellSize);
+
+	//grid lines along the left and bottom edges - with every cell doing the same, they fall between cells
+	if (style.gridLineWidth > 0)
+	{
+		view.fillRectangle(0, 0, style.gridLineWidth, cellSize, style.gridLine);
+		view.fillRectangle(0, 0, cellSize, style.gridLineWidth, style.gridLine);
+	}
+
+	if (!cell.piece.empty())
+	{
+		const AtlasRect* sprite = (style.pieces != nullptr) ? style.pieces->find(cell.piece) : nullptr;
+
+		if (sprite != nullptr)
+		{
+			int x = ((int)cellSize - (int)sprite->width) / 2;
+			int y = ((int)cellSize - (int)sprite->height) / 2;
+			style.pieces->drawSprite(cell.piece, view, x, y, style.transparentColor);
+		}
+		else if (style.drawPiece)
+		{
+			style.drawPiece(view, cell.piece);
+		}
+	}
+
+	if (!cell.label.empty())
+	{
+		drawPixelText(view, (int)style.gridLineWidth + 1, (int)style.gridLineWidth + 1, cell.label, style.label, style.labelScale);
+	}
+
+	return tile;
+}
+
+size_t BoardRenderer::getCachedTileCount() const
+{
+	std::shared_lock<std::shared_mutex> lock(cacheMutex);
+	return tiles.size();
+}
+
+void BoardRenderer::clearCache()
+{
+	std::unique_lock<std::shared_mutex> lock(cacheMutex);
+	tiles.clear();
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include<functional>
+#include<memory>
+#include<shared_mutex>
+#include<string>
+#include<unordered_map>
+#include<vector>
+
+#include "ImageBMP.h"
+#include "SpriteAtlas.h"
+
+/*one cell of a board grid - cells that look the same (same square color, piece and label) share one cached tile*/
+struct BoardCell
+{
+	Color square;
+	string piece; //"" = none - a sprite name in BoardStyle::pieces, or whatever BoardStyle::drawPiece understands
+	string label; //"" = none - drawn in the bottom-left corner with drawPixelText (A-H, 1-8)
+};
+
+/*rows x columns cells, row 0 = bottom (like the images)*/
+struct Board
+{
+	unsigned int rows = 0;
+	unsigned int columns = 0;
+	vector<BoardCell> cells; //row by row
+
+	Board() = default;
+	Board(unsigned int rows, unsigned int columns, const Color& square);
+
+	BoardCell& at(unsigned int column, unsigned int row) { return cells[(size_t)row * columns + column]; }
+	const BoardCell& at(unsigned int column, unsigned int row) const { return cells[(size_t)row * columns + column]; }
+
+	/*alternating squares with the bottom-left one dark (a chessboard's a1)
+	- withCoordinates: files (A, B, ...) along the bottom row and ranks (1, 2, ...) up the left column
+	(drawPixelText has glyphs for A-H and 1-8 only - past 8 x 8, the extra labels are drawn blank)*/
+	static Board checkered(unsigned int rows = 8, unsigned int columns = 8, bool withCoordinates = false,
+		const Color& light = Color(ColorEnum::LightSquareColor), const Color& dark = Color(ColorEnum::DarkSquareColor));
+};
+
+struct BoardStyle
+{
+	unsigned int cellSize = 64;
+	unsigned int borderWidth = 16;
+	Color border = Color(ColorEnum::BoardBorder);
+
+	unsigned int gridLineWidth = 0; //lines between cells (eg: tic-tac-toe) - 0 for none
+	Color gridLine = Color(ColorEnum::Black);
+
+	Color label = Color(ColorEnum::Black);
+	unsigned int labelScale = 1;
+
+	/*pieces are sprites of this atlas (centered in the cell), with transparentColor left see-through...*/
+	const SpriteAtlas* pieces = nullptr;
+	Color transparentColor = Color(ColorEnum::WKnightBgrdColor);
+
+	/*...or drawn by this, for pieces the atlas doesn't have - it gets the cell's tile (cellSize x cellSize)
+	and may be called from several threads at once*/
+	std::function<void(const ImageView& tile, const string& piece)> drawPiece;
+};
+
+/*renders boards from tiles: every distinct (square color, piece, label) is drawn ONCE, into a cellSize x cellSize tile,
+and boards are then put together from the cached tiles a row of pixels at a time - no drawing per board at all
+- one renderer can render on any number of threads at once (the cache is shared, behind a reader/writer lock)*/
+class BoardRenderer
+{
+public:
+	explicit BoardRenderer(BoardStyle style);
+
+	BoardRenderer(const BoardRenderer&) = delete;
+	BoardRenderer& operator=(const BoardRenderer&) = delete;
+
+	/*size of a rendered board, border included*/
+	unsigned int getImageWidth(const Board& board) const;
+	unsigned int getImageHeight(const Board& board) const;
+
+	/*a new (pooled - see ImageBMP::makePooled) image of the board*/
+	ImageBMP render(const Board& board);
+
+	/*into an existing view of at least getImageWidth x getImageHeight pixels*/
+	void renderInto(const Board& board, const ImageView& target);
+
+	/*all of them, spread over ThreadPool::shared()*/
+	vector<ImageBMP> renderAll(const vector<Board>& boards);
+
+	size_t getCachedTileCount() const;
+
+	/*not while anything is being rendered*/
+	void clearCache();
+
+	const BoardStyle& getStyle() const { return style; }
+
+private:
+	const PixelMatrix& tileFor(const BoardCell& cell);
+	std::unique_ptr<PixelMatrix> drawTile(const BoardCell& cell) const;
+
+	BoardStyle style;
+
+	mutable std::shared_mutex cacheMutex;
+	std::unordered_map<string, std::unique_ptr<PixelMatrix>> tiles; //(tiles never move once made, so references stay valid)
+};
@@ -0,0 +1,312 @@
+#include "DecodedImageCache.h"
+
+#include<atomic>
+#include<cstring>
+#include<functional>
+#include<sstream>
+#include<thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include<unistd.h>
+#elif defined(_WIN32)
+#include<process.h>
+#endif
+
+#include "ThreadPool.h"
+
+namespace
+{
+	/*an entry's first page:
+		"BMPCACHE", version, width, height, output format, source size (8 bytes), source time (8 bytes), path length, path
+	then width * height BGRA32 pixels from entryPageSize on, bottom row first (all little-endian)*/
+	const char cacheMagic[8] = { 'B', 'M', 'P', 'C', 'A', 'C', 'H', 'E' };
+	constexpr unsigned int cacheVersion = 1;
+	constexpr size_t entryFixedSize = 44;
+	constexpr size_t entryPageSize = 4096;
+
+	struct SourceStamp
+	{
+		unsigned long long size = 0;
+		long long time = 0;
+	};
+
+	bool stampOf(const string& path, SourceStamp& stamp)
+	{
+		std::error_code error;
+		stamp.size = std::filesystem::file_size(path, error);
+
+		if (error)
+		{
+			return false;
+		}
+
+		stamp.time = (long long)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+		return !error;
+	}
+
+	unsigned long long currentProcessId()
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		return (unsigned long long)getpid();
+#elif defined(_WIN32)
+		return (unsigned long long)_getpid();
+#else
+		return 0; //(the thread and counter parts of the name still keep writers in this process apart)
+#endif
+	}
+
+	/*a name no other writer - in this process or another - uses at the same time*/
+	string temporaryPathFor(const string& entryPath)
+	{
+		static std::atomic<unsigned long long> nextWrite{ 0 };
+
+		std::ostringstream temporaryPath;
+		temporaryPath << entryPath << ".tmp" << currentProcessId() << '_'
+			<< std::hash<std::thread::id>()(std::this_thread::get_id()) << '_' << nextWrite++;
+		return temporaryPath.str();
+	}
+
+	template<typename T>
+	void appendRaw(string& bytes, const T& value)
+	{
+		bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	template<typename T>
+	T readRaw(const unsigned char* bytes)
+	{
+		T value;
+		std::memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	/*the format writeImageFile would use for the image as read (see ImageBMP::setOutputFormat)*/
+	PixelFormat outputFormatOf(const InfoHeader& header)
+	{
+		switch (header.getBitsPerPixel())
+		{
+		case 24: return PixelFormat::BGR24;
+		case 16: return header.getSixteenBitLayout();
+		case 8: return PixelFormat::Gray8;
+		default: return PixelFormat::BGRA32;
+		}
+	}
+
+	/*what an entry's header says about the image*/
+	struct EntryImage
+	{
+		unsigned int width = 0;
+		unsigned int height = 0;
+		PixelFormat outputFormat = PixelFormat::BGRA32;
+	};
+
+	/*maps `entryPath` if it is an entry for exactly this file as it is now*/
+	bool openEntry(const string& entryPath, const string& absolutePath, const SourceStamp& stamp, MappedFile& file, EntryImage& image)
+	{
+		if (!file.open(entryPath) || file.size() < entryPageSize)
+		{
+			return false;
+		}
+
+		const unsigned char* bytes = file.data();
+
+		if (std::memcmp(bytes, cacheMagic, sizeof(cacheMagic)) != 0 || readRaw<unsigned int>(bytes + 8) != cacheVersion)
+		{
+			return false;
+		}
+
+		image.width = readRaw<unsigned int>(bytes + 12);
+		image.height = readRaw<unsigned int>(bytes + 16);
+		image.outputFormat = (PixelFormat)readRaw<unsigned int>(bytes + 20);
+		unsigned int pathLength = readRaw<unsigned int>(bytes + 40);
+
+		//(the path is checked too - two paths can hash to the same entry name)
+		return readRaw<unsigned long long>(bytes + 24) == stamp.size
+			&& readRaw<long long>(bytes + 32) == stamp.time
+			&& pathLength == absolutePath.size() && entryFixedSize + pathLength <= entryPageSize
+			&& std::memcmp(bytes + entryFixedSize, absolutePath.data(), pathLength) == 0
+			&& (file.size() - entryPageSize) % sizeof(Color) == 0
+			&& (unsigned long long)image.width * image.height == (file.size() - entryPageSize) / sizeof(Color);
+	}
+
+	/*false if the entry could not be written (the caller still has the decoded image)*/
+	bool writeEntry(const string& entryPath, const string& absolutePath, const SourceStamp& stamp, const ImageBMP& image)
+	{
+		if (entryFixedSize + absolutePath.size() > entryPageSize)
+		{
+			return false; //(a path that long doesn't fit in the header page - never cached)
+		}
+
+		string header(cacheMagic, sizeof(cacheMagic));
+		appendRaw(header, cacheVersion);
+		appendRaw(header, image.infoHeader.imageWidth);
+		appendRaw(header, image.infoHeader.imageHeight);
+		appendRaw(header, (unsigned int)outputFormatOf(image.infoHeader));
+		appendRaw(header, stamp.size);
+		appendRaw(header, stamp.time);
+		appendRaw(header, (unsigned int)absolutePath.size());
+		header += absolutePath;
+		header.resize(entryPageSize, '\0');
+
+		//written under a name of its own, then renamed over the entry - readers see the old entry or the whole new one
+		string temporaryPath = temporaryPathFor(entryPath);
+
+		{
+			ofstream fout{ temporaryPath, std::ios::binary };
+
+			if (!fout)
+			{
+				return false;
+			}
+
+			fout.write(header.data(), (std::streamsize)header.size());
+			fout.write(reinterpret_cast<const char*>(image.pixelData.pixelMatrix.data()),
+				(std::streamsize)((size_t)image.infoHeader.imageWidth * image.infoHeader.imageHeight * sizeof(Color)));
+			fout.close();
+
+			if (fout.fail())
+			{
+				std::error_code ignored;
+				std::filesystem::remove(temporaryPath, ignored);
+				return false;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, entryPath, error);
+
+		if (error)
+		{
+			std::filesystem::remove(temporaryPath, error);
+			return false;
+		}
+		return true;
+	}
+}
+
+ImageView CachedImage::view()
+{
+	return ImageView(pixels, width, height, width);
+}
+
+ImageBMP CachedImage::toImageBMP() const
+{
+	ImageBMP image(width, height, Color());
+
+	if (width > 0 && height > 0)
+	{
+		std::copy(pixels, pixels + (size_t)width * height, image.pixelData.pixelMatrix.data());
+	}
+
+	image.setOutputFormat(outputFormat);
+	return image;
+}
+
+DecodedImageCache::DecodedImageCache(const string& cacheFolder)
+	: cacheFolder(cacheFolder)
+{
+}
+
+string DecodedImageCache::entryPathFor(const string& absolutePath) const
+{
+	std::ostringstream name;
+	name << std::hex << std::hash<string>()(absolutePath) << ".pixels";
+
+	return (std::filesystem::path(cacheFolder) / name.str()).string();
+}
+
+BMPStatus DecodedImageCache::load(const string& bmpPath, CachedImage& result, const DecodeLimits& limits) const
+{
+	result = CachedImage();
+
+	std::error_code error;
+	string absolutePath = std::filesystem::absolute(bmpPath, error).lexically_normal().string();
+
+	SourceStamp stamp;
+
+	if (error || !stampOf(absolutePath, stamp))
+	{
+		return BMPError::FileNotFound;
+	}
+
+	string entryPath = entryPathFor(absolutePath);
+
+	EntryImage entry;
+
+	//warm start: map the entry - the pixels are read by page faults as they are used
+	if (openEntry(entryPath, absolutePath, stamp, result.file, entry))
+	{
+		if (!limits.allows(entry.width, entry.height))
+		{
+			result = CachedImage();
+			return BMPError::ExceedsDecodeLimits;
+		}
+
+		result.width = entry.width;
+		result.height = entry.height;
+		result.outputFormat = entry.outputFormat;
+		result.pixels = reinterpret_cast<Color*>(result.file.data() + entryPageSize);
+		result.cached = true;
+		return BMPError::None;
+	}
+	result.file.close();
+
+	//cold start: decode, and leave an entry for next time
+	ImageBMP image;
+	BMPStatus status = image.tryReadImageBMP(absolutePath, false, limits);
+
+	if (!status)
+	{
+		return status;
+	}
+
+	std::filesystem::create_directories(cacheFolder, error);
+
+	if (writeEntry(entryPath, absolutePath, stamp, image) && openEntry(entryPath, absolutePath, stamp, result.file, entry))
+	{
+		result.width = entry.width;
+		result.height = entry.height;
+		result.outputFormat = entry.outputFormat;
+		result.pixels = reinterpret_cast<Color*>(result.file.data() + entryPageSize);
+		return BMPError::None;
+	}
+
+	//no entry (read-only folder, full disk...) - the decoded pixels are the result
+	result.file.close();
+	result.width = image.infoHeader.imageWidth;
+	result.height = image.infoHeader.imageHeight;
+	result.outputFormat = outputFormatOf(image.infoHeader);
+	result.ownPixels = std::move(image.pixelData.pixelMatrix);
+	result.pixels = result.ownPixels.data();
+
+	return BMPError::None;
+}
+
+vector<CachedImage> DecodedImageCache::loadAll(const vector<string>& bmpPaths, vector<BMPStatus>& statuses,
+	const DecodeLimits& limits) const
+{
+	vector<CachedImage> images(bmpPaths.size());
+	statuses.assign(bmpPaths.size(), BMPError::None);
+
+	//one file per task - each one only touches its own slots:
+	ThreadPool::shared().parallelFor(0, bmpPaths.size(), [&](size_t i)
+		{
+			statuses[i] = load(bmpPaths[i], images[i], limits);
+		});
+
+	return images;
+}
+
+void DecodedImageCache::clear() const
+{
+	std::error_code error;
+
+	for (auto it = std::filesystem::directory_iterator(cacheFolder, error); !error && it != std::filesystem::directory_iterator(); it.increment(error))
+	{
+		if (it->path().extension() == ".pixels")
+		{
+			std::error_code ignored;
+			std::filesystem::remove(it->path(), ignored);
+		}
+	}
+}
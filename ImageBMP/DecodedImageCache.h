@@ -0,0 +1,75 @@
+#pragma once
+
+#include<string>
+#include<vector>
+
+#include "ImageBMP.h"
+#include "MappedFile.h"
+
+/*one image from a DecodedImageCache - its pixels are the mapped cache file itself (nothing decoded, nothing copied)*/
+class CachedImage
+{
+public:
+	CachedImage() = default;
+
+	CachedImage(CachedImage&&) noexcept = default;
+	CachedImage& operator=(CachedImage&&) noexcept = default;
+
+	/*BGRA32, row 0 = bottom - drawing on it changes only this process's copy of the pages, never the cache*/
+	ImageView view();
+
+	/*a normal (copied) image, with the same output format the BMP file had*/
+	ImageBMP toImageBMP() const;
+
+	unsigned int getWidth() const { return width; }
+	unsigned int getHeight() const { return height; }
+
+	/*false if the BMP had to be decoded this time (and the cache entry was (re)written)*/
+	bool wasCached() const { return cached; }
+
+private:
+	friend class DecodedImageCache;
+
+	//the pixels are in ONE of these (from the cache -> file, decoded but not cached -> ownPixels)
+	MappedFile file;
+	PixelMatrix ownPixels;
+	Color* pixels = nullptr;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	PixelFormat outputFormat = PixelFormat::BGRA32;
+	bool cached = false;
+};
+
+/*decoded BMPs kept as raw pixels in a cache folder, so later runs map them instead of decoding them again
+
+	DecodedImageCache cache("imagecache");
+	CachedImage knight;
+	cache.load("pieces/WKnight.bmp", knight);
+
+- an entry is used only if the BMP still has the size and modification time it had when the entry was made
+(otherwise the BMP is decoded again and the entry replaced)
+- an entry is a page of header (which file, its size/time, width, height) followed by the pixels, so they start on a page
+- entries are written to a temporary file and renamed into place: another thread or process never sees half of one*/
+class DecodedImageCache
+{
+public:
+	explicit DecodedImageCache(const string& cacheFolder);
+
+	/*the cache folder is made if it doesn't exist - failing to write an entry only means decoding again next time
+	- an image bigger than `limits` allows fails with ExceedsDecodeLimits, whether it is decoded or already cached*/
+	BMPStatus load(const string& bmpPath, CachedImage& result, const DecodeLimits& limits = DecodeLimits()) const;
+
+	/*several at once, spread over ThreadPool::shared() - statuses[i] says how paths[i] went*/
+	vector<CachedImage> loadAll(const vector<string>& bmpPaths, vector<BMPStatus>& statuses,
+		const DecodeLimits& limits = DecodeLimits()) const;
+
+	/*deletes every entry*/
+	void clear() const;
+
+	const string& getCacheFolder() const { return cacheFolder; }
+
+private:
+	string entryPathFor(const string& absolutePath) const;
+
+	string cacheFolder;
+};
@@ -0,0 +1,615 @@
+#include "Deflate.h"
+
+#include<algorithm>
+#include<array>
+#include<cstdint>
+#include<cstring>
+#include<queue>
+
+namespace
+{
+	constexpr size_t windowSize = 32768;
+	constexpr unsigned int minimumMatch = 3;
+	constexpr unsigned int maximumMatch = 258;
+	constexpr unsigned int hashBits = 15;
+	constexpr size_t symbolsPerBlock = 16384;
+
+	constexpr std::array<unsigned short, 29> lengthBase = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	constexpr std::array<unsigned char, 29> lengthExtraBits = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	constexpr std::array<unsigned short, 30> distanceBase = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	constexpr std::array<unsigned char, 30> distanceExtraBits = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	//the order the code length code's lengths are stored in:
+	constexpr std::array<unsigned char, 19> codeLengthOrder = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	/*a literal (distance 0) or a match*/
+	struct Symbol
+	{
+		unsigned short literalOrLength;
+		unsigned short distance;
+	};
+
+	/*deflate packs bits from the least significant end of each byte*/
+	class BitWriter
+	{
+		std::vector<unsigned char>& out;
+		uint64_t bits = 0;
+		unsigned int count = 0;
+
+	public:
+		explicit BitWriter(std::vector<unsigned char>& out) : out(out) {}
+
+		void put(unsigned int value, unsigned int length)
+		{
+			bits |= (uint64_t)value << count;
+			count += length;
+
+			while (count >= 8)
+			{
+				out.push_back((unsigned char)bits);
+				bits >>= 8;
+				count -= 8;
+			}
+		}
+
+		void alignToByte()
+		{
+			if (count > 0)
+			{
+				out.push_back((unsigned char)bits);
+				bits = 0;
+				count = 0;
+			}
+		}
+	};
+
+	unsigned int lengthCodeOf(unsigned int length)
+	{
+		static const std::array<unsigned char, maximumMatch + 1> codes = []
+		{
+			std::array<unsigned char, maximumMatch + 1> made{};
+			for (unsigned int length = minimumMatch; length <= maximumMatch; ++length)
+			{
+				made[length] = (unsigned char)((std::upper_bound(lengthBase.begin(), lengthBase.end(), length) - lengthBase.begin()) - 1);
+			}
+			return made;
+		}();
+
+		return codes[length];
+	}
+
+	unsigned int distanceCodeOf(unsigned int distance)
+	{
+		//distances up to 256 looked up directly, longer ones by (distance - 1) / 128 - every code from 16 on spans a multiple of 128
+		static const std::array<unsigned char, 512> codes = []
+		{
+			std::array<unsigned char, 512> made{};
+			auto codeOf = [](unsigned int distance)
+			{
+				return (unsigned char)((std::upper_bound(distanceBase.begin(), distanceBase.end(), distance) - distanceBase.begin()) - 1);
+			};
+			for (unsigned int distance = 1; distance <= 256; ++distance)
+			{
+				made[distance - 1] = codeOf(distance);
+			}
+			for (unsigned int block = 2; block < 256; ++block)
+			{
+				made[256 + block] = codeOf(block * 128 + 1);
+			}
+			return made;
+		}();
+
+		return (distance <= 256) ? codes[distance - 1] : codes[256 + ((distance - 1) >> 7)];
+	}
+
+	/*Huffman code lengths for `frequencies` (0 = symbol unused), none longer than maxLength
+	- too-deep trees are fixed by flattening the frequencies and building again*/
+	void buildCodeLengths(const unsigned int* frequencies, size_t count, unsigned int maxLength, unsigned char* lengths)
+	{
+		std::vector<unsigned int> weights(frequencies, frequencies + count);
+
+		while (true)
+		{
+			std::fill(lengths, lengths + count, (unsigned char)0);
+
+			//nodes 0 .. count - 1 are the symbols, the merged ones come after
+			using Node = std::pair<unsigned long long, size_t>;
+			std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+			std::vector<size_t> parent(count, 0);
+
+			for (size_t symbol = 0; symbol < count; ++symbol)
+			{
+				if (weights[symbol] > 0)
+				{
+					queue.push({ weights[symbol], symbol });
+				}
+			}
+
+			if (queue.size() == 1)
+			{
+				lengths[queue.top().second] = 1;
+				return;
+			}
+			if (queue.empty())
+			{
+				return;
+			}
+
+			while (queue.size() > 1)
+			{
+				Node first = queue.top(); queue.pop();
+				Node second = queue.top(); queue.pop();
+
+				size_t merged = parent.size();
+				parent.push_back(0);
+				parent[first.second] = merged;
+				parent[second.second] = merged;
+
+				queue.push({ first.first + second.first, merged });
+			}
+
+			size_t root = queue.top().second;
+
+			//depth of every node, from the root down (parents always come after their children):
+			std::vector<unsigned int> depth(parent.size(), 0);
+			unsigned int deepest = 0;
+
+			for (size_t node = root; node-- > 0;)
+			{
+				if (node >= count || weights[node] > 0)
+				{
+					depth[node] = depth[parent[node]] + 1;
+				}
+			}
+
+			for (size_t symbol = 0; symbol < count; ++symbol)
+			{
+				if (weights[symbol] > 0)
+				{
+					lengths[symbol] = (unsigned char)depth[symbol];
+					deepest = std::max(deepest, depth[symbol]);
+				}
+			}
+
+			if (deepest <= maxLength)
+			{
+				return;
+			}
+
+			for (unsigned int& weight : weights)
+			{
+				if (weight > 0)
+				{
+					weight = (weight >> 1) | 1;
+				}
+			}
+		}
+	}
+
+	/*canonical codes (RFC 1951, 3.2.2), bit-reversed - BitWriter sends the low bit first, Huffman codes go high bit first*/
+	void assignCodes(const unsigned char* lengths, size_t count, unsigned short* codes)
+	{
+		std::array<unsigned int, 16> lengthCount{};
+		for (size_t symbol = 0; symbol < count; ++symbol)
+		{
+			++lengthCount[lengths[symbol]];
+		}
+		lengthCount[0] = 0;
+
+		std::array<unsigned int, 16> nextCode{};
+		unsigned int code = 0;
+		for (unsigned int length = 1; length < 16; ++length)
+		{
+			code = (code + lengthCount[length - 1]) << 1;
+			nextCode[length] = code;
+		}
+
+		for (size_t symbol = 0; symbol < count; ++symbol)
+		{
+			unsigned int length = lengths[symbol];
+
+			if (length == 0)
+			{
+				codes[symbol] = 0;
+				continue;
+			}
+
+			unsigned int forward = nextCode[length]++;
+			unsigned int reversed = 0;
+
+			for (unsigned int bit = 0; bit < length; ++bit)
+			{
+				reversed |= ((forward >> bit) & 1) << (length - 1 - bit);
+			}
+			codes[symbol] = (unsigned short)reversed;
+		}
+	}
+
+	/*one block with its own (dynamic) Huffman codes*/
+	void writeDynamicBlock(BitWriter& writer, const std::vector<Symbol>& symbols, bool finalBlock)
+	{
+		std::array<unsigned int, 286> literalFrequencies{};
+		std::array<unsigned int, 30> distanceFrequencies{};
+
+		for (const Symbol& symbol : symbols)
+		{
+			if (symbol.distance == 0)
+			{
+				++literalFrequencies[symbol.literalOrLength];
+			}
+			else
+			{
+				++literalFrequencies[257 + lengthCodeOf(symbol.literalOrLength)];
+				++distanceFrequencies[distanceCodeOf(symbol.distance)];
+			}
+		}
+		literalFrequencies[256] = 1; //end of block
+
+		//inflaters reject incomplete codes, so both trees get at least two symbols (unused ones just cost a few header bits):
+		if (std::count_if(literalFrequencies.begin(), literalFrequencies.end(), [](unsigned int f) { return f > 0; }) < 2)
+		{
+			literalFrequencies[0] = std::max(literalFrequencies[0], 1u);
+		}
+		if (std::count_if(distanceFrequencies.begin(), distanceFrequencies.end(), [](unsigned int f) { return f > 0; }) < 2)
+		{
+			distanceFrequencies[0] = std::max(distanceFrequencies[0], 1u);
+			distanceFrequencies[1] = std::max(distanceFrequencies[1], 1u);
+		}
+
+		std::array<unsigned char, 286> literalLengths{};
+		std::array<unsigned char, 30> distanceLengths{};
+		std::array<unsigned short, 286> literalCodes{};
+		std::array<unsigned short, 30> distanceCodes{};
+
+		buildCodeLengths(literalFrequencies.data(), literalFrequencies.size(), 15, literalLengths.data());
+		buildCodeLengths(distanceFrequencies.data(), distanceFrequencies.size(), 15, distanceLengths.data());
+		assignCodes(literalLengths.data(), literalLengths.size(), literalCodes.data());
+		assignCodes(distanceLengths.data(), distanceLengths.size(), distanceCodes.data());
+
+		size_t literalCount = 286;
+		while (literalCount > 257 && literalLengths[literalCount - 1] == 0)
+		{
+			--literalCount;
+		}
+		size_t distanceCount = 30;
+		while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0)
+		{
+			--distanceCount;
+		}
+
+		//both length lists, run-length coded with the code length alphabet (16 = repeat previous, 17/18 = runs of zeros)
+		std::vector<unsigned char> allLengths(literalLengths.begin(), literalLengths.begin() + literalCount);
+		allLengths.insert(allLengths.end(), distanceLengths.begin(), distanceLengths.begin() + distanceCount);
+
+		struct LengthSymbol
+		{
+			unsigned char symbol;
+			unsigned char extra;
+		};
+		std::vector<LengthSymbol> lengthSymbols;
+		std::array<unsigned int, 19> lengthFrequencies{};
+
+		for (size_t i = 0; i < allLengths.size();)
+		{
+			unsigned char length = allLengths[i];
+			size_t run = 1;
+			while (i + run < allLengths.size() && allLengths[i + run] == length)
+			{
+				++run;
+			}
+
+			size_t left = run;
+			if (length == 0)
+			{
+				while (left >= 11)
+				{
+					size_t taken = std::min<size_t>(left, 138);
+					lengthSymbols.push_back({ 18, (unsigned char)(taken - 11) });
+					left -= taken;
+				}
+				if (left >= 3)
+				{
+					lengthSymbols.push_back({ 17, (unsigned char)(left - 3) });
+					left = 0;
+				}
+			}
+			else if (run >= 4)
+			{
+				lengthSymbols.push_back({ length, 0 });
+				left -= 1;
+				while (left >= 3)
+				{
+					size_t taken = std::min<size_t>(left, 6);
+					lengthSymbols.push_back({ 16, (unsigned char)(taken - 3) });
+					left -= taken;
+				}
+			}
+
+			for (; left > 0; --left)
+			{
+				lengthSymbols.push_back({ length, 0 });
+			}
+
+			i += run;
+		}
+
+		for (const LengthSymbol& lengthSymbol : lengthSymbols)
+		{
+			++lengthFrequencies[lengthSymbol.symbol];
+		}
+		if (std::count_if(lengthFrequencies.begin(), lengthFrequencies.end(), [](unsigned int f) { return f > 0; }) < 2)
+		{
+			lengthFrequencies[lengthSymbols.front().symbol == 0 ? 1 : 0] = 1;
+		}
+
+		std::array<unsigned char, 19> codeLengthLengths{};
+		std::array<unsigned short, 19> codeLengthCodes{};
+		buildCodeLengths(lengthFrequencies.data(), lengthFrequencies.size(), 7, codeLengthLengths.data());
+		assignCodes(codeLengthLengths.data(), codeLengthLengths.size(), codeLengthCodes.data());
+
+		size_t codeLengthCount = 19;
+		while (codeLengthCount > 4 && codeLengthLengths[codeLengthOrder[codeLengthCount - 1]] == 0)
+		{
+			--codeLengthCount;
+		}
+
+		//the block header...
+		writer.put(finalBlock ? 1 : 0, 1);
+		writer.put(2, 2); //(dynamic Huffman)
+		writer.put((unsigned int)(literalCount - 257), 5);
+		writer.put((unsigned int)(distanceCount - 1), 5);
+		writer.put((unsigned int)(codeLengthCount - 4), 4);
+
+		for (size_t i = 0; i < codeLengthCount; ++i)
+		{
+			writer.put(codeLengthLengths[codeLengthOrder[i]], 3);
+		}
+
+		for (const LengthSymbol& lengthSymbol : lengthSymbols)
+		{
+			writer.put(codeLengthCodes[lengthSymbol.symbol], codeLengthLengths[lengthSymbol.symbol]);
+
+			if (lengthSymbol.symbol == 16) writer.put(lengthSymbol.extra, 2);
+			else if (lengthSymbol.symbol == 17) writer.put(lengthSymbol.extra, 3);
+			else if (lengthSymbol.symbol == 18) writer.put(lengthSymbol.extra, 7);
+		}
+
+		//...and the data
+		for (const Symbol& symbol : symbols)
+		{
+			if (symbol.distance == 0)
+			{
+				writer.put(literalCodes[symbol.literalOrLength], literalLengths[symbol.literalOrLength]);
+				continue;
+			}
+
+			unsigned int lengthCode = lengthCodeOf(symbol.literalOrLength);
+			writer.put(literalCodes[257 + lengthCode], literalLengths[257 + lengthCode]);
+			writer.put(symbol.literalOrLength - lengthBase[lengthCode], lengthExtraBits[lengthCode]);
+
+			unsigned int distanceCode = distanceCodeOf(symbol.distance);
+			writer.put(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+			writer.put(symbol.distance - distanceBase[distanceCode], distanceExtraBits[distanceCode]);
+		}
+
+		writer.put(literalCodes[256], literalLengths[256]);
+	}
+
+	unsigned int hashAt(const unsigned char* bytes)
+	{
+		uint32_t value = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16);
+		return (value * 2654435761u) >> (32 - hashBits);
+	}
+
+	unsigned int matchLength(const unsigned char* a, const unsigned char* b, unsigned int limit)
+	{
+		unsigned int length = 0;
+
+		//8 bytes at a time, then the first difference from the lowest set bit of the XOR:
+		while (length + 8 <= limit)
+		{
+			uint64_t first, second;
+			std::memcpy(&first, a + length, 8);
+			std::memcpy(&second, b + length, 8);
+
+			uint64_t difference = first ^ second;
+			if (difference != 0)
+			{
+#if defined(__GNUC__) || defined(__clang__)
+				return length + (unsigned int)(__builtin_ctzll(difference) >> 3);
+#else
+				break;
+#endif
+			}
+			length += 8;
+		}
+
+		while (length < limit && a[length] == b[length])
+		{
+			++length;
+		}
+		return length;
+	}
+}
+
+void deflatePiece(const unsigned char* data, size_t size, DeflateLevel level, bool lastPiece, std::vector<unsigned char>& out)
+{
+	//how hard to look: chain steps per position, and whether positions inside a match get into the hash chains
+	unsigned int maxChain = (level == DeflateLevel::Fast) ? 8 : 128;
+	unsigned int insertLimit = (level == DeflateLevel::Fast) ? 16 : maximumMatch;
+	unsigned int goodEnough = (level == DeflateLevel::Fast) ? 32 : maximumMatch;
+
+	std::vector<int> head((size_t)1 << hashBits, -1);
+	std::vector<int> previous(windowSize, -1);
+
+	BitWriter writer(out);
+	std::vector<Symbol> symbols;
+	symbols.reserve(symbolsPerBlock);
+
+	auto insert = [&](size_t position)
+	{
+		unsigned int hash = hashAt(data + position);
+		previous[position & (windowSize - 1)] = head[hash];
+		head[hash] = (int)position;
+	};
+
+	size_t position = 0;
+
+	while (position < size)
+	{
+		unsigned int bestLength = 0;
+		unsigned int bestDistance = 0;
+
+		if (position + minimumMatch <= size)
+		{
+			unsigned int limit = (unsigned int)std::min<size_t>(maximumMatch, size - position);
+			int candidate = head[hashAt(data + position)];
+
+			for (unsigned int chain = 0; chain < maxChain && candidate >= 0 && position - (size_t)candidate <= windowSize; ++chain)
+			{
+				//(a quick look at the byte that would make it longer than the best so far, before comparing the lot)
+				if (data[candidate + bestLength] == data[position + bestLength])
+				{
+					unsigned int length = matchLength(data + candidate, data + position, limit);
+
+					if (length > bestLength)
+					{
+						bestLength = length;
+						bestDistance = (unsigned int)(position - (size_t)candidate);
+
+						if (length >= goodEnough || length == limit)
+						{
+							break;
+						}
+					}
+				}
+
+				candidate = previous[(size_t)candidate & (windowSize - 1)];
+			}
+
+			insert(position);
+		}
+
+		if (bestLength >= minimumMatch)
+		{
+			symbols.push_back({ (unsigned short)bestLength, (unsigned short)bestDistance });
+
+			if (bestLength <= insertLimit)
+			{
+				for (size_t inside = position + 1; inside < position + bestLength && inside + minimumMatch <= size; ++inside)
+				{
+					insert(inside);
+				}
+			}
+			position += bestLength;
+		}
+		else
+		{
+			symbols.push_back({ data[position], 0 });
+			++position;
+		}
+
+		if (symbols.size() == symbolsPerBlock)
+		{
+			writeDynamicBlock(writer, symbols, lastPiece && position == size);
+			symbols.clear();
+		}
+	}
+
+	//(a final piece always needs a block with the final flag - even an empty one)
+	if (!symbols.empty() || (lastPiece && size == 0))
+	{
+		writeDynamicBlock(writer, symbols, lastPiece);
+	}
+
+	if (!lastPiece)
+	{
+		//an empty stored block: byte-aligns the piece, so the next one can start on a fresh byte
+		writer.put(0, 1);
+		writer.put(0, 2);
+		writer.alignToByte();
+		out.push_back(0x00);
+		out.push_back(0x00);
+		out.push_back(0xFF);
+		out.push_back(0xFF);
+	}
+	else
+	{
+		writer.alignToByte();
+	}
+}
+
+unsigned int adler32(const unsigned char* data, size_t size, unsigned int adler)
+{
+	constexpr unsigned int base = 65521;
+	unsigned int a = adler & 0xFFFF;
+	unsigned int b = adler >> 16;
+
+	//(5552 bytes is the most that can be summed before b could overflow 32 bits)
+	while (size > 0)
+	{
+		size_t block = std::min<size_t>(size, 5552);
+		size -= block;
+
+		for (size_t i = 0; i < block; ++i)
+		{
+			a += data[i];
+			b += a;
+		}
+
+		data += block;
+		a %= base;
+		b %= base;
+	}
+
+	return (b << 16) | a;
+}
+
+unsigned int adler32Combine(unsigned int first, unsigned int second, size_t secondSize)
+{
+	//(the same arithmetic as zlib's adler32_combine)
+	constexpr unsigned int base = 65521;
+	unsigned int remainder = (unsigned int)(secondSize % base);
+
+	unsigned int sum1 = first & 0xFFFF;
+	unsigned int sum2 = (unsigned int)(((unsigned long long)remainder * sum1) % base);
+
+	sum1 += (second & 0xFFFF) + base - 1;
+	sum2 += (first >> 16) + (second >> 16) + base - remainder;
+
+	if (sum1 >= base) sum1 -= base;
+	if (sum1 >= base) sum1 -= base;
+	if (sum2 >= 2 * base) sum2 -= 2 * base;
+	if (sum2 >= base) sum2 -= base;
+
+	return (sum2 << 16) | sum1;
+}
+
+unsigned int crc32(const unsigned char* data, size_t size, unsigned int crc)
+{
+	static const std::array<unsigned int, 256> table = []
+	{
+		std::array<unsigned int, 256> made{};
+		for (unsigned int n = 0; n < 256; ++n)
+		{
+			unsigned int c = n;
+			for (int k = 0; k < 8; ++k)
+			{
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			made[n] = c;
+		}
+		return made;
+	}();
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include<cstddef>
+#include<vector>
+
+/*a small self-contained deflate (RFC 1951) compressor, plus the checksums zlib and PNG streams need
+- no dependencies: hash-chain LZ77 and one dynamic Huffman block per 16K symbols
+
+a long input can be compressed as independent pieces, in parallel: each piece (except the last) ends with an empty
+stored block, so it stops on a byte boundary and the pieces can simply be concatenated - they never refer back into
+an earlier piece (costs a little ratio at each seam, nothing more)*/
+
+enum class DeflateLevel
+{
+	Fast, //short hash chains - for throughput
+	Default //long hash chains - smaller output
+};
+
+/*appends `size` bytes of `data`, compressed, to `out` - as the final piece of the stream if lastPiece (the stream
+then ends there), otherwise as a piece that more will follow*/
+void deflatePiece(const unsigned char* data, size_t size, DeflateLevel level, bool lastPiece, std::vector<unsigned char>& out);
+
+/*the zlib stream's checksum - start with 1 (and chain calls by passing the previous result)*/
+unsigned int adler32(const unsigned char* data, size_t size, unsigned int adler = 1);
+
+/*the adler32 of A followed by B, from adler32(A), adler32(B) and B's length - so pieces can be checksummed in parallel*/
+unsigned int adler32Combine(unsigned int first, unsigned int second, size_t secondSize);
+
+/*the CRC-32 PNG chunks end with - start with 0 (and chain calls by passing the previous result)*/
+unsigned int crc32(const unsigned char* data, size_t size, unsigned int crc = 0);
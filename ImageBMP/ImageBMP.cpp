@@ -1,9 +1,92 @@
 #include "ImageBMP.h"
+#include "PixelBufferPool.h"
+#include "Regions.h"
+#include "SmallImage.h"
+#include "ThreadPool.h"
 
-void ImageBMP::writeImageFile(std::string filename)
+#include<cctype>
+
+#pragma region row encoders/decoders
+/*BMP row bytes <-> rows of Color
+- one of these is picked ONCE per image from the header, so the pixel loops have no bitsPerPixel checks*/
+
+static_assert(sizeof(Color) == sizeof(unsigned int), "rows of Color are treated as rows of BGRA32 words");
+
+using RowEncoder = void(*)(const Color* source, unsigned char* destination, size_t count);
+using RowDecoder = void(*)(const unsigned char* source, Color* destination, size_t count);
+
+template<typename FileFormat>
+static void encodeColorRow(const Color* source, unsigned char* destination, size_t count)
 {
-	ofstream fout{ filename, std::ios::binary };
+	convertRow<FormatBGRA32, FileFormat>(reinterpret_cast<const unsigned int*>(source),
+		reinterpret_cast<typename FileFormat::PixelType*>(destination), count);
+}
+
+template<typename FileFormat>
+static void decodeColorRow(const unsigned char* source, Color* destination, size_t count)
+{
+	convertRow<FileFormat, FormatBGRA32>(reinterpret_cast<const typename FileFormat::PixelType*>(source),
+		reinterpret_cast<unsigned int*>(destination), count);
+}
+
+/*nullptr if there is no encoder for the header's format*/
+static RowEncoder selectRowEncoder(short bitsPerPixel, PixelFormat sixteenBitLayout)
+{
+	switch (bitsPerPixel)
+	{
+	case 32: return &encodeColorRow<FormatBGRA32>;
+	case 24: return &encodeColorRow<FormatBGR24>;
+	case 16:
+		if (sixteenBitLayout == PixelFormat::RGB565) return &encodeColorRow<FormatRGB565>;
+		if (sixteenBitLayout == PixelFormat::RGB555) return &encodeColorRow<FormatRGB555>;
+		return nullptr;
+	case 8: return &encodeColorRow<FormatGray8>; //(only ever written with the gray palette - see setOutputFormat)
+	default: return nullptr;
+	}
+}
+
+static RowDecoder selectRowDecoder(short bitsPerPixel, PixelFormat sixteenBitLayout)
+{
+	switch (bitsPerPixel)
+	{
+	case 32: return &decodeColorRow<FormatBGRA32>;
+	case 24: return &decodeColorRow<FormatBGR24>;
+	case 16:
+		if (sixteenBitLayout == PixelFormat::RGB565) return &decodeColorRow<FormatRGB565>;
+		if (sixteenBitLayout == PixelFormat::RGB555) return &decodeColorRow<FormatRGB555>;
+		return nullptr;
+	default: return nullptr;
+	}
+}
+
+/*one row of the image, as its bytes in the file (without the row padding) - whatever the image's storage*/
+static void encodeFileRow(const ImageBMP& image, RowEncoder encodeRow, unsigned int row, unsigned char* destination,
+	vector<Color>& tiledRow)
+{
+	const PixelData& pixelData = image.pixelData;
+	unsigned int width = image.infoHeader.imageWidth;
+
+	if (pixelData.isTiled())
+	{
+		tiledRow.resize(width); //(a row gathered from the tiles)
+		pixelData.tiledPixels.copyRowTo(row, tiledRow.data());
+		encodeRow(tiledRow.data(), destination, width);
+	}
+	else if (pixelData.storageFormat == PixelFormat::BGRA32)
+	{
+		encodeRow(pixelData.pixelMatrix.at(row).data(), destination, width);
+	}
+	else
+	{
+		//compact 16-bit storage already is the file layout (see setOutputFormat)
+		std::memcpy(destination, &pixelData.packedPixels.at((size_t)row * width), (size_t)width * sizeof(unsigned short));
+	}
+}
+
+#pragma endregion
 
+void ImageBMP::writeHeadersToFile(std::ostream& fout) const
+{
 	//first comes the 14-byte file header: 
 	fout.write(reinterpret_cast<const char*>(fileHeader.filetype.data()), 2); //no sizeof here, since filetype is a pointer
 	fout.write(reinterpret_cast<const char*>(&fileHeader.fileSize), sizeof(fileHeader.fileSize));
@@ -24,50 +107,291 @@ void ImageBMP::writeImageFile(std::string filename)
 		fout.write(reinterpret_cast<const char*>(&remainingHeaderField), sizeof(remainingHeaderField));
 	}
 
-	// Calculate the number of bytes per pixel based on the bit depth
-	int bytesPerPixel = infoHeader.bitsPerPixel / 8;
+	//BI_BITFIELDS: the R, G, B masks follow the 40-byte info header
+	if (infoHeader.compressionMethod == 3)
+	{
+		fout.write(reinterpret_cast<const char*>(infoHeader.bitfieldMasks.data()), 3 * sizeof(unsigned int));
+	}
+
+	//8-bit: the palette comes right before the pixels
+	if (!infoHeader.colorPalette.empty())
+	{
+		fout.write(reinterpret_cast<const char*>(infoHeader.colorPalette.data()), infoHeader.colorPalette.size() * sizeof(unsigned int));
+	}
+}
+
+void ImageBMP::writeImageFile(const string& filename)
+{
+	BMPStatus status = tryWriteImageFile(filename);
+
+	if (!status)
+	{
+		//(just a message - never waits for input, so a bad write can't stall the caller)
+		std::cout << "Could not write " << filename << ": " << status.message() << "\n";
+		return;
+	}
+
+	rememberSavedFile(filename);
+}
+
+BMPStatus ImageBMP::tryWriteImageFile(const string& filename) const
+{
+	RowEncoder encodeRow = selectRowEncoder(infoHeader.bitsPerPixel, infoHeader.getSixteenBitLayout());
+
+	if (encodeRow == nullptr)
+	{
+		return BMPError::UnsupportedBitDepth;
+	}
+
+	ofstream fout{ filename, std::ios::binary };
+
+	if (!fout)
+	{
+		return BMPError::CannotCreateFile;
+	}
+
+	writeHeadersToFile(fout);
 
-	// Calculate the padding bytes per row (each row is padded to a multiple of 4 bytes)
-	int paddingBytes = (4 - (infoHeader.imageWidth * bytesPerPixel) % 4) % 4;
+	//each row is padded to a multiple of 4 bytes - the padding at the end of rowBytes just stays zero
+	size_t bytesPerRow = ((size_t)infoHeader.imageWidth * infoHeader.bitsPerPixel + 31) / 32 * 4;
+	vector<unsigned char> rowBytes(bytesPerRow, 0);
+	vector<Color> tiledRow;
 
-	//now the pixel data: 
+	//now the pixel data, one whole row per write: 
 	for (unsigned int row = 0; row < infoHeader.imageHeight; ++row)
 	{
-		for (unsigned int col = 0; col < infoHeader.imageWidth; ++col)
+		encodeFileRow(*this, encodeRow, row, rowBytes.data(), tiledRow);
+		fout.write(reinterpret_cast<const char*>(rowBytes.data()), bytesPerRow);
+	}
+
+	fout.close();
+
+	return fout.fail() ? BMPError::WriteFailed : BMPError::None;
+}
+
+size_t ImageBMP::getEncodedSize() const
+{
+	size_t bytesPerRow = ((size_t)infoHeader.imageWidth * infoHeader.bitsPerPixel + 31) / 32 * 4;
+	return (size_t)fileHeader.indexOfPixelData + bytesPerRow * infoHeader.imageHeight;
+}
+
+namespace
+{
+	/*lets writeHeadersToFile write straight into a caller's buffer - writing past its end fails the stream*/
+	class MemoryOutputBuffer : public std::streambuf
+	{
+	public:
+		MemoryOutputBuffer(unsigned char* bytes, size_t size)
 		{
-			if (infoHeader.bitsPerPixel == 32)
-			{
+			char* first = reinterpret_cast<char*>(bytes);
+			setp(first, first + size);
+		}
+
+		size_t getBytesWritten() const { return (size_t)(pptr() - pbase()); }
+	};
+}
 
+BMPStatus ImageBMP::encodeInto(unsigned char* buffer, size_t capacity, size_t* bytesWritten) const
+{
+	RowEncoder encodeRow = selectRowEncoder(infoHeader.bitsPerPixel, infoHeader.getSixteenBitLayout());
 
-				unsigned int colorOfCurrentPixel = pixelData.pixelMatrix.at(row).at(col).convertToUnsignedInt();
+	if (encodeRow == nullptr)
+	{
+		return BMPError::UnsupportedBitDepth;
+	}
 
-				fout.write(reinterpret_cast<const char*>(&colorOfCurrentPixel), sizeof(colorOfCurrentPixel));
-			}
+	size_t encodedSize = getEncodedSize();
 
-			else if (infoHeader.bitsPerPixel == 24)
-			{
-				unsigned int colorOfCurrentPixel = pixelData.pixelMatrix.at(row).at(col).convertToUnsignedInt();
-				char rgb[3] = {
-					static_cast<char>((colorOfCurrentPixel >> 0) & 0xFF),
-					static_cast<char>((colorOfCurrentPixel >> 8) & 0xFF),
-					static_cast<char>((colorOfCurrentPixel >> 16) & 0xFF)
-				};
-				fout.write(rgb, 3);
-			}
+	if (capacity < encodedSize)
+	{
+		return BMPError::BufferTooSmall;
+	}
+
+	//the headers go through the same writeHeadersToFile as a file write, and must end exactly where the pixels start:
+	MemoryOutputBuffer headerBuffer(buffer, fileHeader.indexOfPixelData);
+	std::ostream headerStream(&headerBuffer);
+	writeHeadersToFile(headerStream);
+
+	if (!headerStream || headerBuffer.getBytesWritten() != fileHeader.indexOfPixelData)
+	{
+		return BMPError::WriteFailed;
+	}
+
+	//every row has its own place in the buffer - so bands of rows are encoded in parallel, straight into it
+	unsigned char* pixelBytes = buffer + fileHeader.indexOfPixelData;
+	size_t bytesPerRow = ((size_t)infoHeader.imageWidth * infoHeader.bitsPerPixel + 31) / 32 * 4;
+	size_t rowPadding = bytesPerRow - (size_t)infoHeader.imageWidth * (infoHeader.bitsPerPixel / 8);
+	unsigned int height = infoHeader.imageHeight;
+
+	ThreadPool& pool = ThreadPool::shared();
+	unsigned int bandCount = std::max(1u, std::min(height / 16, (pool.getWorkerCount() + 1) * 4));
 
-			else
+	pool.parallelFor(0, bandCount, [&](size_t band)
+		{
+			unsigned int firstRow = (unsigned int)((unsigned long long)height * band / bandCount);
+			unsigned int endRow = (unsigned int)((unsigned long long)height * (band + 1) / bandCount);
+			vector<Color> tiledRow;
+
+			for (unsigned int row = firstRow; row < endRow; ++row)
 			{
-				std::cout << "Hey! Neither 32 nor 24 bits per pixel? What is this file?\n";
-				std::cin.get();
+				unsigned char* rowBytes = pixelBytes + (size_t)row * bytesPerRow;
+
+				encodeFileRow(*this, encodeRow, row, rowBytes, tiledRow);
+				std::memset(rowBytes + bytesPerRow - rowPadding, 0, rowPadding); //(the caller's buffer isn't zeroed)
 			}
+		});
+
+	if (bytesWritten != nullptr)
+	{
+		*bytesWritten = encodedSize;
+	}
+
+	return BMPError::None;
+}
+
+BMPStatus ImageBMP::encodeToBuffer(vector<unsigned char>& fileBytes) const
+{
+	fileBytes.resize(getEncodedSize());
+
+	BMPStatus status = encodeInto(fileBytes.data(), fileBytes.size());
+
+	if (!status)
+	{
+		fileBytes.clear();
+	}
+
+	return status;
+}
+
+void ImageBMP::rememberSavedFile(const string& filename)
+{
+	std::error_code error;
+	savedFileTime = std::filesystem::last_write_time(filename, error);
+	savedFilePath = error ? string() : filename;
+
+	dirtyRegion.reset(infoHeader.imageHeight);
+}
+
+bool ImageBMP::canPatchSavedFile(const string& filename) const
+{
+	if (savedFilePath.empty() || filename != savedFilePath)
+	{
+		return false;
+	}
+
+	std::error_code error;
+	std::filesystem::file_time_type modified = std::filesystem::last_write_time(filename, error);
+
+	if (error || modified != savedFileTime)
+	{
+		return false; //(someone else wrote it since)
+	}
+
+	unsigned long long fileSize = std::filesystem::file_size(filename, error);
+	size_t bytesPerRow = ((size_t)infoHeader.imageWidth * infoHeader.bitsPerPixel + 31) / 32 * 4;
+
+	if (error || fileSize != (unsigned long long)fileHeader.indexOfPixelData + bytesPerRow * infoHeader.imageHeight)
+	{
+		return false;
+	}
+
+	//the headers on disk must be byte-for-byte the ones a full write would produce now (size, format, palette...):
+	std::ostringstream expected;
+	writeHeadersToFile(expected);
+	string expectedHeaders = expected.str();
+
+	if (expectedHeaders.size() != fileHeader.indexOfPixelData)
+	{
+		return false;
+	}
+
+	ifstream fin{ filename, std::ios::binary };
+	string headersOnDisk(expectedHeaders.size(), '\0');
+
+	return fin.read(&headersOnDisk[0], (std::streamsize)headersOnDisk.size()) && headersOnDisk == expectedHeaders;
+}
+
+BMPStatus ImageBMP::saveChanges(const string& filename)
+{
+	RowEncoder encodeRow = selectRowEncoder(infoHeader.bitsPerPixel, infoHeader.getSixteenBitLayout());
+
+	if (encodeRow == nullptr)
+	{
+		return BMPError::UnsupportedBitDepth;
+	}
+
+	if (!canPatchSavedFile(filename))
+	{
+		BMPStatus status = tryWriteImageFile(filename);
+
+		if (status)
+		{
+			rememberSavedFile(filename);
 		}
+		return status;
+	}
 
-		// Write the padding bytes at the end of each row
-		char padding[3] = { 0, 0, 0 };
-		fout.write(padding, paddingBytes);
+	if (dirtyRegion.isClean())
+	{
+		return BMPError::None;
 	}
 
-	fout.close();
+	std::fstream file{ filename, std::ios::binary | std::ios::in | std::ios::out };
+
+	if (!file)
+	{
+		return BMPError::CannotCreateFile;
+	}
+
+	size_t bytesPerPixel = infoHeader.bitsPerPixel / 8;
+	size_t bytesPerRow = ((size_t)infoHeader.imageWidth * infoHeader.bitsPerPixel + 31) / 32 * 4;
+	vector<unsigned char> runBytes;
+	vector<Color> tiledRow;
+
+	//each run of consecutive changed rows is ONE write, from the first row's dirty span to the end of the last row's
+	//(the clean pixels in between are rewritten with the bytes they already have - cheaper than a seek per row)
+	unsigned int row = dirtyRegion.getFirstDirtyRow();
+
+	while (row < dirtyRegion.getEndDirtyRow())
+	{
+		if (dirtyRegion.getRowSpan(row).first >= dirtyRegion.getRowSpan(row).second)
+		{
+			++row;
+			continue;
+		}
+
+		unsigned int runEnd = row + 1;
+		while (runEnd < dirtyRegion.getEndDirtyRow() && dirtyRegion.getRowSpan(runEnd).first < dirtyRegion.getRowSpan(runEnd).second)
+		{
+			++runEnd;
+		}
+
+		runBytes.assign((runEnd - row) * bytesPerRow, 0); //(row padding stays zero, as in a full write)
+
+		for (unsigned int runRow = row; runRow < runEnd; ++runRow)
+		{
+			encodeFileRow(*this, encodeRow, runRow, runBytes.data() + (runRow - row) * bytesPerRow, tiledRow);
+		}
+
+		size_t firstByte = dirtyRegion.getRowSpan(row).first * bytesPerPixel;
+		size_t endByte = (runEnd - row - 1) * bytesPerRow + dirtyRegion.getRowSpan(runEnd - 1).second * bytesPerPixel;
+
+		file.seekp((std::streamoff)fileHeader.indexOfPixelData + (std::streamoff)row * bytesPerRow + (std::streamoff)firstByte);
+		file.write(reinterpret_cast<const char*>(runBytes.data() + firstByte), (std::streamsize)(endByte - firstByte));
+
+		row = runEnd;
+	}
+
+	file.close();
+
+	if (file.fail())
+	{
+		savedFilePath.clear(); //(the file is now partly old, partly new - the next save must write all of it)
+		return BMPError::WriteFailed;
+	}
+
+	rememberSavedFile(filename);
+	return BMPError::None;
 }
 
 ImageBMP::ImageBMP(unsigned int imageWidth, unsigned int imageHeight, const Color& fillColor, const Color& middleDotColor)
@@ -80,19 +404,13 @@ ImageBMP::ImageBMP(unsigned int imageWidth, unsigned int imageHeight, const Colo
 
 
 
-	//fill pixelData with given fill color:
-	for (unsigned int row = 0; row < imageHeight; ++row)
-	{
-		std::vector<Color> currentRow;
-		for (unsigned int col = 0; col < imageWidth; ++col)
-		{
-			currentRow.push_back(fillColor);
-		}
-		pixelData.pixelMatrix.push_back(currentRow);
-	}
+	//fill pixelData with given fill color (one allocation, sized up front):
+	pixelData.pixelMatrix.assign(imageWidth, imageHeight, fillColor);
 
 	//add the middle dot (having different color): 
-	pixelData.pixelMatrix.at(imageWidth / 2).at(imageHeight / 2) = middleDotColor;
+	pixelData.pixelMatrix.at(imageHeight / 2).at(imageWidth / 2) = middleDotColor;
+
+	markDirty(0, 0, imageWidth, imageHeight); //(never saved)
 
 }
 
@@ -106,517 +424,1280 @@ ImageBMP::ImageBMP(unsigned int imageWidth, unsigned int imageHeight, const Colo
 
 
 
-	//fill pixelData with given fill color:
-	for (unsigned int row = 0; row < imageHeight; ++row)
+	//fill pixelData with given fill color (one allocation, sized up front):
+	pixelData.pixelMatrix.assign(imageWidth, imageHeight, fillColor);
+
+	markDirty(0, 0, imageWidth, imageHeight); //(never saved)
+}
+
+ImageBMP ImageBMP::makePooled(unsigned int imageWidth, unsigned int imageHeight, const Color& fillColor)
+{
+	ImageBMP image;
+
+	image.infoHeader.imageWidth = imageWidth;
+	image.infoHeader.imageHeight = imageHeight;
+	image.refreshHeaderSizes();
+
+	image.pixelData.pixelMatrix.assignFromPool(imageWidth, imageHeight, fillColor);
+	image.markDirty(0, 0, imageWidth, imageHeight);
+
+	return image;
+}
+
+ImageBMP ImageBMP::makePooled(unsigned int imageWidth, unsigned int imageHeight)
+{
+	ImageBMP image;
+
+	image.infoHeader.imageWidth = imageWidth;
+	image.infoHeader.imageHeight = imageHeight;
+	image.refreshHeaderSizes();
+
+	image.pixelData.pixelMatrix.acquireFromPool(imageWidth, imageHeight);
+	image.markDirty(0, 0, imageWidth, imageHeight);
+
+	return image;
+}
+
+ImageView ImageBMP::view()
+{
+	return view(0, 0, infoHeader.imageWidth, infoHeader.imageHeight);
+}
+
+ImageView ImageBMP::view(unsigned int x0, unsigned int y0, unsigned int viewWidth, unsigned int viewHeight)
+{
+	untilePixelData(); //(views see rows)
+
+	assert(pixelData.storageFormat == PixelFormat::BGRA32);
+
+	ImageView whole(pixelData.pixelMatrix.data(), pixelData.pixelMatrix.getWidth(), pixelData.pixelMatrix.getHeight(),
+		pixelData.pixelMatrix.getWidth());
+
+	ImageView part = whole.subView(x0, y0, viewWidth, viewHeight);
+
+	//(we can't see what is drawn through the view, so all of it counts as changed)
+	markDirty(part.getOriginX(), part.getOriginY(), part.getWidth(), part.getHeight());
+
+	return part;
+}
+
+vector<ImageView> ImageBMP::rowBands(unsigned int bandCount)
+{
+	untilePixelData();
+
+	vector<ImageView> bands;
+	unsigned int height = pixelData.pixelMatrix.getHeight();
+
+	bandCount = std::max(1u, std::min(bandCount, height));
+	bands.reserve(bandCount);
+
+	for (unsigned int band = 0; band < bandCount; ++band)
+	{
+		//(64-bit, so height * band can't wrap)
+		unsigned int firstRow = (unsigned int)((unsigned long long)height * band / bandCount);
+		unsigned int lastRow = (unsigned int)((unsigned long long)height * (band + 1) / bandCount);
+
+		bands.push_back(view(0, firstRow, pixelData.pixelMatrix.getWidth(), lastRow - firstRow));
+	}
+
+	return bands;
+}
+
+vector<ImageView> ImageBMP::tiles(unsigned int tileWidth, unsigned int tileHeight)
+{
+	assert(tileWidth > 0 && tileHeight > 0);
+
+	untilePixelData(); //(these tiles are views of rows, whatever their size)
+
+	vector<ImageView> allTiles;
+
+	for (unsigned int y = 0; y < pixelData.pixelMatrix.getHeight(); y += tileHeight)
 	{
-		vector<Color> currentRow;
-		for (unsigned int col = 0; col < imageWidth; ++col)
+		for (unsigned int x = 0; x < pixelData.pixelMatrix.getWidth(); x += tileWidth)
 		{
-			currentRow.push_back(fillColor);
+			allTiles.push_back(view(x, y, tileWidth, tileHeight));
 		}
-		pixelData.pixelMatrix.push_back(currentRow);
 	}
+
+	return allTiles;
+}
+
+void ImageBMP::renderTilesInParallel(unsigned int tileWidth, unsigned int tileHeight, const std::function<void(const ImageView&)>& drawTile)
+{
+	vector<ImageView> allTiles = tiles(tileWidth, tileHeight);
+
+	ThreadPool::shared().parallelFor(0, allTiles.size(), [&](size_t i) { drawTile(allTiles[i]); });
+}
+
+/*the only way to copy an image - everything else moves*/
+ImageBMP ImageBMP::clone() const
+{
+	ImageBMP copy;
+
+	copy.fileHeader = fileHeader;
+	copy.infoHeader = infoHeader;
+	copy.pixelData = pixelData;
+	copy.markDirty(0, 0, infoHeader.imageWidth, infoHeader.imageHeight); //(a new image - not saved anywhere yet)
+
+	return copy;
+}
+
+ImageBMP::ImageBMP(const string& filepath)
+{
+	readImageBMP(filepath);
+}
+
+void ImageBMP::readImageBMP(const string& inputFilename, bool keep16BitStorage)
+{
+	BMPStatus status = tryReadImageBMP(inputFilename, keep16BitStorage);
+
+	if (!status)
+	{
+		//(just a message - never waits for input, so a bad file can't stall the caller)
+		std::cout << "Could not read " << inputFilename << ": " << status.message() << "\n";
+	}
+}
+
+BMPStatus ImageBMP::tryReadImageBMP(const string& inputFilename, bool keep16BitStorage, const DecodeLimits& limits)
+{
+	ifstream fin{ inputFilename, std::ios::binary };
+
+	if (!fin)
+	{
+		*this = ImageBMP();
+		return BMPError::FileNotFound;
+	}
+
+	BMPStatus status = readFromStream(fin, keep16BitStorage, limits);
+
+	if (status)
+	{
+		fin.close();
+		rememberSavedFile(inputFilename); //(saveChanges checks that the headers we would write match the file's)
+	}
+
+	return status;
+}
+
+namespace
+{
+	/*lets the stream-based readers work on bytes that are already in memory (no copy)*/
+	class MemoryStreamBuffer : public std::streambuf
+	{
+	public:
+		MemoryStreamBuffer(const unsigned char* bytes, size_t size)
+		{
+			//(get area only - nothing is ever written through the non-const pointers)
+			char* first = const_cast<char*>(reinterpret_cast<const char*>(bytes));
+			setg(first, first, first + size);
+		}
+
+	protected:
+		pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which) override
+		{
+			if (!(which & std::ios_base::in))
+			{
+				return pos_type(off_type(-1));
+			}
+
+			off_type size = egptr() - eback();
+			off_type target = (direction == std::ios_base::beg) ? offset
+				: (direction == std::ios_base::cur) ? (gptr() - eback()) + offset
+				: size + offset;
+
+			if (target < 0 || target > size)
+			{
+				return pos_type(off_type(-1));
+			}
+
+			setg(eback(), eback() + target, egptr());
+			return pos_type(target);
+		}
+
+		pos_type seekpos(pos_type position, std::ios_base::openmode which) override
+		{
+			return seekoff(off_type(position), std::ios_base::beg, which);
+		}
+	};
+}
+
+BMPStatus ImageBMP::decodeFromMemory(const unsigned char* fileBytes, size_t fileSize, bool keep16BitStorage,
+	const DecodeLimits& limits)
+{
+	MemoryStreamBuffer buffer(fileBytes, fileSize);
+	std::istream in(&buffer);
+
+	return readFromStream(in, keep16BitStorage, limits);
+}
+
+BMPStatus ImageBMP::readFromStream(std::istream& fin, bool keep16BitStorage, const DecodeLimits& limits)
+{
+	pixelData.tiledPixels.release(); //(files are always read into rows)
+
+	//headers are validated (against each other, the file size and the caller's limits) before any pixel memory is allocated:
+	BMPStatus status = readHeadersFromFile(fin);
+
+	if (status && !limits.allows(infoHeader.imageWidth, infoHeader.imageHeight))
+	{
+		status = BMPError::ExceedsDecodeLimits;
+	}
+
+	if (status)
+	{
+		status = readPixelDataFromFile(fin);
+	}
+
+	if (!status)
+	{
+		*this = ImageBMP(); //don't leave half-read headers/pixels behind
+		return status;
+	}
+
+	//from here on the headers describe what writeImageFile will produce - a bottom-up file with a 40-byte header
+	//(setOutputFormat has already done this for 8-bit files)
+	infoHeader.infoHeaderSize = 40;
+	infoHeader.topDown = false;
+	refreshHeaderSizes();
+
+	savedFilePath.clear();
+	dirtyRegion.reset(infoHeader.imageHeight);
+
+	if (!keep16BitStorage && pixelData.storageFormat != PixelFormat::BGRA32)
+	{
+		expandPixelData();
+	}
+
+	return status;
+}
+
+//only allow integer scaling (no 1.5x) 
+void ImageBMP::doublescaleImageBMP()
+{
+	unsigned int scalingFactor = 2;
+
+	untilePixelData(); //(the doubling below works on rows)
+
+	//first, make the needed updates to the headers: 
+	fileHeader.fileSize = fileHeader.fileSize + scalingFactor * scalingFactor * infoHeader.sizeOfPixelData;
+
+	infoHeader.imageWidth = infoHeader.imageWidth * scalingFactor;
+	infoHeader.imageHeight = infoHeader.imageHeight * scalingFactor;
+
+	infoHeader.sizeOfPixelData = scalingFactor * scalingFactor * infoHeader.sizeOfPixelData;
+	//ex: if 3 rows and 3 cols (9) pixels originally, then 36 pixels for scalingFactor = 2
+	//since now 6 rows and 6 cols 
+
+	//now, modify pixel data (the more complicated/interesting part of this function): 
+
+	PixelMatrix newPixelMatrix(infoHeader.imageWidth, infoHeader.imageHeight);
+
+	for (size_t row = 0; row < pixelData.pixelMatrix.size(); ++row)
+	{
+		PixelRow<const Color> oldRow = std::as_const(pixelData.pixelMatrix)[row];
+		PixelRow<Color> newRow = newPixelMatrix[scalingFactor * row];
+
+		//each pixel twice along the row...
+		for (size_t col = 0; col < oldRow.size(); ++col)
+		{
+			newRow[scalingFactor * col] = oldRow[col];
+			newRow[scalingFactor * col + 1] = oldRow[col];
+		}
+
+		//...and the whole (doubled) row twice:
+		std::copy(newRow.begin(), newRow.end(), newPixelMatrix[scalingFactor * row + 1].begin());
+	}
+
+	//the new matrix is MOVED in (no copy of the - now 4x bigger - pixels):
+	pixelData.pixelMatrix = std::move(newPixelMatrix);
+
+	dirtyRegion.reset(infoHeader.imageHeight);
+	markDirty(0, 0, infoHeader.imageWidth, infoHeader.imageHeight);
+
+}
+
+void ImageBMP::rotateClockwise()
+{
+	tilePixelData(); //(reading rows as columns would jump a whole row per pixel - within a tile, both stay in cache)
+
+	pixelData.tiledPixels = pixelData.tiledPixels.rotatedClockwise();
+
+	std::swap(infoHeader.imageWidth, infoHeader.imageHeight);
+	refreshHeaderSizes();
+
+	dirtyRegion.reset(infoHeader.imageHeight);
+	markDirty(0, 0, infoHeader.imageWidth, infoHeader.imageHeight);
+}
+
+
+static unsigned int littleEndian32(const unsigned char* bytes)
+{
+	return (unsigned int)bytes[0] << 0 |
+		(unsigned int)bytes[1] << 8 |
+		(unsigned int)bytes[2] << 16 |
+		(unsigned int)bytes[3] << 24;
+}
+
+static unsigned short littleEndian16(const unsigned char* bytes)
+{
+	return (unsigned short)(bytes[0] | bytes[1] << 8);
+}
+
+BMPStatus ImageBMP::readHeadersFromFile(std::istream& fin, bool streamingOnly)
+{
+	//the size on disk first, so every offset/size in the headers can be checked against it:
+	fin.seekg(0, std::ios::end);
+	std::streamoff fileSizeOnDisk = fin.tellg();
+	fin.seekg(0, std::ios::beg);
+
+	if (fileSizeOnDisk < 0)
+	{
+		return BMPError::TruncatedHeader;
+	}
+
+	//ONE read for the file header, the biggest (V5) info header and the 12 mask bytes a 40-byte header may be followed by
+	//(a smaller file just gives a shorter read - what counts is whether the header it declares fits)
+	array<unsigned char, 14 + 124 + 12> headerBytes{};
+	fin.read(reinterpret_cast<char*>(headerBytes.data()), headerBytes.size());
+	size_t bytesRead = (size_t)fin.gcount();
+	fin.clear(); //(a short read sets eof/fail - the seeks below need a clean stream)
+
+	if (bytesRead < 14 + 40)
+	{
+		return BMPError::TruncatedHeader;
+	}
+
+	readFileHeaderFromBytes(headerBytes.data());
+
+	size_t infoHeaderSize = littleEndian32(headerBytes.data() + 14);
+	size_t masksSize = (infoHeaderSize == 40 && littleEndian32(headerBytes.data() + 30) == 3) ? 12 : 0;
+
+	if (infoHeaderSize <= 124 && 14 + infoHeaderSize + masksSize > bytesRead)
+	{
+		return BMPError::TruncatedHeader;
+	}
+
+	//(the masks of a 40-byte header sit at the same offset as a longer header's, so they are parsed the same way)
+	readInfoHeaderFromBytes(headerBytes.data() + 14, std::min(infoHeaderSize + masksSize, bytesRead - 14));
+
+	BMPStatus status = validateHeaders((unsigned long long)fileSizeOnDisk, streamingOnly);
+
+	if (!status)
+	{
+		return status;
+	}
+
+	//palette - a second read, at most 1 KB:
+	infoHeader.colorPalette.assign(infoHeader.getPaletteEntryCount(), 0);
+
+	if (!infoHeader.colorPalette.empty())
+	{
+		fin.seekg(14 + infoHeaderSize + masksSize, std::ios::beg);
+		fin.read(reinterpret_cast<char*>(infoHeader.colorPalette.data()), infoHeader.colorPalette.size() * sizeof(unsigned int));
+
+		if (fin.fail())
+		{
+			return BMPError::TruncatedHeader;
+		}
+	}
+
+	//...and straight to the pixels (there may be a gap - or, for V5, an ICC profile - before them)
+	fin.seekg(fileHeader.indexOfPixelData, std::ios::beg);
+
+	return fin.fail() ? BMPError::TruncatedHeader : BMPError::None;
+}
+
+BMPStatus ImageBMP::validateHeaders(unsigned long long fileSizeOnDisk, bool streamingOnly) const
+{
+	if (fileHeader.filetype[0] != 'B' || fileHeader.filetype[1] != 'M')
+	{
+		return BMPError::NotABMP;
+	}
+
+	//40-byte BITMAPINFOHEADER, or the V2/V3/V4/V5 extensions of it (NOT the old 12-byte OS/2 one)
+	if (infoHeader.infoHeaderSize != 40 && infoHeader.infoHeaderSize != 52 && infoHeader.infoHeaderSize != 56
+		&& infoHeader.infoHeaderSize != 108 && infoHeader.infoHeaderSize != 124)
+	{
+		return BMPError::UnsupportedHeaderSize;
+	}
+
+	if (infoHeader.bitsPerPixel != 8 && infoHeader.bitsPerPixel != 16
+		&& infoHeader.bitsPerPixel != 24 && infoHeader.bitsPerPixel != 32)
+	{
+		return BMPError::UnsupportedBitDepth;
+	}
+
+	//uncompressed only - or BI_BITFIELDS with masks we know (5-6-5/5-5-5, or the usual 8-8-8 for 32-bit)
+	if (infoHeader.compressionMethod == 3)
+	{
+		bool knownMasks = (infoHeader.bitsPerPixel == 16)
+			? infoHeader.getSixteenBitLayout() != PixelFormat::BGRA32
+			: (infoHeader.bitsPerPixel == 32 && infoHeader.bitfieldMasks[0] == 0x00'FF'00'00
+				&& infoHeader.bitfieldMasks[1] == 0x00'00'FF'00 && infoHeader.bitfieldMasks[2] == 0x00'00'00'FF);
+
+		if (!knownMasks)
+		{
+			return BMPError::UnsupportedCompression;
+		}
+	}
+	else if (infoHeader.compressionMethod != 0)
+	{
+		return BMPError::UnsupportedCompression;
+	}
+
+	//(imageHeight is already positive here - top-down files have their sign in infoHeader.topDown)
+	if (infoHeader.imageWidth == 0 || infoHeader.imageHeight == 0
+		|| infoHeader.imageWidth > 0x7F'FF'FF'FF || infoHeader.imageHeight > 0x7F'FF'FF'FF)
+	{
+		return BMPError::BadDimensions;
+	}
+
+	//every size below is 64-bit, so none of these multiplications can wrap:
+	unsigned long long bytesPerRow = ((unsigned long long)infoHeader.imageWidth * infoHeader.bitsPerPixel + 31) / 32 * 4;
+	unsigned long long pixelBytes = bytesPerRow * infoHeader.imageHeight;
+	unsigned long long decodedBytes = (unsigned long long)infoHeader.imageWidth * infoHeader.imageHeight * sizeof(Color);
+
+	//BMP sizes are 32-bit fields, and the decoded image has to be addressable
+	//(a streaming reader only ever holds a few rows - the file size check below is what keeps it honest):
+	if (!streamingOnly && (pixelBytes > 0xFF'FF'FF'FF || decodedBytes > (unsigned long long)SIZE_MAX / 2))
+	{
+		return BMPError::DimensionOverflow;
+	}
+
+	unsigned long long endOfHeaders = 14ull + infoHeader.infoHeaderSize
+		+ (infoHeader.compressionMethod == 3 && infoHeader.infoHeaderSize == 40 ? 12 : 0) + infoHeader.getPaletteEntryCount() * 4ull;
+
+	if (fileHeader.indexOfPixelData < endOfHeaders || fileHeader.indexOfPixelData > fileSizeOnDisk)
+	{
+		return BMPError::BadPixelDataOffset;
+	}
+
+	if (fileHeader.indexOfPixelData + pixelBytes > fileSizeOnDisk)
+	{
+		return BMPError::TruncatedPixelData;
+	}
+
+	return BMPError::None;
+}
+
+/*bytes 0 - 13 of the file*/
+void ImageBMP::readFileHeaderFromBytes(const unsigned char* bytes)
+{
+	fileHeader.filetype.at(0) = (char)bytes[0];
+	fileHeader.filetype.at(1) = (char)bytes[1];
+
+	fileHeader.fileSize = littleEndian32(bytes + 2);
+	fileHeader.reserved1And2 = littleEndian32(bytes + 6);
+	fileHeader.indexOfPixelData = littleEndian32(bytes + 10);
+}
+
+/*`bytes` starts at the info header, and `available` is how many of its bytes were actually read
+- handles the 40-byte header plus the longer V2 (52), V3 (56), V4 (108) and V5 (124) ones,
+which just add masks, color space and ICC profile fields after the same 40 bytes*/
+void ImageBMP::readInfoHeaderFromBytes(const unsigned char* bytes, size_t available)
+{
+	infoHeader.infoHeaderSize = littleEndian32(bytes);
+
+	//the first 40 bytes are common to every header we accept (readHeadersFromFile checks that they were read)
+	infoHeader.imageWidth = littleEndian32(bytes + 4);
+
+	//a negative height means the rows are stored top-down:
+	int signedHeight = (int)littleEndian32(bytes + 8);
+	infoHeader.topDown = signedHeight < 0;
+	infoHeader.imageHeight = infoHeader.topDown ? 0u - (unsigned int)signedHeight : (unsigned int)signedHeight;
+
+	infoHeader.planes = (short)littleEndian16(bytes + 12);
+	infoHeader.bitsPerPixel = (short)littleEndian16(bytes + 14);
+	infoHeader.compressionMethod = littleEndian32(bytes + 16);
+	infoHeader.sizeOfPixelData = littleEndian32(bytes + 20);
+
+	assert(infoHeader.remainingHeaderFields.size() == 4); //useless assertion? 
+
+	for (int i = 0; i < infoHeader.remainingHeaderFields.size(); ++i)
+	{
+		infoHeader.remainingHeaderFields.at(i) = (int)littleEndian32(bytes + 24 + 4 * i);
+	}
+
+	//BI_BITFIELDS: the R, G, B masks are either the next 12 bytes of a longer header,
+	//or - for the 40-byte one - the 12 bytes right after it (readHeadersFromFile reads those too)
+	infoHeader.bitfieldMasks = { 0x00'00'00'00, 0x00'00'00'00, 0x00'00'00'00 };
+
+	if (infoHeader.compressionMethod == 3 && available >= 52)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			infoHeader.bitfieldMasks[i] = littleEndian32(bytes + 40 + 4 * i);
+		}
+	}
+}
+
+/*reads whole rows and decodes them with a converter picked once from the header (see selectRowDecoder)
+- the headers must already have passed validateHeaders*/
+BMPStatus ImageBMP::readPixelDataFromFile(std::istream& fin)
+{
+	size_t bytesPerRow = ((size_t)infoHeader.imageWidth * infoHeader.bitsPerPixel + 31) / 32 * 4;
+
+	if (infoHeader.bitsPerPixel == 16)
+	{
+		//16-bit rows go straight into packedPixels (expanding, if wanted, is done afterwards with SIMD)
+		PixelFormat sixteenBitLayout = infoHeader.getSixteenBitLayout();
+
+		if (sixteenBitLayout == PixelFormat::BGRA32)
+		{
+			return BMPError::UnsupportedCompression;
+		}
+
+		std::streamsize paddingBytes = (std::streamsize)(bytesPerRow - (size_t)infoHeader.imageWidth * 2);
+
+		pixelData.pixelMatrix.release();
+		//(expandPixelData hands the buffer back - so reading many same-sized 16-bit files into BGRA32 reuses one)
+		pixelData.packedPixels = PixelBufferPool::instance().acquirePacked(infoHeader.imageWidth, infoHeader.imageHeight, sixteenBitLayout);
+		pixelData.storageFormat = sixteenBitLayout;
+
+		for (unsigned int fileRow = 0; fileRow < infoHeader.imageHeight; ++fileRow)
+		{
+			unsigned int row = infoHeader.topDown ? infoHeader.imageHeight - 1 - fileRow : fileRow;
+
+			fin.read(reinterpret_cast<char*>(&pixelData.packedPixels[(size_t)row * infoHeader.imageWidth]),
+				(std::streamsize)infoHeader.imageWidth * 2);
+			fin.ignore(paddingBytes);
+
+			if (fin.fail())
+			{
+				return BMPError::TruncatedPixelData;
+			}
+		}
+
+		return BMPError::None;
+	}
+
+	if (infoHeader.bitsPerPixel == 8)
+	{
+		return readPalettedPixelDataFromFile(fin, bytesPerRow);
+	}
+
+	RowDecoder decodeRow = selectRowDecoder(infoHeader.bitsPerPixel, infoHeader.getSixteenBitLayout());
+
+	if (decodeRow == nullptr)
+	{
+		return BMPError::UnsupportedBitDepth;
+	}
+
+	pixelData.pixelMatrix.assign(infoHeader.imageWidth, infoHeader.imageHeight);
+	pixelData.storageFormat = PixelFormat::BGRA32;
+
+	vector<unsigned char> rowBytes(bytesPerRow);
+
+	for (unsigned int fileRow = 0; fileRow < infoHeader.imageHeight; ++fileRow)
+	{
+		//(top-down files are flipped as they are read, so pixelMatrix[0] is always the bottom row)
+		unsigned int row = infoHeader.topDown ? infoHeader.imageHeight - 1 - fileRow : fileRow;
+
+		//padding included - it is simply ignored by decodeRow
+		fin.read(reinterpret_cast<char*>(rowBytes.data()), bytesPerRow);
+
+		if (fin.fail())
+			//fin.fail gets set to true if, for example, ... the `row` counter variable goes too far
+			//ex: 	for (int row = 0; row < infoHeader.imageHeight + 1; ++row)
+		{
+			return BMPError::TruncatedPixelData;
+		}
+
+		decodeRow(rowBytes.data(), pixelData.pixelMatrix[row].data(), infoHeader.imageWidth);
+	}
+
+	//(anything after the last row - eg: an ICC profile - is legal, and simply not read)
+	return BMPError::None;
+}
+
+/*8-bit rows are palette indices - each one is looked up in a 256-entry table of Colors*/
+BMPStatus ImageBMP::readPalettedPixelDataFromFile(std::istream& fin, size_t bytesPerRow)
+{
+	array<Color, 256> lookup{};
+
+	for (size_t i = 0; i < infoHeader.colorPalette.size() && i < lookup.size(); ++i)
+	{
+		lookup[i] = Color(infoHeader.colorPalette[i] | 0xFF'00'00'00); //palette alpha is "reserved" (usually 0)
+	}
+
+	bool grayscale = infoHeader.hasGrayscalePalette();
+
+	pixelData.pixelMatrix.assign(infoHeader.imageWidth, infoHeader.imageHeight);
+	pixelData.storageFormat = PixelFormat::BGRA32;
+
+	vector<unsigned char> rowBytes(bytesPerRow);
+
+	for (unsigned int fileRow = 0; fileRow < infoHeader.imageHeight; ++fileRow)
+	{
+		unsigned int row = infoHeader.topDown ? infoHeader.imageHeight - 1 - fileRow : fileRow;
+
+		fin.read(reinterpret_cast<char*>(rowBytes.data()), bytesPerRow);
+
+		if (fin.fail())
+		{
+			return BMPError::TruncatedPixelData;
+		}
+
+		if (grayscale)
+		{
+			//index == gray level, so the SIMD expansion does the lookup for us
+			decodeColorRow<FormatGray8>(rowBytes.data(), pixelData.pixelMatrix[row].data(), infoHeader.imageWidth);
+		}
+		else
+		{
+			for (unsigned int col = 0; col < infoHeader.imageWidth; ++col)
+			{
+				pixelData.pixelMatrix[row][col] = lookup[rowBytes[col]];
+			}
+		}
+	}
+
+	//we can only write the gray palette back - a colored 8-bit image gets saved as 24-bit instead:
+	setOutputFormat(grayscale ? PixelFormat::Gray8 : PixelFormat::BGR24);
+
+	return BMPError::None;
+}
+
+/*Modifies pixelData - no change to fileHeader or infoHeader*/
+void ImageBMP::drawRectangleOutline(unsigned int x0, unsigned int y0,
+	unsigned int rectangleWidth, unsigned int rectangleHeight, const Color& color)
+{
+
+	assert(x0 + rectangleWidth <= infoHeader.imageWidth);
+	assert(y0 + rectangleHeight <= infoHeader.imageHeight);
+
+	markDirty(x0, y0, rectangleWidth, 1);
+	markDirty(x0, y0 + rectangleHeight - 1, rectangleWidth, 1);
+	markDirty(x0, y0, 1, rectangleHeight);
+	markDirty(x0 + rectangleWidth - 1, y0, 1, rectangleHeight);
+
+	//tiled: the vertical edges walk down tile columns instead of touching a row per pixel
+	if (pixelData.isTiled())
+	{
+		pixelData.tiledPixels.drawRectangleOutline(x0, y0, rectangleWidth, rectangleHeight, color);
+		return;
+	}
+
+	// Top line
+	for (unsigned int i = x0; i < x0 + rectangleWidth; ++i)
+	{
+		pixelData.pixelMatrix.at(y0).at(i) = color;
+	}
+
+	// Bottom line
+	for (unsigned int i = x0; i < x0 + rectangleWidth; ++i)
+	{
+		pixelData.pixelMatrix.at(y0 + rectangleHeight - 1).at(i) = color;
+	}
+
+	// Left line
+	for (unsigned int i = y0; i < y0 + rectangleHeight; ++i)
+	{
+		pixelData.pixelMatrix.at(i).at(x0) = color;
+	}
+
+	// Right line
+	for (unsigned int i = y0; i < y0 + rectangleHeight; ++i)
+	{
+		pixelData.pixelMatrix.at(i).at(x0 + rectangleWidth - 1) = color;
+	}
+}
+
+void ImageBMP::fillRectangleWithColor(unsigned int x0, unsigned int y0, unsigned int rectangleWidth, unsigned int rectangleHeight, const Color& color)
+{
+	std::swap(x0, y0); //stupid, but ah well -> images use image[row][col], where row is y value and col is x value
+
+	//(the same pixels as the loops below: rows x0.., columns y0.. after the swap)
+	if (pixelData.isTiled())
+	{
+		pixelData.tiledPixels.fillRectangle(y0, x0, rectangleHeight, rectangleWidth, color);
+		markDirty(y0, x0, rectangleHeight, rectangleWidth);
+		return;
+	}
+
+	for (unsigned int row = x0; row < x0 + rectangleWidth; ++row)
+	{
+		for (unsigned int col = y0; col < y0 + rectangleHeight; ++col)
+		{
+			pixelData.pixelMatrix.at(row).at(col) = color;
+		}
+	}
+
+	//(rows x0.., columns y0.. after the swap above)
+	markDirty(y0, x0, rectangleHeight, rectangleWidth);
+}
+
+/*NOTE: this method will be swapping x and y (x is the ROW, y the column)
+- thickness > 1 stamps the (2 * thickness + 1)-pixel square around the center, clipped to the image*/
+void ImageBMP::setPixelToColor_withThickness(unsigned int x, unsigned int y, const Color& color, unsigned int thickness)
+{
+	if (x >= infoHeader.imageHeight || y >= infoHeader.imageWidth)
+	{
+		std::cout << "Error: Center pixel out of bounds.\n";
+		return;
+	}
+
+	unsigned int reach = (thickness > 1) ? thickness : 0;
+
+	//(markDirty clips too)
+	markDirty((int)y - (int)reach, (int)x - (int)reach, 2 * reach + 1, 2 * reach + 1);
+
+	if (pixelData.isTiled())
+	{
+		pixelData.tiledPixels.fillSquare(y, x, reach, color);
+		return;
+	}
+
+	//(signed, so the square can hang over the bottom/left edge)
+	long long firstRow = std::max<long long>((long long)x - reach, 0);
+	long long endRow = std::min<long long>((long long)x + reach + 1, infoHeader.imageHeight);
+	long long firstCol = std::max<long long>((long long)y - reach, 0);
+	long long endCol = std::min<long long>((long long)y + reach + 1, infoHeader.imageWidth);
+
+	for (long long row = firstRow; row < endRow; ++row)
+	{
+		PixelRow<Color> pixels = pixelData.pixelMatrix[(size_t)row];
+		std::fill(pixels.begin() + firstCol, pixels.begin() + endCol, color);
+	}
+}
+
+/*purpose: to gain experience with "scanline" algorithms*/
+void ImageBMP::drawAndFillAnIrregularShape()
+{
+}
+
+unsigned long long ImageBMP::floodFill(int x, int y, const Color& fillColor, unsigned int tolerance)
+{
+	untilePixelData();
+
+	assert(pixelData.storageFormat == PixelFormat::BGRA32);
+
+	ImageView whole(pixelData.pixelMatrix.data(), pixelData.pixelMatrix.getWidth(), pixelData.pixelMatrix.getHeight(),
+		pixelData.pixelMatrix.getWidth());
+
+	//(a view made here rather than with view(), which would count the whole image as changed)
+	FillResult filled = ::floodFill(whole, x, y, fillColor, tolerance);
+	markDirty(filled.bounds.x, filled.bounds.y, filled.bounds.width, filled.bounds.height);
+
+	return filled.filledPixels;
+}
+
+void ImageBMP::markDirty(int x0, int y0, unsigned int rectangleWidth, unsigned int rectangleHeight)
+{
+	//clip to the image (64-bit, so x0 + width can't wrap):
+	long long left = std::max<long long>(x0, 0);
+	long long bottom = std::max<long long>(y0, 0);
+	long long right = std::min<long long>((long long)x0 + rectangleWidth, infoHeader.imageWidth);
+	long long top = std::min<long long>((long long)y0 + rectangleHeight, infoHeader.imageHeight);
+
+	if (left < right && bottom < top)
+	{
+		dirtyRegion.add((unsigned int)left, (unsigned int)bottom, (unsigned int)(right - left), (unsigned int)(top - bottom));
+	}
+}
+
+vector<DirtyRectangle> ImageBMP::getDirtyRectangles() const
+{
+	return dirtyRegion.getRectangles();
+}
+
+void ImageBMP::clearDirty()
+{
+	dirtyRegion.reset(infoHeader.imageHeight);
+}
+
+void ImageBMP::compactPixelData(PixelFormat format)
+{
+	assert(format == PixelFormat::RGB565 || format == PixelFormat::RGB555);
+
+	untilePixelData();
+
+	if (pixelData.storageFormat != PixelFormat::BGRA32)
+	{
+		expandPixelData(); //eg: 565 -> 555 goes through BGRA32
+	}
+
+	pixelData.packedPixels = PixelBufferPool::instance().acquirePacked(infoHeader.imageWidth, infoHeader.imageHeight, format);
+
+	//both layouts are unpadded and contiguous, so the whole image is one run of pixels:
+	packBGRA32To16Bit(&pixelData.pixelMatrix.data()->bgra, pixelData.packedPixels.data(), pixelData.packedPixels.size(), format);
+
+	pixelData.pixelMatrix.release();
+	pixelData.storageFormat = format;
+
+	//the file format follows - 16-bit BI_BITFIELDS with the matching masks:
+	setOutputFormat(format);
+}
+
+void ImageBMP::expandPixelData()
+{
+	if (pixelData.storageFormat == PixelFormat::BGRA32)
+	{
+		return;
+	}
+
+	pixelData.pixelMatrix.assign(infoHeader.imageWidth, infoHeader.imageHeight);
+
+	unpack16BitToBGRA32(pixelData.packedPixels.data(), &pixelData.pixelMatrix.data()->bgra,
+		pixelData.packedPixels.size(), pixelData.storageFormat);
+
+	PixelBufferPool::instance().releasePacked(infoHeader.imageWidth, infoHeader.imageHeight, pixelData.storageFormat,
+		std::move(pixelData.packedPixels));
+	vector<unsigned short>().swap(pixelData.packedPixels); //(in case the pool was full and didn't take it)
+	pixelData.storageFormat = PixelFormat::BGRA32;
+}
+
+void ImageBMP::tilePixelData()
+{
+	if (pixelData.isTiled())
+	{
+		return;
+	}
+
+	expandPixelData(); //(tiles hold one Color per pixel)
+
+	pixelData.tiledPixels = TiledPixelMatrix::fromRows(pixelData.pixelMatrix);
+	pixelData.pixelMatrix.release();
+}
+
+void ImageBMP::untilePixelData()
+{
+	if (!pixelData.isTiled())
+	{
+		return;
+	}
+
+	pixelData.pixelMatrix = pixelData.tiledPixels.toRows();
+	pixelData.tiledPixels.release();
+}
+
+void ImageBMP::setOutputFormat(PixelFormat format)
+{
+	//compact storage must always match the file layout, so changing away from it unpacks first:
+	if (pixelData.storageFormat != PixelFormat::BGRA32 && pixelData.storageFormat != format)
+	{
+		expandPixelData();
+	}
+
+	infoHeader.infoHeaderSize = 40;
+	infoHeader.colorPalette.clear();
+
+	switch (format)
+	{
+	case PixelFormat::BGRA32:
+		infoHeader.bitsPerPixel = 32;
+		infoHeader.compressionMethod = 0;
+		break;
+
+	case PixelFormat::BGR24:
+		infoHeader.bitsPerPixel = 24;
+		infoHeader.compressionMethod = 0;
+		break;
+
+	case PixelFormat::RGB565:
+		infoHeader.bitsPerPixel = 16;
+		infoHeader.compressionMethod = 3;
+		infoHeader.bitfieldMasks = { rgb565RedMask, rgb565GreenMask, rgb565BlueMask };
+		break;
+
+	case PixelFormat::RGB555:
+		infoHeader.bitsPerPixel = 16;
+		infoHeader.compressionMethod = 3;
+		infoHeader.bitfieldMasks = { rgb555RedMask, rgb555GreenMask, rgb555BlueMask };
+		break;
+
+	case PixelFormat::Gray8:
+		infoHeader.bitsPerPixel = 8;
+		infoHeader.compressionMethod = 0;
+
+		//entry i is (i, i, i), so a pixel's gray level can be written as its palette index
+		infoHeader.colorPalette.resize(256);
+		for (unsigned int i = 0; i < 256; ++i)
+		{
+			infoHeader.colorPalette[i] = (i << 16) | (i << 8) | i;
+		}
+		break;
+
+	default:
+		assert(false && "no BMP layout for this pixel format");
+		return;
+	}
+
+	infoHeader.remainingHeaderFields.at(2) = (int)infoHeader.colorPalette.size(); //"colors used"
+	refreshHeaderSizes();
+}
+
+void ImageBMP::refreshHeaderSizes()
+{
+	unsigned int bytesPerRow = ((infoHeader.imageWidth * infoHeader.bitsPerPixel + 31) / 32) * 4;
+
+	infoHeader.sizeOfPixelData = bytesPerRow * infoHeader.imageHeight;
+	//14-byte file header, then the info header (plus the 12 bytes of masks for BI_BITFIELDS, or the palette):
+	fileHeader.indexOfPixelData = 14 + infoHeader.infoHeaderSize + (infoHeader.compressionMethod == 3 ? 12 : 0)
+		+ (unsigned int)infoHeader.colorPalette.size() * 4;
+	fileHeader.fileSize = fileHeader.indexOfPixelData + infoHeader.sizeOfPixelData;
+}
+
+
+unsigned int InfoHeader::getInfoHeaderSize() const
+{
+	return infoHeaderSize;
+}
+
+unsigned int FileHeader::getIndexOfPixelData() const
+{
+	return indexOfPixelData;
+}
+
+unsigned int InfoHeader::getSizeOfPixelData() const
+{
+	//return sizeOfPixelData;
+	return imageWidth * imageHeight * (bitsPerPixel / 8);
+}
+
+short InfoHeader::getBitsPerPixel() const
+{
+	return bitsPerPixel;
 }
 
-ImageBMP::ImageBMP(const string& filepath)
+unsigned int InfoHeader::getCompressionMethod() const
 {
-	readImageBMP(filepath);
+	return compressionMethod;
 }
 
-void ImageBMP::readImageBMP(string inputFilename)
+PixelFormat InfoHeader::getSixteenBitLayout() const
 {
-	ifstream fin{ inputFilename, std::ios::binary };
-
-	if (!fin)
+	if (compressionMethod == 3)
 	{
-		std::cout << "File " << inputFilename << " not found.\n";
-		std::cin.get();
-		return;
+		return pixelFormatFromBitfieldMasks(bitfieldMasks[0], bitfieldMasks[1], bitfieldMasks[2]);
 	}
 
-	//first read the file header info: 
-	readFileHeaderFromFile(fin);
-
-	//now read info header: 
-	readInfoHeaderFromFile(fin);
-
-	readPixelDataFromFile(fin);
-
-	//pixelData.pixelMatrix; 
-
-
-	//0xb6
-	//0x03'A9'B6
-
-	fin.close();
+	return PixelFormat::RGB555; //BI_RGB 16-bit files are always 5-5-5
 }
 
-//only allow integer scaling (no 1.5x) 
-void ImageBMP::doublescaleImageBMP()
+const vector<unsigned int>& InfoHeader::getColorPalette() const
 {
-	unsigned int scalingFactor = 2;
+	return colorPalette;
+}
 
-	//first, make the needed updates to the headers: 
-	fileHeader.fileSize = fileHeader.fileSize + scalingFactor * scalingFactor * infoHeader.sizeOfPixelData;
+/*the palette (4 bytes per entry) follows the headers (and masks) for 8 bits per pixel or fewer
+- "colors used" entries, or all 2^bitsPerPixel if that is 0*/
+unsigned int InfoHeader::getPaletteEntryCount() const
+{
+	if (bitsPerPixel > 8)
+	{
+		return 0;
+	}
 
-	infoHeader.imageWidth = infoHeader.imageWidth * scalingFactor;
-	infoHeader.imageHeight = infoHeader.imageHeight * scalingFactor;
+	unsigned int paletteSize = (remainingHeaderFields.at(2) != 0)
+		? (unsigned int)remainingHeaderFields.at(2) : (1u << bitsPerPixel);
 
-	infoHeader.sizeOfPixelData = scalingFactor * scalingFactor * infoHeader.sizeOfPixelData;
-	//ex: if 3 rows and 3 cols (9) pixels originally, then 36 pixels for scalingFactor = 2
-	//since now 6 rows and 6 cols 
+	return std::min(paletteSize, 256u);
+}
 
-	//now, modify pixel data (the more complicated/interesting part of this function): 
+bool InfoHeader::isTopDown() const
+{
+	return topDown;
+}
 
-	std::vector<std::vector<Color>> newPixelMatrix(infoHeader.imageHeight, std::vector < Color>(infoHeader.imageWidth));
-	//int a;
+bool InfoHeader::hasGrayscalePalette() const
+{
+	if (colorPalette.size() != 256)
+	{
+		return false;
+	}
 
-	for (int row = 0; row < pixelData.pixelMatrix.size(); ++row)
+	for (unsigned int i = 0; i < 256; ++i)
 	{
-		for (int col = 0; col < pixelData.pixelMatrix.at(0).size(); ++col)
+		if ((colorPalette[i] & 0x00'FF'FF'FF) != ((i << 16) | (i << 8) | i))
 		{
-			std::vector<std::pair<int, int>> newIndices =
-			{
-				std::pair<int, int> {2 * row,			2 * col }, //newIndexCenter
-				std::pair<int, int> {2 * row + 1,		2 * col}, //newIndexAbove
-				std::pair<int, int> {2 * row + 1,		2 * col + 1}, //newIndexAboveAndRight
-				std::pair<int, int> {2 * row,			2 * col + 1}//newIndexToRight
-			};
-
-			for (auto& newIndex : newIndices)
-			{
-				newPixelMatrix.at(newIndex.first).at(newIndex.second) = pixelData.pixelMatrix.at(row).at(col);
-			}
-			//newPixelMatrix.at(newIndexCenter.first).at(newIndexCenter.second) = 
-			//	pixelData.pixelMatrix.at(row).at(col); 
-
-			//newPixelMatrix.at(newIndexAbove.first).at(newIndexAbove.second) =
-			//	pixelData.pixelMatrix.at(row).at(col);
-
-			//newPixelMatrix.at(newIndexAboveAndRight.first).at(newIndexAboveAndRight.second) =
-			//	pixelData.pixelMatrix.at(row).at(col);
-
-			//newPixelMatrix.at(newIndexCenter.first).at(newIndexCenter.second) =
-			//	pixelData.pixelMatrix.at(row).at(col);
-
+			return false;
 		}
 	}
-	//resize and copy new into old (the member variable that will live beyond this function scope): 
-	pixelData.pixelMatrix.resize(infoHeader.imageHeight, vector<Color>(infoHeader.imageWidth));
-
-	pixelData.pixelMatrix = newPixelMatrix;
-
-}
-
-
-void ImageBMP::readFileHeaderFromFile(ifstream& fin)
-{
-	char filetype[2];
-	fin.read(filetype, 2); //NOTE: fin.GET() appends null terminator! (\0)
-	fileHeader.filetype.at(0) = filetype[0];
-	fileHeader.filetype.at(1) = filetype[1];
-
-	char filesize[4];
-	fin.read(filesize, 4);
-
-	//DETAILED approach without bitshifting and bitwise OR: 
-	//auto first = (unsigned char)filesize[0];
-	//auto second= (unsigned char)filesize[1];
-	//auto third = (unsigned char)filesize[2];
-	//auto fourth = (unsigned char)filesize[3];
-	//cout << first + (second * pow(2, 8)) + (third*pow(2, 16)) + (fourth*pow(2, 24)) << "\n";
-
-	//equivalently (faster, probably): 
-	fileHeader.fileSize =
-		(
-			(unsigned char)filesize[0] << 0 |
-			(unsigned char)filesize[1] << 8 |
-			(unsigned char)filesize[2] << 16 |
-			(unsigned char)filesize[3] << 24
-			);
-	char reserved1And2[4];
-	fin.read(reserved1And2, 4);
-
-	fileHeader.reserved1And2 = (
-		(unsigned char)reserved1And2[0] << 0 |
-		(unsigned char)reserved1And2[1] << 8 |
-		(unsigned char)reserved1And2[2] << 16 |
-		(unsigned char)reserved1And2[3] << 24
-		);
-
-	char indexOfPixelData[4];
-	fin.read(indexOfPixelData, 4);
-	fileHeader.indexOfPixelData = (
-		(unsigned char)indexOfPixelData[0] << 0 |
-		(unsigned char)indexOfPixelData[1] << 8 |
-		(unsigned char)indexOfPixelData[2] << 16 |
-		(unsigned char)indexOfPixelData[3] << 24
-		);
-
-}
-
-void ImageBMP::readInfoHeaderFromFile(ifstream& fin)
-{
-	char infoHeaderSize[4];
-	fin.read(infoHeaderSize, 4);
-	infoHeader.infoHeaderSize =
-		(
-			(unsigned char)infoHeaderSize[0] << 0 |
-			(unsigned char)infoHeaderSize[1] << 8 |
-			(unsigned char)infoHeaderSize[2] << 16 |
-			(unsigned char)infoHeaderSize[3] << 24
-			);
-
-	/*a "safety check" here:*/
-	if (infoHeader.infoHeaderSize != 40)
-	{
-		//cout << "Hey! Listen!\n"; 
-		//cout << "Info header size is not 40! - it is " << infoHeader.infoHeaderSize << "\n";
-		//std::cin.get(); 
-	}
-
-
-	char imageWidth[4];
-	fin.read(imageWidth, 4);
-	infoHeader.imageWidth =
-		(
-			(unsigned char)imageWidth[0] << 0 |
-			(unsigned char)imageWidth[1] << 8 |
-			(unsigned char)imageWidth[2] << 16 |
-			(unsigned char)imageWidth[3] << 24
-			);
-
-	char imageHeight[4];
-	fin.read(imageHeight, 4);
-	infoHeader.imageHeight =
-		(
-			(unsigned char)imageHeight[0] << 0 |
-			(unsigned char)imageHeight[1] << 8 |
-			(unsigned char)imageHeight[2] << 16 |
-			(unsigned char)imageHeight[3] << 24
-			);
-
-	char planes[2];
-	fin.read(planes, 2);
-	infoHeader.planes =
-		(
-			(unsigned char)planes[0] << 0 |
-			(unsigned char)planes[1] << 8
-			);
-
-	char bitsPerPixel[2];
-	fin.read(bitsPerPixel, 2);
-	infoHeader.bitsPerPixel =
-		(
-			(unsigned char)bitsPerPixel[0] << 0 |
-			(unsigned char)bitsPerPixel[1] << 8
-			);
-
-	/*another "safety check" here:*/
-	if (infoHeader.bitsPerPixel != 32)
-	{
-		//cout << "Hey! Listen!\n";
-		//cout << "bitsPerPixel is not 32 (gbra)! - it is " << infoHeader.bitsPerPixel << "\n";
-		//std::cin.get();
-	}
-
-
-	char compressionMethod[4];
-	fin.read(compressionMethod, 4);
-	infoHeader.compressionMethod =
-		(
-			(unsigned char)compressionMethod[0] << 0 |
-			(unsigned char)compressionMethod[1] << 8 |
-			(unsigned char)compressionMethod[2] << 16 |
-			(unsigned char)compressionMethod[3] << 24
-			);
-
-	char sizeOfPixelData[4];
-	fin.read(sizeOfPixelData, 4);
-	infoHeader.sizeOfPixelData =
-		(
-			(unsigned char)sizeOfPixelData[0] << 0 |
-			(unsigned char)sizeOfPixelData[1] << 8 |
-			(unsigned char)sizeOfPixelData[2] << 16 |
-			(unsigned char)sizeOfPixelData[3] << 24
-			);
 
+	return true;
+}
 
-	assert(infoHeader.remainingHeaderFields.size() == 4); //useless assertion? 
+unsigned int Color::convertToUnsignedInt()
+{
+	return bgra;
+}
 
-	for (int i = 0; i < infoHeader.remainingHeaderFields.size(); ++i)
-	{
-		char remainingHeaderFields[4];
-		fin.read(remainingHeaderFields, 4);
+PixelMatrix::PixelMatrix(unsigned int width, unsigned int height, const Color& fillColor)
+	: pixels((size_t)width * height, fillColor), width(width), height(height)
+{
+}
 
-		infoHeader.remainingHeaderFields.at(i) =
-			(
-				(unsigned char)remainingHeaderFields[0] << 0 |
-				(unsigned char)remainingHeaderFields[1] << 8 |
-				(unsigned char)remainingHeaderFields[2] << 16 |
-				(unsigned char)remainingHeaderFields[3] << 24
-				);
+PixelMatrix::PixelMatrix(const PixelMatrix& other)
+	: pixels(other.pixels), width(other.width), height(other.height)
+{
+}
 
+PixelMatrix& PixelMatrix::operator=(const PixelMatrix& other)
+{
+	if (this != &other)
+	{
+		returnBufferToPool();
+		pixels = other.pixels;
+		width = other.width;
+		height = other.height;
 	}
+	return *this;
 }
 
-
-/*Note: method is made ghastly long by handling 24 and 32 bit color*/
-void ImageBMP::readPixelDataFromFile(ifstream& fin)
+PixelMatrix::PixelMatrix(PixelMatrix&& other) noexcept
+	: pixels(std::move(other.pixels)), width(std::exchange(other.width, 0)), height(std::exchange(other.height, 0)),
+	pooled(std::exchange(other.pooled, false))
 {
+}
 
-	if (infoHeader.bitsPerPixel == 32)
+PixelMatrix& PixelMatrix::operator=(PixelMatrix&& other) noexcept
+{
+	if (this != &other)
 	{
-		pixelData.pixelMatrix.resize(infoHeader.imageHeight,
-			std::vector<Color>(infoHeader.imageWidth));	//CAREFUL to resize as a TWO-d array - NOT 1D!
-
-		for (unsigned int row = 0; row < infoHeader.imageHeight; ++row)
-		{
-			for (unsigned int col = 0; col < infoHeader.imageWidth; ++col)
-			{
-				char bgra[4];
-				fin.read(bgra, 4);
-
-				if (fin.fail())
-					//fin.fail gets set to true if, for example, ... the `row` counter variable goes too far
-					//ex: 	for (int row = 0; row < infoHeader.imageHeight + 1; ++row)
-				{
-					std::cout << "Error: Attempted to read beyond the end of the file at row " << row << ", col " << col << ".\n";
-					std::cin.get();
-					return;
-				}
-
-				Color currentPixelColor
-				{ (unsigned int)(unsigned char)bgra[0], (unsigned int)(unsigned char)bgra[1] ,
-					(unsigned int)(unsigned char)bgra[2] , (unsigned int)(unsigned char)bgra[3] };
-				if (col < infoHeader.imageWidth)
-				{
-					pixelData.pixelMatrix.at(row).at(col) = currentPixelColor;
-				}
-
-				else
-				{
-					std::cout << "Error: Attempted to access out-of-bounds pixel at row " << row << ", col " << col << ".\n";
-					std::cin.get();
-					return;
-				}
-
-			}
-		}
+		returnBufferToPool();
+		pixels = std::move(other.pixels);
+		width = std::exchange(other.width, 0);
+		height = std::exchange(other.height, 0);
+		pooled = std::exchange(other.pooled, false);
+	}
+	return *this;
+}
 
-		int lastThingInFile = fin.get(); //should be -1, I think
+PixelMatrix::~PixelMatrix()
+{
+	returnBufferToPool();
+}
 
-		//confirm that the end of the file was reached:
-		if (!fin.eof())
-		{
-			std::cout << "Hey!\nListen\n EOF was not reached? Is there more pixel data? \n";
-			std::cin.get();
-		}
+void PixelMatrix::returnBufferToPool()
+{
+	if (pooled)
+	{
+		PixelBufferPool::instance().releaseColors(width, height, std::move(pixels));
+		pixels = vector<Color>();
+		pooled = false;
 	}
+}
 
-	else
+void PixelMatrix::assign(unsigned int newWidth, unsigned int newHeight, const Color& fillColor)
+{
+	if (pooled && (newWidth != width || newHeight != height))
 	{
-		// Calculate the number of bytes per pixel based on the bit depth
-		int bytesPerPixel = infoHeader.bitsPerPixel / 8;
-
-		// Calculate the padding bytes per row (each row is padded to a multiple of 4 bytes)
-		int paddingBytes = (4 - (infoHeader.imageWidth * bytesPerPixel) % 4) % 4;
-
-		//cout << "not 32 bits per pixel\n";
-		pixelData.pixelMatrix.resize(infoHeader.imageHeight,
-			std::vector<Color>(infoHeader.imageWidth));	//CAREFUL to resize as a TWO-d array - NOT 1D!
-
-		for (unsigned int row = 0; row < infoHeader.imageHeight; ++row)
-		{
-			for (unsigned int col = 0; col < infoHeader.imageWidth; ++col)
-			{
-				char bgr[3];
-				fin.read(bgr, 3);
-
-				if (fin.fail())
-					//fin.fail gets set to true if, for example, ... the `row` counter variable goes too far
-					//ex: 	for (int row = 0; row < infoHeader.imageHeight + 1; ++row)
-				{
-					std::cout << "Error: Attempted to read beyond the end of the file at row " << row << ", col " << col << ".\n";
-					std::cin.get();
-					return;
-				}
-
-				Color currentPixelColor
-				{ (unsigned int)(unsigned char)bgr[0], (unsigned int)(unsigned char)bgr[1] ,
-					(unsigned int)(unsigned char)bgr[2] };
-				if (col < infoHeader.imageWidth)
-				{
-					pixelData.pixelMatrix.at(row).at(col) = currentPixelColor;
-				}
+		assignFromPool(newWidth, newHeight, fillColor);
+		return;
+	}
 
-				else
-				{
-					std::cout << "Error: Attempted to access out-of-bounds pixel at row " << row << ", col " << col << ".\n";
-					std::cin.get();
-					return;
-				}
+	pixels.assign((size_t)newWidth * newHeight, fillColor);
+	width = newWidth;
+	height = newHeight;
+}
 
-			}
-			// Skip the padding bytes at the end of each row
-			fin.ignore(paddingBytes);
+void PixelMatrix::assignFromPool(unsigned int newWidth, unsigned int newHeight, const Color& fillColor)
+{
+	acquireFromPool(newWidth, newHeight);
 
-		}
+	//(a recycled buffer still holds the previous image)
+	std::fill(pixels.begin(), pixels.end(), fillColor);
+}
 
-		//int counter = 0; 
-		//while (!fin.eof())
-		//{
-			//counter++; 
-		int lastThingInFile = fin.get(); //should be -1, I think
-		//}
+void PixelMatrix::acquireFromPool(unsigned int newWidth, unsigned int newHeight)
+{
+	returnBufferToPool();
 
-		//confirm that the end of the file was reached:
-		if (!fin.eof())
-		{
-			std::cout << "Hey!\nListen\n EOF was not reached? Is there more pixel data? \n";
-			std::cin.get();
-		}
-	}
+	pixels = PixelBufferPool::instance().acquireColors(newWidth, newHeight);
+	width = newWidth;
+	height = newHeight;
+	pooled = true;
 }
 
-/*Modifies pixelData - no change to fileHeader or infoHeader*/
-void ImageBMP::drawRectangleOutline(unsigned int x0, unsigned int y0,
-	unsigned int rectangleWidth, unsigned int rectangleHeight, const Color& color)
+void DirtyRegion::reset(unsigned int height)
 {
+	rowSpans.assign(height, { 0u, 0u });
+	firstDirtyRow = 0;
+	endDirtyRow = 0;
+}
 
-	assert(x0 + rectangleWidth <= infoHeader.imageWidth);
-	assert(y0 + rectangleHeight <= infoHeader.imageHeight);
-
-	// Top line
-	for (unsigned int i = x0; i < x0 + rectangleWidth; ++i)
+void DirtyRegion::add(unsigned int x0, unsigned int y0, unsigned int width, unsigned int height)
+{
+	if (width == 0 || height == 0)
 	{
-		pixelData.pixelMatrix.at(y0).at(i) = color;
+		return;
 	}
 
-	// Bottom line
-	for (unsigned int i = x0; i < x0 + rectangleWidth; ++i)
+	if (rowSpans.size() < (size_t)y0 + height)
 	{
-		pixelData.pixelMatrix.at(y0 + rectangleHeight - 1).at(i) = color;
+		rowSpans.resize((size_t)y0 + height, { 0u, 0u });
 	}
 
-	// Left line
-	for (unsigned int i = y0; i < y0 + rectangleHeight; ++i)
+	for (unsigned int row = y0; row < y0 + height; ++row)
 	{
-		pixelData.pixelMatrix.at(i).at(x0) = color;
+		std::pair<unsigned int, unsigned int>& span = rowSpans[row];
+
+		if (span.first >= span.second)
+		{
+			span = { x0, x0 + width };
+		}
+		else
+		{
+			span.first = std::min(span.first, x0);
+			span.second = std::max(span.second, x0 + width);
+		}
 	}
 
-	// Right line
-	for (unsigned int i = y0; i < y0 + rectangleHeight; ++i)
+	if (isClean())
 	{
-		pixelData.pixelMatrix.at(i).at(x0 + rectangleWidth - 1) = color;
+		firstDirtyRow = y0;
+		endDirtyRow = y0 + height;
+	}
+	else
+	{
+		firstDirtyRow = std::min(firstDirtyRow, y0);
+		endDirtyRow = std::max(endDirtyRow, y0 + height);
 	}
 }
 
-void ImageBMP::fillRectangleWithColor(unsigned int x0, unsigned int y0, unsigned int rectangleWidth, unsigned int rectangleHeight, const Color& color)
+std::pair<unsigned int, unsigned int> DirtyRegion::getRowSpan(unsigned int row) const
 {
-	std::swap(x0, y0); //stupid, but ah well -> images use image[row][col], where row is y value and col is x value
-
-	for (unsigned int row = x0; row < x0 + rectangleWidth; ++row)
+	if (row < firstDirtyRow || row >= endDirtyRow)
 	{
-		for (unsigned int col = y0; col < y0 + rectangleHeight; ++col)
-		{
-			pixelData.pixelMatrix.at(row).at(col) = color;
-		}
+		return { 0u, 0u };
 	}
-
+	return rowSpans[row];
 }
 
-/*NOTE: this method will be swapping x and y */
-void ImageBMP::setPixelToColor_withThickness(unsigned int x, unsigned int y, const Color& color, unsigned int thickness)
+vector<DirtyRectangle> DirtyRegion::getRectangles() const
 {
-	if (x >= infoHeader.imageWidth || y >= infoHeader.imageHeight)
+	vector<DirtyRectangle> rectangles;
+
+	for (unsigned int row = firstDirtyRow; row < endDirtyRow; ++row)
 	{
-		std::cout << "Error: Center pixel out of bounds.\n";
-		return;
-	}
+		std::pair<unsigned int, unsigned int> span = rowSpans[row];
 
-	//center pixel 
-	pixelData.pixelMatrix[x][y] = color;
+		if (span.first >= span.second)
+		{
+			continue;
+		}
 
+		DirtyRectangle* last = rectangles.empty() ? nullptr : &rectangles.back();
 
-	if (thickness > 1)
-	{
-		//neighbors within thickness:
-		for (unsigned int row = -1 * (int)thickness; row <= (int)thickness; ++row)
+		if (last != nullptr && last->y + last->height == row && last->x == span.first && last->x + last->width == span.second)
 		{
-			for (unsigned int col = -1 * (int)thickness; col < (int)thickness; ++col)
-			{
-				int newX = x + col;
-				int newY = y + row;
-
-				// Ensure the new coordinates are within bounds
-				if (newX >= 0
-					&& newX < static_cast<int>(infoHeader.imageWidth)
-					&& newY >= 0
-					&& newY < static_cast<int>(infoHeader.imageHeight))
-				{
-					pixelData.pixelMatrix[newX][newY] = color;
-				}
-
-			}
+			++last->height;
+		}
+		else
+		{
+			rectangles.push_back({ span.first, row, span.second - span.first, 1 });
 		}
 	}
 
+	return rectangles;
 }
 
-/*purpose: to gain experience with "scanline" algorithms*/
-void ImageBMP::drawAndFillAnIrregularShape()
+ImageView::ImageView(Color* origin, unsigned int width, unsigned int height, size_t stride,
+	unsigned int originX, unsigned int originY)
+	: origin(origin), width(width), height(height), stride(stride), originX(originX), originY(originY)
 {
 }
 
-
-unsigned int InfoHeader::getInfoHeaderSize() const
+void ImageView::setPixel(int x, int y, const Color& color) const
 {
-	return infoHeaderSize;
+	if (contains(x, y))
+	{
+		origin[(size_t)y * stride + x] = color;
+	}
 }
 
-unsigned int InfoHeader::getSizeOfPixelData() const
+void ImageView::fill(const Color& color) const
 {
-	//return sizeOfPixelData;
-	return imageWidth * imageHeight * (bitsPerPixel / 8);
+	for (unsigned int y = 0; y < height; ++y)
+	{
+		std::fill_n(origin + y * stride, width, color);
+	}
 }
 
-Color::Color(unsigned int bgra)
-	:bgra(bgra)
+void ImageView::fillRectangle(int x0, int y0, unsigned int rectangleWidth, unsigned int rectangleHeight, const Color& color) const
 {
+	//clip to the view (64-bit, so x0 + rectangleWidth can't wrap):
+	long long left = std::max<long long>(x0, 0);
+	long long bottom = std::max<long long>(y0, 0);
+	long long right = std::min<long long>((long long)x0 + rectangleWidth, width);
+	long long top = std::min<long long>((long long)y0 + rectangleHeight, height);
+
+	for (long long y = bottom; y < top; ++y)
+	{
+		std::fill(origin + y * stride + left, origin + y * stride + std::max(left, right), color);
+	}
 }
 
-Color::Color(unsigned int b, unsigned int g, unsigned int r)
+ImageView ImageView::subView(unsigned int x0, unsigned int y0, unsigned int subWidth, unsigned int subHeight) const
 {
-	bgra = (b << 0) | (g << 8) | (r << 16) | (0xFF << 24); // Set alpha to 255
+	if (x0 >= width || y0 >= height)
+	{
+		return ImageView(origin, 0, 0, stride, originX + std::min(x0, width), originY + std::min(y0, height));
+	}
+
+	subWidth = std::min(subWidth, width - x0);
+	subHeight = std::min(subHeight, height - y0);
+
+	return ImageView(origin + y0 * stride + x0, subWidth, subHeight, stride, originX + x0, originY + y0);
 }
 
-Color::Color(unsigned int b, unsigned int g, unsigned int r, unsigned int a)
+void PixelMatrix::release()
 {
-	bgra =
-		(
-			b << 0 |
-			g << 8 |
-			r << 16 |
-			a << 24
-			);
+	returnBufferToPool();
+
+	//(clear() alone would keep the memory)
+	vector<Color>().swap(pixels);
+	width = 0;
+	height = 0;
 }
 
-Color::Color(ColorEnum colorEnum)
-	:bgra((unsigned int)colorEnum) //note the typecast
+PixelRow<Color> PixelMatrix::at(size_t row)
 {
-
+	if (row >= height)
+	{
+		throw std::out_of_range("PixelMatrix::at - row out of range");
+	}
+	return (*this)[row];
 }
 
-unsigned int Color::convertToUnsignedInt()
+PixelRow<const Color> PixelMatrix::at(size_t row) const
 {
-	return bgra;
+	if (row >= height)
+	{
+		throw std::out_of_range("PixelMatrix::at - row out of range");
+	}
+	return (*this)[row];
 }
 
 
 
 
 
+const char* describeBMPError(BMPError error)
+{
+	switch (error)
+	{
+	case BMPError::None: return "no error";
+	case BMPError::FileNotFound: return "file not found (or could not be opened)";
+	case BMPError::CannotCreateFile: return "could not create the output file";
+	case BMPError::NotABMP: return "not a BMP file (no 'BM' signature)";
+	case BMPError::TruncatedHeader: return "file ends inside the headers";
+	case BMPError::UnsupportedHeaderSize: return "unsupported info header size";
+	case BMPError::UnsupportedBitDepth: return "unsupported bits per pixel";
+	case BMPError::UnsupportedCompression: return "unsupported compression method (or bitfield masks)";
+	case BMPError::BadDimensions: return "width or height is zero or out of range";
+	case BMPError::DimensionOverflow: return "width * height is too large";
+	case BMPError::BadPixelDataOffset: return "pixel data offset points inside the headers or past the end of the file";
+	case BMPError::TruncatedPixelData: return "file ends before the last row of pixels";
+	case BMPError::WriteFailed: return "writing the file failed";
+	case BMPError::ReadFailed: return "reading the file failed (I/O error)";
+	case BMPError::ExceedsDecodeLimits: return "image is larger than the decode limits allow";
+	case BMPError::BufferTooSmall: return "the buffer is smaller than the encoded image";
+	default: return "unknown error";
+	}
+}
+
+
+
 #pragma region auxillary functions
 
 /*[1, 2, 3] will become
@@ -673,27 +1754,49 @@ std::vector<std::vector<int>> rotateIntMatrixClockwise
 
 #ifdef __cplusplus
 #if __cplusplus >= 201703L
-std::vector<ImageBMP> getAllImagesInFolder(std::string folderName)
+std::vector<ImageBMP> getAllImagesInFolder(const std::string& folderName)
 {
 	std::vector<ImageBMP> allImagesInFolder;
 
-	auto startPath = std::filesystem::current_path();
-	//set current directory to folder name to get images from: 
-	auto newPath = startPath.string() + folderName;
-	std::filesystem::current_path(newPath);
-
-	for (auto& entry : std::filesystem::directory_iterator(newPath))
+	for (auto& namedImage : getAllNamedImagesInFolder(folderName))
 	{
-		//cout << entry.path() << "\n";
-		//ImageBMP currentPieceImage{}
-		ImageBMP currentPieceImage{ entry.path().string() };
+		allImagesInFolder.push_back(std::move(namedImage.second));
+	}
 
-		allImagesInFolder.push_back(currentPieceImage);
+	return allImagesInFolder;
+}
+
+vector<std::pair<string, ImageBMP>> getAllNamedImagesInFolder(const string& folderName)
+{
+	vector<std::pair<string, ImageBMP>> allImagesInFolder;
+
+	//(the folder is relative to the current directory, but we never CHANGE the current directory
+	//- that is process-wide, and would break any other thread using relative paths meanwhile)
+	auto folderPath = std::filesystem::current_path().string() + folderName;
+
+	vector<std::filesystem::path> filenames;
+	for (auto& entry : std::filesystem::directory_iterator(folderPath))
+	{
+		filenames.push_back(entry.path());
 	}
 
+	//one file per task - each one only touches its own slot:
+	vector<ImageBMP> images(filenames.size());
+	vector<char> readOK(filenames.size(), 0);
+
+	ThreadPool::shared().parallelFor(0, filenames.size(), [&](size_t i)
+		{
+			readOK[i] = (bool)images[i].tryReadImageBMP(filenames[i].string());
+		});
 
-	//reset path to where main cpp file is
-	std::filesystem::current_path(startPath);
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		//anything that isn't a readable BMP (a readme, a corrupt file...) is skipped rather than stopping the whole folder
+		if (readOK[i])
+		{
+			allImagesInFolder.emplace_back(filenames[i].stem().string(), std::move(images[i]));
+		}
+	}
 
 	return allImagesInFolder;
 }
@@ -705,6 +1808,50 @@ map<char, vector<vector<char>>> makeMapOfPixelLetters()
 {
 	map<char, vector<vector<char>>> mapOfPixelLetters;
 
+	vector<vector<char>> matrixForA =
+	{
+		{' ',' ',' ','A','A',' ',' ',' ',' ',' ',' ',' ',' ',' ',' ',' '},
+		{' ',' ','A',' ',' ','A',' ',' ',' ',' ',' ',' ',' ',' ',' ',' '},
+		{' ','A',' ',' ',' ',' ','A',' ',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'A',' ',' ',' ',' ',' ',' ','A',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'A',' ',' ',' ',' ',' ',' ','A',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'A',' ',' ',' ',' ',' ',' ','A',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'A',' ',' ',' ',' ',' ',' ','A',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'A',' ',' ',' ',' ',' ',' ','A',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'A','A','A','A','A','A','A','A',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'A',' ',' ',' ',' ',' ',' ','A',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'A',' ',' ',' ',' ',' ',' ','A',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'A',' ',' ',' ',' ',' ',' ','A',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'A',' ',' ',' ',' ',' ',' ','A',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'A',' ',' ',' ',' ',' ',' ','A',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'A',' ',' ',' ',' ',' ',' ','A',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'A',' ',' ',' ',' ',' ',' ','A',' ',' ',' ',' ',' ',' ',' ',' '}
+	};
+
+	mapOfPixelLetters.insert({ 'A', matrixForA });
+
+	vector<vector<char>> matrixForB =
+	{
+		{'B','B','B','B','B','B','B',' ',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'B',' ',' ',' ',' ',' ',' ','B',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'B',' ',' ',' ',' ',' ',' ','B',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'B',' ',' ',' ',' ',' ',' ','B',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'B',' ',' ',' ',' ',' ',' ','B',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'B',' ',' ',' ',' ',' ',' ','B',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'B',' ',' ',' ',' ',' ',' ','B',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'B','B','B','B','B','B','B',' ',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'B',' ',' ',' ',' ',' ',' ','B',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'B',' ',' ',' ',' ',' ',' ','B',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'B',' ',' ',' ',' ',' ',' ','B',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'B',' ',' ',' ',' ',' ',' ','B',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'B',' ',' ',' ',' ',' ',' ','B',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'B',' ',' ',' ',' ',' ',' ','B',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'B',' ',' ',' ',' ',' ',' ','B',' ',' ',' ',' ',' ',' ',' ',' '},
+		{'B','B','B','B','B','B','B',' ',' ',' ',' ',' ',' ',' ',' ',' '}
+	};
+
+	mapOfPixelLetters.insert({ 'B', matrixForB });
+
 	vector<vector<char>> matrixForC =
 	{
 		{'C','C','C','C','C','C','C','C',' ',' ',' ',' ',' ',' ',' ',' '},
@@ -1028,4 +2175,74 @@ map<int, vector<vector<int>>> makeMapOfPixelNumbers()
 
 }
 
+void drawPixelText(const ImageView& target, int x, int y, const string& text, const Color& color, unsigned int scale)
+{
+	using Glyph = SmallImage<16, 16>;
+
+	//the letter and number matrices, turned once into inline masks (opaque where the glyph is drawn)
+	//- only read after that, so any number of threads can draw text at once
+	static const map<char, Glyph> glyphs = []
+	{
+		map<char, Glyph> made;
+
+		auto addGlyph = [&made](char character, auto& matrix)
+		{
+			Glyph& glyph = made[character];
+
+			//matrix row 0 is the TOP row, glyph row 0 the bottom one:
+			for (size_t row = 0; row < matrix.size() && row < Glyph::height; ++row)
+			{
+				for (size_t col = 0; col < matrix[row].size() && col < Glyph::width; ++col)
+				{
+					if (matrix[row][col] != 0 && matrix[row][col] != ' ')
+					{
+						glyph.at((unsigned int)col, (unsigned int)(Glyph::height - 1 - row)) = Color(ColorEnum::White);
+					}
+				}
+			}
+		};
+
+		for (auto& [letter, matrix] : makeMapOfPixelLetters())
+		{
+			addGlyph(letter, matrix);
+		}
+		for (auto& [number, matrix] : makeMapOfPixelNumbers())
+		{
+			addGlyph((char)('0' + number), matrix);
+		}
+		return made;
+	}();
+
+	const int glyphSize = (int)Glyph::width * (int)scale;
+
+	for (size_t i = 0; i < text.size(); ++i)
+	{
+		auto glyph = glyphs.find((char)std::toupper((unsigned char)text[i]));
+
+		if (glyph == glyphs.end())
+		{
+			continue;
+		}
+
+		int glyphX = x + (int)i * glyphSize;
+
+		if (scale == 1)
+		{
+			glyph->second.stampTo(target, glyphX, y, color);
+			continue;
+		}
+
+		for (unsigned int row = 0; row < Glyph::height; ++row)
+		{
+			for (unsigned int col = 0; col < Glyph::width; ++col)
+			{
+				if (glyph->second.at(col, row).bgra != 0)
+				{
+					target.fillRectangle(glyphX + (int)(col * scale), y + (int)(row * scale), scale, scale, color);
+				}
+			}
+		}
+	}
+}
+
 #pragma endregion
@@ -3,15 +3,32 @@
 #include<algorithm>
 #include<array>
 #include<cassert>
+#include<cstddef>
+#include<cstdint>
 #include<filesystem> 
 #include<fstream> 
+#include<functional>
 #include<iomanip> 
 #include<iostream>
+#include<iterator>
 #include<map> 
+#include<sstream>
+#include<stdexcept>
 #include<string>
 #include<unordered_map>
+#include<utility>
 #include <vector>
 
+#include "PixelFormat.h"
+
+//std::span overloads of the in-memory read/write functions - C++20 only
+#if (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L) || __cplusplus >= 202002L
+#if __has_include(<span>)
+#include<span>
+#define IMAGEBMP_HAS_SPAN 1
+#endif
+#endif
+
 
 #ifdef __cplusplus
 #if __cplusplus >= 201703L
@@ -28,6 +45,57 @@ using std::ofstream;
 using std::ifstream; 
 using std::string; 
 
+/*what went wrong while reading or writing a BMP file*/
+enum class BMPError : unsigned int
+{
+	None,
+	FileNotFound,
+	CannotCreateFile,
+	NotABMP,
+	TruncatedHeader,
+	UnsupportedHeaderSize,
+	UnsupportedBitDepth,
+	UnsupportedCompression,
+	BadDimensions,
+	DimensionOverflow,
+	BadPixelDataOffset,
+	TruncatedPixelData,
+	WriteFailed,
+	ReadFailed,
+	ExceedsDecodeLimits,
+	BufferTooSmall
+};
+
+const char* describeBMPError(BMPError error);
+
+/*returned by the try... read/write functions - tests true on success, so:
+	if (BMPStatus status = image.tryReadImageBMP(path); !status) { log(status.message()); }*/
+struct BMPStatus
+{
+	BMPError error = BMPError::None;
+
+	BMPStatus() = default;
+	BMPStatus(BMPError error) : error(error) {}
+
+	explicit operator bool() const { return error == BMPError::None; }
+	const char* message() const { return describeBMPError(error); }
+};
+
+/*how big an image a read may produce - checked against the headers before any pixel memory is allocated
+(the file-size checks alone still let a small 8-bit file decode to 4 times its size)
+- for files from untrusted sources, eg: DecodeLimits{ 8192, 8192, 32'000'000 }*/
+struct DecodeLimits
+{
+	unsigned int maxWidth = 0x7F'FF'FF'FF;
+	unsigned int maxHeight = 0x7F'FF'FF'FF;
+	unsigned long long maxPixels = ~0ull;
+
+	bool allows(unsigned int width, unsigned int height) const
+	{
+		return width <= maxWidth && height <= maxHeight && (unsigned long long)width * height <= maxPixels;
+	}
+};
+
 class FileHeader
 {
 	/*will make PRIVATE all of the bmp fields that (probably) never change
@@ -45,6 +113,9 @@ public:
 
 	FileHeader() = default;
 
+	/*where the pixel rows start in the file (eg: to read single rows - see BMPRegionReader)*/
+	unsigned int getIndexOfPixelData() const;
+
 	friend class ImageBMP;
 
 };
@@ -65,6 +136,16 @@ class InfoHeader
 		0x00'00'00'00//"important" color count 
 	};
 
+	//R, G, B masks - only present in the file (right after the 40 bytes above) when compressionMethod is 3 (BI_BITFIELDS)
+	array<unsigned int, 3> bitfieldMasks = { 0x00'00'00'00, 0x00'00'00'00, 0x00'00'00'00 };
+
+	//BGRA0 entries - only for files with 8 (or fewer) bits per pixel, where it sits between the headers and the pixels
+	vector<unsigned int> colorPalette;
+
+	//true if the file stored a negative height (first row in the file = TOP row of the image)
+	//- imageHeight itself is always positive, and pixelMatrix is always bottom-up
+	bool topDown = false;
+
 public:
 	unsigned int imageWidth = 0; //indices 18 - 21
 	unsigned int imageHeight = 0; //indices 22 - 25
@@ -73,6 +154,19 @@ public:
 
 	unsigned int getInfoHeaderSize() const;
 	unsigned int getSizeOfPixelData() const;
+	short getBitsPerPixel() const;
+	unsigned int getCompressionMethod() const;
+
+	/*RGB565 or RGB555 for 16-bit files (BGRA32 if the bitfield masks are neither)*/
+	PixelFormat getSixteenBitLayout() const;
+
+	const vector<unsigned int>& getColorPalette() const;
+	unsigned int getPaletteEntryCount() const;
+
+	bool isTopDown() const;
+
+	/*true for the palette setOutputFormat(PixelFormat::Gray8) writes (entry i is gray level i)*/
+	bool hasGrayscalePalette() const;
 
 	friend class ImageBMP;
 };
@@ -110,29 +204,376 @@ struct Color
 	//should be unsigned because 1) no "negative" colors and 2) having alpha = 255 (FF) is desirable
 	unsigned int bgra = 0x00'00'00'00;
 
-	Color() = default;
-	Color(unsigned int bgra);
-	Color(unsigned int b, unsigned int g, unsigned int r); // New constructor for 24-bit color
-	Color(unsigned int b, unsigned int g, unsigned int r, unsigned int a);
-	Color(ColorEnum colorEnum);
+	//(constexpr, so colors can be baked into constexpr sprites and glyphs - see SmallImage.h)
+	constexpr Color() = default;
+	constexpr Color(unsigned int bgra) : bgra(bgra) {}
+	constexpr Color(unsigned int b, unsigned int g, unsigned int r) // New constructor for 24-bit color
+		: bgra((b << 0) | (g << 8) | (r << 16) | (0xFFu << 24)) {} // Set alpha to 255
+	constexpr Color(unsigned int b, unsigned int g, unsigned int r, unsigned int a)
+		: bgra(b << 0 | g << 8 | r << 16 | a << 24) {}
+	constexpr Color(ColorEnum colorEnum) : bgra((unsigned int)colorEnum) {} //note the typecast
 
 	unsigned int convertToUnsignedInt();
 };
 
+/*a view of one row of a PixelMatrix - what pixelMatrix[row] (or .at(row)) gives you*/
+template<typename ColorType>
+class PixelRow
+{
+	ColorType* first = nullptr;
+	size_t count = 0;
+
+public:
+	PixelRow(ColorType* first, size_t count) : first(first), count(count) {}
+
+	ColorType& operator[](size_t col) const { return first[col]; }
+
+	ColorType& at(size_t col) const
+	{
+		if (col >= count)
+		{
+			throw std::out_of_range("PixelRow::at - column out of range");
+		}
+		return first[col];
+	}
+
+	ColorType* data() const { return first; }
+	size_t size() const { return count; }
+
+	ColorType* begin() const { return first; }
+	ColorType* end() const { return first + count; }
+};
+
+/*the pixels of an image as ONE contiguous block, row after row (row 0 = bottom row, as in the file)
+- pixelMatrix[row][col] and pixelMatrix.at(row).at(col) work as they did with vector<vector<Color>>
+- one allocation per image (instead of one per row), and a whole-image data() pointer for bulk work*/
+class PixelMatrix
+{
+	vector<Color> pixels;
+	unsigned int width = 0;
+	unsigned int height = 0;
+
+	//the buffer came from PixelBufferPool, and goes back there (instead of being freed)
+	bool pooled = false;
+
+	void returnBufferToPool();
+
+public:
+	PixelMatrix() = default;
+	PixelMatrix(unsigned int width, unsigned int height, const Color& fillColor = Color());
+
+	//(a copy always gets its own, non-pooled, buffer)
+	PixelMatrix(const PixelMatrix& other);
+	PixelMatrix& operator=(const PixelMatrix& other);
+
+	//a moved-from matrix is left empty (0 x 0), not with a stale size:
+	PixelMatrix(PixelMatrix&& other) noexcept;
+	PixelMatrix& operator=(PixelMatrix&& other) noexcept;
+
+	~PixelMatrix();
+
+	/*resizes (reusing the current buffer if it is big enough) and fills every pixel
+	- a pooled matrix swaps its buffer for a pooled one of the new size*/
+	void assign(unsigned int newWidth, unsigned int newHeight, const Color& fillColor = Color());
+
+	/*like assign, but the buffer is taken from PixelBufferPool (and handed back when the matrix is done with it)*/
+	void assignFromPool(unsigned int newWidth, unsigned int newHeight, const Color& fillColor = Color());
+
+	/*the same without the fill - the pixels are whatever the buffer's last user left*/
+	void acquireFromPool(unsigned int newWidth, unsigned int newHeight);
+
+	/*empties the matrix AND gives its memory back (to the pool, if it came from there)*/
+	void release();
+
+	bool isPooled() const { return pooled; }
+
+	PixelRow<Color> operator[](size_t row) { return PixelRow<Color>(pixels.data() + row * width, width); }
+	PixelRow<const Color> operator[](size_t row) const { return PixelRow<const Color>(pixels.data() + row * width, width); }
+
+	PixelRow<Color> at(size_t row);
+	PixelRow<const Color> at(size_t row) const;
+
+	Color* data() { return pixels.data(); }
+	const Color* data() const { return pixels.data(); }
+
+	//number of ROWS (like the old vector<vector<Color>>):
+	size_t size() const { return height; }
+	bool empty() const { return pixels.empty(); }
+
+	unsigned int getWidth() const { return width; }
+	unsigned int getHeight() const { return height; }
+};
+
+/*the same pixels as a PixelMatrix, stored in 64 x 64 tiles: each tile is one contiguous block (its rows bottom-up),
+tiles go left to right, then bottom to top - so a column, a square, or a tile being rotated touches a few blocks
+instead of one cache line per row of a wide image
+- tiles on the right/top edge are stored full size; the pixels beyond the image are never visited
+- x = column, y = row, row 0 = bottom, as everywhere else - BMP files are converted to/from rows at I/O time
+(see ImageBMP::tilePixelData)*/
+class TiledPixelMatrix
+{
+public:
+	static constexpr unsigned int tileShift = 6;
+	static constexpr unsigned int tileSize = 1u << tileShift;
+	static constexpr size_t pixelsPerTile = (size_t)tileSize * tileSize;
+
+private:
+	vector<Color> pixels;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	unsigned int tilesAcross = 0;
+	unsigned int tilesUp = 0;
+
+	//how much of the tile at (tileX, tileY) is inside the image:
+	unsigned int tileWidth(unsigned int tileX) const { return std::min(tileSize, width - (tileX << tileShift)); }
+	unsigned int tileHeight(unsigned int tileY) const { return std::min(tileSize, height - (tileY << tileShift)); }
+
+public:
+	/*every pixel inside the image, in storage order (tile by tile) - x() and y() say where the current one is*/
+	template<typename MatrixType, typename ColorType>
+	class PixelIterator
+	{
+		MatrixType* matrix = nullptr;
+		unsigned int tileX = 0, tileY = 0;
+		unsigned int localX = 0, localY = 0;
+
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = Color;
+		using difference_type = std::ptrdiff_t;
+		using pointer = ColorType*;
+		using reference = ColorType&;
+
+		PixelIterator() = default;
+		PixelIterator(MatrixType* matrix, unsigned int tileY) : matrix(matrix), tileY(tileY) {}
+
+		ColorType& operator*() const { return matrix->tileData(tileX, tileY)[(localY << tileShift) + localX]; }
+		ColorType* operator->() const { return &**this; }
+
+		unsigned int x() const { return (tileX << tileShift) + localX; }
+		unsigned int y() const { return (tileY << tileShift) + localY; }
+
+		PixelIterator& operator++()
+		{
+			if (++localX < matrix->tileWidth(tileX))
+			{
+				return *this;
+			}
+			localX = 0;
+
+			if (++localY < matrix->tileHeight(tileY))
+			{
+				return *this;
+			}
+			localY = 0;
+
+			if (++tileX < matrix->tilesAcross)
+			{
+				return *this;
+			}
+			tileX = 0;
+			++tileY;
+
+			return *this;
+		}
+
+		PixelIterator operator++(int)
+		{
+			PixelIterator before = *this;
+			++*this;
+			return before;
+		}
+
+		bool operator==(const PixelIterator& other) const
+		{
+			return tileY == other.tileY && tileX == other.tileX && localY == other.localY && localX == other.localX;
+		}
+		bool operator!=(const PixelIterator& other) const { return !(*this == other); }
+	};
+
+	using iterator = PixelIterator<TiledPixelMatrix, Color>;
+	using const_iterator = PixelIterator<const TiledPixelMatrix, const Color>;
+
+	TiledPixelMatrix() = default;
+	TiledPixelMatrix(unsigned int width, unsigned int height, const Color& fillColor = Color());
+
+	/*from/to the usual row layout - both done tile row by tile row on ThreadPool::shared()*/
+	static TiledPixelMatrix fromRows(const PixelMatrix& rows);
+	PixelMatrix toRows() const;
+
+	/*one image row, gathered from (or scattered to) the tiles it crosses - `width` pixels*/
+	void copyRowTo(unsigned int y, Color* destination) const;
+	void copyRowFrom(unsigned int y, const Color* source);
+
+	/*empties the matrix AND gives its memory back*/
+	void release();
+
+	Color& operator()(unsigned int x, unsigned int y) { return pixels[indexOf(x, y)]; }
+	const Color& operator()(unsigned int x, unsigned int y) const { return pixels[indexOf(x, y)]; }
+
+	size_t indexOf(unsigned int x, unsigned int y) const
+	{
+		size_t tile = (size_t)(y >> tileShift) * tilesAcross + (x >> tileShift);
+		return tile * pixelsPerTile + ((size_t)(y & (tileSize - 1)) << tileShift) + (x & (tileSize - 1));
+	}
+
+	/*the tileSize x tileSize block of tile (tileX, tileY) - row r of the tile starts at r * tileSize*/
+	Color* tileData(unsigned int tileX, unsigned int tileY) { return pixels.data() + ((size_t)tileY * tilesAcross + tileX) * pixelsPerTile; }
+	const Color* tileData(unsigned int tileX, unsigned int tileY) const { return pixels.data() + ((size_t)tileY * tilesAcross + tileX) * pixelsPerTile; }
+
+	iterator begin() { return iterator(this, empty() ? tilesUp : 0); }
+	iterator end() { return iterator(this, tilesUp); }
+	const_iterator begin() const { return const_iterator(this, empty() ? tilesUp : 0); }
+	const_iterator end() const { return const_iterator(this, tilesUp); }
+
+	unsigned int getWidth() const { return width; }
+	unsigned int getHeight() const { return height; }
+	unsigned int getTilesAcross() const { return tilesAcross; }
+	unsigned int getTilesUp() const { return tilesUp; }
+	bool empty() const { return pixels.empty(); }
+
+	//the 2D operations that gain most from the layout (all clipped to the image):
+
+	void fillRectangle(int x0, int y0, unsigned int rectangleWidth, unsigned int rectangleHeight, const Color& color);
+
+	/*1-pixel outline - the vertical edges walk down a tile column instead of across rows*/
+	void drawRectangleOutline(int x0, int y0, unsigned int rectangleWidth, unsigned int rectangleHeight, const Color& color);
+
+	/*the (2 * thickness + 1)-pixel square around (x, y) - what setPixelToColor_withThickness stamps*/
+	void fillSquare(int x, int y, unsigned int thickness, const Color& color);
+
+	/*turned a quarter clockwise (the top-left corner ends up top-right) - tile by tile, each tile transposed in cache*/
+	TiledPixelMatrix rotatedClockwise() const;
+};
+
+/*a rectangle of some image's pixels (x = column, y = row, row 0 = bottom - same as pixelMatrix[y][x])
+- does not own the pixels: the image must outlive the view, and must not be resized while it is in use
+- views that do not overlap can be drawn into from different threads at the same time, without locks
+(see ImageBMP::rowBands, ImageBMP::tiles and ImageBMP::renderTilesInParallel)*/
+class ImageView
+{
+	Color* origin = nullptr; //pixel (0, 0) of the view
+	unsigned int width = 0;
+	unsigned int height = 0;
+	size_t stride = 0; //in pixels, from one row to the next
+	unsigned int originX = 0; //where the view sits in its image
+	unsigned int originY = 0;
+
+public:
+	ImageView() = default;
+	ImageView(Color* origin, unsigned int width, unsigned int height, size_t stride,
+		unsigned int originX = 0, unsigned int originY = 0);
+
+	unsigned int getWidth() const { return width; }
+	unsigned int getHeight() const { return height; }
+
+	//position of the view's (0, 0) in the whole image - to turn local coordinates into image ones:
+	unsigned int getOriginX() const { return originX; }
+	unsigned int getOriginY() const { return originY; }
+
+	PixelRow<Color> operator[](unsigned int y) const { return PixelRow<Color>(origin + y * stride, width); }
+
+	bool contains(int x, int y) const { return x >= 0 && y >= 0 && (unsigned int)x < width && (unsigned int)y < height; }
+
+	/*does nothing outside the view (so shapes can simply be clipped to a tile)*/
+	void setPixel(int x, int y, const Color& color) const;
+
+	void fill(const Color& color) const;
+
+	/*clipped to the view*/
+	void fillRectangle(int x0, int y0, unsigned int rectangleWidth, unsigned int rectangleHeight, const Color& color) const;
+
+	/*the part of this view inside the given rectangle (empty if they don't overlap)*/
+	ImageView subView(unsigned int x0, unsigned int y0, unsigned int subWidth, unsigned int subHeight) const;
+};
+
+/*a rectangle of changed pixels (x = column, y = row, row 0 = bottom)*/
+struct DirtyRectangle
+{
+	unsigned int x = 0;
+	unsigned int y = 0;
+	unsigned int width = 0;
+	unsigned int height = 0;
+};
+
+/*which pixels have changed since an image was last read or saved - ONE span of columns per row
+(a row's span grows to cover everything drawn in it), so saving the changes is a handful of writes per changed row at most*/
+class DirtyRegion
+{
+	vector<std::pair<unsigned int, unsigned int>> rowSpans; //[first, end) columns - first >= end means the row is clean
+	unsigned int firstDirtyRow = 0; //every row outside [firstDirtyRow, endDirtyRow) is clean
+	unsigned int endDirtyRow = 0;
+
+public:
+	/*all clean, for an image `height` rows tall*/
+	void reset(unsigned int height);
+
+	/*the rectangle must already be clipped to the image*/
+	void add(unsigned int x0, unsigned int y0, unsigned int width, unsigned int height);
+
+	bool isClean() const { return firstDirtyRow >= endDirtyRow; }
+
+	unsigned int getFirstDirtyRow() const { return firstDirtyRow; }
+	unsigned int getEndDirtyRow() const { return endDirtyRow; }
+
+	/*[first, end) changed columns of `row` (first >= end if none)*/
+	std::pair<unsigned int, unsigned int> getRowSpan(unsigned int row) const;
+
+	/*the spans as rectangles - consecutive rows with the same span become one rectangle*/
+	vector<DirtyRectangle> getRectangles() const;
+};
+
 class PixelData
 {
 public:
-	std::vector<vector<Color>> pixelMatrix;
+	PixelMatrix pixelMatrix;
+
+	/*compact 16-bit copy of the pixels (row-major, same row order as pixelMatrix, no padding)
+	- only used while storageFormat is RGB565/RGB555; pixelMatrix is left EMPTY then,
+	so call ImageBMP::expandPixelData() before drawing
+	- the buffer comes from PixelBufferPool (16-bit reads, compactPixelData) and goes back there in expandPixelData*/
+	std::vector<unsigned short> packedPixels;
+	PixelFormat storageFormat = PixelFormat::BGRA32;
+
+	/*the pixels in 64 x 64 tiles - only used while the image is tiled (see ImageBMP::tilePixelData);
+	pixelMatrix is left EMPTY then - ImageBMP's drawing functions untile it themselves, but call ImageBMP::untilePixelData()
+	before using pixelMatrix directly*/
+	TiledPixelMatrix tiledPixels;
+
+	bool isTiled() const { return !tiledPixels.empty(); }
 
 	PixelData() = default;
 };
 
+/*THREAD SAFETY:
+- const member functions (eg: tryWriteImageFile, clone) can run on several threads at once
+- anything else - drawing, reading a file, setOutputFormat, compact/expand - needs the image to itself
+- EXCEPT that threads may draw at the same time through ImageViews that don't overlap (see view, rowBands, tiles)*/
 class ImageBMP
 {
 	/*made private, I suppose, to prevent overwhelming client with large number of functions*/
-	void readFileHeaderFromFile(ifstream& fin);
-	void readInfoHeaderFromFile(ifstream& fin);
-	void readPixelDataFromFile(ifstream& fin);
+	void readFileHeaderFromBytes(const unsigned char* bytes);
+	void readInfoHeaderFromBytes(const unsigned char* bytes, size_t available);
+	BMPStatus readPixelDataFromFile(std::istream& fin);
+	BMPStatus readPalettedPixelDataFromFile(std::istream& fin, size_t bytesPerRow);
+
+	/*everything tryReadImageBMP/decodeFromMemory do once they have a stream*/
+	BMPStatus readFromStream(std::istream& fin, bool keep16BitStorage, const DecodeLimits& limits);
+
+	/*size sanity, pixel offset and overflow checks - done before anything is allocated for the pixels
+	- streamingOnly skips the caps that only matter when the whole image is decoded (see readHeadersFromFile)*/
+	BMPStatus validateHeaders(unsigned long long fileSizeOnDisk, bool streamingOnly) const;
+
+	/*what has been drawn since the image was read from / saved to savedFilePath (see saveChanges)*/
+	DirtyRegion dirtyRegion;
+	string savedFilePath; //empty if the pixels don't match any file
+	std::filesystem::file_time_type savedFileTime{};
+
+	/*after a read or a full write: the file now holds exactly these pixels*/
+	void rememberSavedFile(const string& filename);
+
+	/*true if `filename` is still the file of rememberSavedFile, untouched since, with the headers we would write now*/
+	bool canPatchSavedFile(const string& filename) const;
 public:
 	FileHeader fileHeader;
 	InfoHeader infoHeader;
@@ -140,29 +581,156 @@ public:
 
 	ImageBMP() = default;
 
+	/*images are MOVED around (returned, stored in vectors...) - copying the pixels has to be asked for, with clone()*/
+	ImageBMP(ImageBMP&&) noexcept = default;
+	ImageBMP& operator=(ImageBMP&&) noexcept = default;
+
+	ImageBMP(const ImageBMP&) = delete;
+	ImageBMP& operator=(const ImageBMP&) = delete;
+
+	ImageBMP clone() const;
+
+	/*same as ImageBMP(width, height, fillColor), but the pixels live in a PixelBufferPool buffer
+	- for canvases that are made and dropped at a high rate (eg: one per rendered frame)*/
+	static ImageBMP makePooled(unsigned int imageWidth, unsigned int imageHeight, const Color& fillColor);
+
+	/*the same without the fill (a recycled buffer still holds the previous image) - for canvases that are drawn over
+	completely right away, eg: by BoardRenderer::render*/
+	static ImageBMP makePooled(unsigned int imageWidth, unsigned int imageHeight);
+
 	ImageBMP(unsigned int imageWidth, unsigned int imageHeight, const Color& fillColor, const Color& middleDotColor);
 
 	ImageBMP(unsigned int imageWidth, unsigned int imageHeight, const Color& fillColor);
 
 	ImageBMP(const string& filepath);
 
-	void readImageBMP(string inputFilename);
+	/*16-bit files are expanded to BGRA32 unless keep16BitStorage is true
+	- problems are only printed; use tryReadImageBMP to handle them*/
+	void readImageBMP(const string& inputFilename, bool keep16BitStorage = false);
+
+	/*never blocks or prints - on failure the image is left empty and the status says why
+	- a file bigger than `limits` allows fails with ExceedsDecodeLimits, before its pixels are allocated*/
+	BMPStatus tryReadImageBMP(const string& inputFilename, bool keep16BitStorage = false, const DecodeLimits& limits = DecodeLimits());
+
+	/*the same, for a whole BMP file that is already in memory (eg: fetched by loadBMP in AsyncLoad.h)
+	- the bytes are only read during the call*/
+	BMPStatus decodeFromMemory(const unsigned char* fileBytes, size_t fileSize, bool keep16BitStorage = false,
+		const DecodeLimits& limits = DecodeLimits());
+
+#ifdef IMAGEBMP_HAS_SPAN
+	BMPStatus decodeFromMemory(std::span<const std::byte> fileBytes, bool keep16BitStorage = false,
+		const DecodeLimits& limits = DecodeLimits())
+	{
+		return decodeFromMemory(reinterpret_cast<const unsigned char*>(fileBytes.data()), fileBytes.size(), keep16BitStorage, limits);
+	}
+#endif
 
 	void doublescaleImageBMP();
 
+	/*a quarter turn clockwise (the top-left corner ends up top-right), done tile by tile - the image is tiled first if it
+	isn't already and is left tiled (see tilePixelData); width and height swap and the whole image counts as changed*/
+	void rotateClockwise();
+
+	/*the whole image, or a rectangle of it (clipped to the image) - needs BGRA32 storage (see expandPixelData)*/
+	ImageView view();
+	ImageView view(unsigned int x0, unsigned int y0, unsigned int viewWidth, unsigned int viewHeight);
+
+	/*`bandCount` full-width strips of (nearly) equal height, bottom one first - they never overlap*/
+	vector<ImageView> rowBands(unsigned int bandCount);
+
+	/*tileWidth x tileHeight tiles covering the image (the ones on the right/top edge may be smaller) - they never overlap*/
+	vector<ImageView> tiles(unsigned int tileWidth, unsigned int tileHeight);
+
+	/*calls drawTile for every tile, spread over ThreadPool::shared() - drawTile must only touch the view it is given*/
+	void renderTilesInParallel(unsigned int tileWidth, unsigned int tileHeight, const std::function<void(const ImageView&)>& drawTile);
+
 	void drawRectangleOutline(unsigned int x0, unsigned int y0,
 		unsigned int rectangleWidth, unsigned int rectangleHeight, const Color& color);
 
 	void fillRectangleWithColor(unsigned int x0, unsigned int y0,
 		unsigned int rectangleWidth, unsigned int rectangleHeight, const Color& color);
 
+	/*NOTE: x is the ROW and y the column here (pixelMatrix[x][y]), unlike the functions around it
+	- sets the (2 * thickness + 1)-pixel square around the pixel, clipped to the image (thickness 0 or 1: just the pixel)
+	- a pixel outside the image only prints an error*/
 	void setPixelToColor_withThickness(unsigned int x, unsigned int y, const Color& color, unsigned int thickness);
 
+	/*records that pixels in this rectangle changed (clipped to the image) - the drawing functions above, and view/rowBands/tiles
+	(for the views' whole rectangle), do this themselves; call it after writing to pixelData.pixelMatrix directly*/
+	void markDirty(int x0, int y0, unsigned int rectangleWidth, unsigned int rectangleHeight);
+
+	/*what changed since the image was last read or saved with writeImageFile/saveChanges*/
+	vector<DirtyRectangle> getDirtyRectangles() const;
+
+	void clearDirty();
+
+	/*fills the region around (x, y) (see floodFill in Regions.h) - returns how many pixels changed*/
+	unsigned long long floodFill(int x, int y, const Color& fillColor, unsigned int tolerance = 0);
+
 	/*NOTE! this function is intentionally left empty*/
 	void drawAndFillAnIrregularShape();
 
-	void writeImageFile(std::string filename);
+	/*also makes `filename` the file that saveChanges can patch*/
+	void writeImageFile(const string& filename);
+
+	BMPStatus tryWriteImageFile(const string& filename) const;
 
+	/*how many bytes tryWriteImageFile/encodeInto produce for the image as it is now - worked out from the headers*/
+	size_t getEncodedSize() const;
+
+	/*the same bytes tryWriteImageFile writes, into memory (eg: for a socket or a blob store) - rows are encoded in parallel
+	- `buffer` needs getEncodedSize() bytes; with less, nothing is written and the status is BufferTooSmall
+	- bytesWritten (if given) gets getEncodedSize() on success*/
+	BMPStatus encodeInto(unsigned char* buffer, size_t capacity, size_t* bytesWritten = nullptr) const;
+
+	/*encodeInto a vector sized to exactly getEncodedSize() (one allocation - reuse the vector to avoid even that)*/
+	BMPStatus encodeToBuffer(vector<unsigned char>& fileBytes) const;
+
+#ifdef IMAGEBMP_HAS_SPAN
+	BMPStatus encodeInto(std::span<std::byte> buffer, size_t* bytesWritten = nullptr) const
+	{
+		return encodeInto(reinterpret_cast<unsigned char*>(buffer.data()), buffer.size(), bytesWritten);
+	}
+#endif
+
+	/*incremental save: if `filename` is the file this image was last read from or saved to, it has not been touched since
+	and the headers still match, only the changed rows are rewritten - each as one positioned write covering its dirty span
+	(and consecutive changed rows as one write); otherwise the whole file is written. The image is clean afterwards*/
+	BMPStatus saveChanges(const string& filename);
+
+	/*just the headers (file header, info header and, for BI_BITFIELDS, the masks)
+	- public so that TypedImage can read/write BMP files with its own pixel loops
+	- reading accepts 40-byte and V2-V5 headers and leaves `fin` at indexOfPixelData; writing always uses the 40-byte one
+	- streamingOnly: for readers that never hold the whole image (BMPRegionReader, buildPyramid) - files with more than
+	4 GB of pixels are accepted then (offsets are still checked against the real file size)*/
+	BMPStatus readHeadersFromFile(std::istream& fin, bool streamingOnly = false);
+	void writeHeadersToFile(std::ostream& fout) const;
+
+	/*sets bitsPerPixel/compression (and the sizes that depend on them) for the next writeImageFile
+	- BGRA32 -> 32-bit, BGR24 -> 24-bit, RGB565/RGB555 -> 16-bit BI_BITFIELDS, Gray8 -> 8-bit with a gray palette*/
+	void setOutputFormat(PixelFormat format);
+
+	/*switches pixel storage AND the output file format to 16 bits per pixel (RGB565 or RGB555)
+	- halves memory use, but drawing functions need expandPixelData() first*/
+	void compactPixelData(PixelFormat format);
+
+	/*back to one Color per pixel - the file format stays 16-bit (so a later write still produces a 16-bit BMP)*/
+	void expandPixelData();
+
+	/*switches pixel storage to 64 x 64 tiles (a TiledPixelMatrix, in pixelData.tiledPixels), for column-wise and 2D-local work
+	- writeImageFile/saveChanges/encodeInto write tiled images directly (rows are gathered from the tiles as they are encoded),
+	drawRectangleOutline, fillRectangleWithColor and setPixelToColor_withThickness draw into the tiles, and rotateClockwise turns them;
+	readers of whole images (compareImages, TypedImage::fromImageBMP, SpriteAtlas::build, PNG export) gather rows themselves;
+	everything else that draws (views, rowBands/tiles, floodFill, drawMarkers, text...) turns the image back into rows first*/
+	void tilePixelData();
+
+	/*back to rows*/
+	void untilePixelData();
+
+private:
+	/*recomputes sizeOfPixelData, indexOfPixelData and fileSize from width, height and bitsPerPixel
+	(rows are padded to a multiple of 4 bytes)*/
+	void refreshHeaderSizes();
 
 };
 
@@ -179,8 +747,12 @@ vector<vector<char>> rotateMatrixClockwise
 vector<vector<int>> rotateIntMatrixClockwise(vector<vector<int>>& originalMatrix, int originalNumberOfRows, int originalNumberOfCols);
 
 /*NOTE: this function requires C++17!
-And caution: potentially returning "large" amount of data*/
-vector<ImageBMP> getAllImagesInFolder(string folderName);
+And caution: potentially returning "large" amount of data
+- the files are read in parallel; the process's current directory is NOT changed (so this is safe to call from any thread)*/
+vector<ImageBMP> getAllImagesInFolder(const string& folderName);
+
+/*the same, with each image's file name (without the .bmp) - eg: for SpriteAtlas::build*/
+vector<std::pair<string, ImageBMP>> getAllNamedImagesInFolder(const string& folderName);
 
 
 //for pixelated letters (for labeling chessboard A1, C3, etc.)
@@ -188,4 +760,8 @@ map<char, vector<vector<char>>> makeMapOfPixelLetters();
 
 map<int, vector<vector<int>>> makeMapOfPixelNumbers();
 
+/*writes `text` with the glyphs above (A-H and 1-8 - anything else is left as a blank cell), each 16 x 16 pixels times `scale`
+- (x, y) is the bottom-left corner of the first glyph; clipped to the view*/
+void drawPixelText(const ImageView& target, int x, int y, const string& text, const Color& color, unsigned int scale = 1);
+
 #pragma endregion
\ No newline at end of file
@@ -0,0 +1,396 @@
+#include "ImageCompare.h"
+
+#include<algorithm>
+#include<cmath>
+
+#include "ThreadPool.h"
+
+#ifdef IMAGEBMP_HAS_SSE2
+#include<emmintrin.h>
+#endif
+
+namespace
+{
+	/*what one band of rows contributes to an ImageDiff*/
+	struct BandDiff
+	{
+		unsigned long long differingPixels = 0;
+		unsigned long long squaredErrorSum = 0;
+		unsigned int maxChannelError = 0;
+		unsigned int left = ~0u, right = 0, bottom = ~0u, top = 0; //bounding box, [left, right) x [bottom, top)
+	};
+
+	unsigned int popCount(unsigned long long bits)
+	{
+		unsigned int count = 0;
+		for (; bits != 0; bits &= bits - 1)
+		{
+			++count;
+		}
+		return count;
+	}
+
+	/*one row pair - `channelMask` clears the channels that are not compared (alpha, usually)*/
+	void compareRow(const Color* first, const Color* second, unsigned int width, unsigned int row, unsigned int channelMask, BandDiff& band)
+	{
+		unsigned int i = 0;
+		unsigned long long rowDiffering = 0;
+		unsigned int firstDiffering = ~0u, lastDiffering = 0;
+		unsigned int maxError = 0;
+		unsigned long long squaredErrors = 0;
+
+#ifdef IMAGEBMP_HAS_SSE2
+		const __m128i mask = _mm_set1_epi32((int)channelMask);
+		const __m128i zero = _mm_setzero_si128();
+		__m128i maxBytes = zero;
+		__m128i squaredSums = zero; //4 x 32-bit - flushed well before they could overflow
+		unsigned int sinceFlush = 0;
+
+		for (; i + 4 <= width; i += 4)
+		{
+			__m128i a = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first + i)), mask);
+			__m128i b = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(second + i)), mask);
+
+			//which of the 4 pixels are equal (one bit each):
+			int equal = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b)));
+
+			if (equal == 0xF)
+			{
+				continue;
+			}
+
+			unsigned int differing = ~(unsigned int)equal & 0xF;
+			rowDiffering += popCount(differing);
+			firstDiffering = std::min(firstDiffering, i + (differing & 1 ? 0 : differing & 2 ? 1 : differing & 4 ? 2 : 3));
+			lastDiffering = std::max(lastDiffering, i + (differing & 8 ? 3 : differing & 4 ? 2 : differing & 2 ? 1 : 0));
+
+			//|a - b| per channel, then its square summed in pairs (madd):
+			__m128i difference = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+			maxBytes = _mm_max_epu8(maxBytes, difference);
+
+			__m128i low = _mm_unpacklo_epi8(difference, zero);
+			__m128i high = _mm_unpackhi_epi8(difference, zero);
+			squaredSums = _mm_add_epi32(squaredSums, _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high)));
+
+			//(each step adds at most 4 * 255^2 per lane)
+			if (++sinceFlush == 4096)
+			{
+				alignas(16) unsigned int lanes[4];
+				_mm_store_si128(reinterpret_cast<__m128i*>(lanes), squaredSums);
+				squaredErrors += (unsigned long long)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+				squaredSums = zero;
+				sinceFlush = 0;
+			}
+		}
+
+		alignas(16) unsigned int lanes[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(lanes), squaredSums);
+		squaredErrors += (unsigned long long)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+		alignas(16) unsigned char maxLanes[16];
+		_mm_store_si128(reinterpret_cast<__m128i*>(maxLanes), maxBytes);
+		maxError = *std::max_element(maxLanes, maxLanes + 16);
+#endif
+
+		for (; i < width; ++i)
+		{
+			unsigned int a = first[i].bgra & channelMask;
+			unsigned int b = second[i].bgra & channelMask;
+
+			if (a == b)
+			{
+				continue;
+			}
+
+			++rowDiffering;
+			firstDiffering = std::min(firstDiffering, i);
+			lastDiffering = std::max(lastDiffering, i);
+
+			for (unsigned int shift = 0; shift < 32; shift += 8)
+			{
+				int difference = (int)((a >> shift) & 0xFF) - (int)((b >> shift) & 0xFF);
+				unsigned int error = (unsigned int)std::abs(difference);
+
+				maxError = std::max(maxError, error);
+				squaredErrors += (unsigned long long)error * error;
+			}
+		}
+
+		if (rowDiffering == 0)
+		{
+			return;
+		}
+
+		band.differingPixels += rowDiffering;
+		band.squaredErrorSum += squaredErrors;
+		band.maxChannelError = std::max(band.maxChannelError, maxError);
+		band.left = std::min(band.left, firstDiffering);
+		band.right = std::max(band.right, lastDiffering + 1);
+		band.bottom = std::min(band.bottom, row);
+		band.top = std::max(band.top, row + 1);
+	}
+
+	/*`image` itself, or - for compact 16-bit or tiled storage - a copy of it with rows of Color in `expanded`*/
+	const ImageBMP& withBGRA32Pixels(const ImageBMP& image, ImageBMP& expanded)
+	{
+		if (image.pixelData.storageFormat == PixelFormat::BGRA32 && !image.pixelData.isTiled())
+		{
+			return image;
+		}
+
+		expanded = image.clone();
+		expanded.expandPixelData();
+		expanded.untilePixelData();
+		return expanded;
+	}
+
+	/*the image shrunk to gridWidth x gridHeight gray levels, each the average of the pixels it covers
+	(a cell covers at least one pixel, so images smaller than the grid work too)*/
+	vector<double> shrinkToGray(const ImageBMP& image, unsigned int gridWidth, unsigned int gridHeight)
+	{
+		ImageBMP expanded;
+		const ImageBMP& source = withBGRA32Pixels(image, expanded);
+
+		unsigned int width = source.pixelData.pixelMatrix.getWidth();
+		unsigned int height = source.pixelData.pixelMatrix.getHeight();
+
+		vector<double> cells((size_t)gridWidth * gridHeight, 0.0);
+
+		if (width == 0 || height == 0)
+		{
+			return cells;
+		}
+
+		//which cell column each pixel column adds to (and how many pixels each cell gets), worked out once:
+		auto cellRange = [](unsigned int cell, unsigned int cellCount, unsigned int length)
+		{
+			unsigned int first = (unsigned int)((unsigned long long)cell * length / cellCount);
+			unsigned int end = (unsigned int)((unsigned long long)(cell + 1) * length / cellCount);
+			return std::make_pair(std::min(first, length - 1), std::max(end, std::min(first, length - 1) + 1));
+		};
+
+		vector<unsigned long long> sums((size_t)gridWidth * gridHeight, 0);
+		vector<unsigned char> grayRow(width);
+
+		for (unsigned int cellY = 0; cellY < gridHeight; ++cellY)
+		{
+			std::pair<unsigned int, unsigned int> rows = cellRange(cellY, gridHeight, height);
+
+			for (unsigned int row = rows.first; row < rows.second; ++row)
+			{
+				convertRow<FormatBGRA32, FormatGray8>(reinterpret_cast<const unsigned int*>(source.pixelData.pixelMatrix[row].data()),
+					grayRow.data(), width);
+
+				for (unsigned int cellX = 0; cellX < gridWidth; ++cellX)
+				{
+					std::pair<unsigned int, unsigned int> cols = cellRange(cellX, gridWidth, width);
+					unsigned long long sum = 0;
+
+					for (unsigned int col = cols.first; col < cols.second; ++col)
+					{
+						sum += grayRow[col];
+					}
+					sums[(size_t)cellY * gridWidth + cellX] += sum;
+				}
+			}
+
+			for (unsigned int cellX = 0; cellX < gridWidth; ++cellX)
+			{
+				std::pair<unsigned int, unsigned int> cols = cellRange(cellX, gridWidth, width);
+				size_t cell = (size_t)cellY * gridWidth + cellX;
+
+				cells[cell] = (double)sums[cell] / ((double)(rows.second - rows.first) * (cols.second - cols.first));
+			}
+		}
+
+		return cells;
+	}
+}
+
+ImageDiff compareImages(const ImageBMP& first, const ImageBMP& second, bool compareAlpha)
+{
+	ImageDiff diff;
+
+	ImageBMP firstExpanded, secondExpanded;
+	const PixelMatrix& a = withBGRA32Pixels(first, firstExpanded).pixelData.pixelMatrix;
+	const PixelMatrix& b = withBGRA32Pixels(second, secondExpanded).pixelData.pixelMatrix;
+
+	if (a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight())
+	{
+		diff.sameSize = false;
+		return diff;
+	}
+
+	unsigned int width = a.getWidth();
+	unsigned int height = a.getHeight();
+	unsigned int channelMask = compareAlpha ? 0xFFFFFFFFu : 0x00FFFFFFu;
+
+	//a few bands per thread, so a band full of differences (the slow kind) can be balanced out by stealing:
+	ThreadPool& pool = ThreadPool::shared();
+	unsigned int bandCount = std::max(1u, std::min(height, (pool.getWorkerCount() + 1) * 4));
+	vector<BandDiff> bands(bandCount);
+
+	pool.parallelFor(0, bandCount, [&](size_t band)
+		{
+			unsigned int firstRow = (unsigned int)((unsigned long long)height * band / bandCount);
+			unsigned int endRow = (unsigned int)((unsigned long long)height * (band + 1) / bandCount);
+
+			for (unsigned int row = firstRow; row < endRow; ++row)
+			{
+				compareRow(a[row].data(), b[row].data(), width, row, channelMask, bands[band]);
+			}
+		});
+
+	unsigned long long squaredErrorSum = 0;
+	BandDiff total;
+
+	for (const BandDiff& band : bands)
+	{
+		total.differingPixels += band.differingPixels;
+		squaredErrorSum += band.squaredErrorSum;
+		total.maxChannelError = std::max(total.maxChannelError, band.maxChannelError);
+		total.left = std::min(total.left, band.left);
+		total.right = std::max(total.right, band.right);
+		total.bottom = std::min(total.bottom, band.bottom);
+		total.top = std::max(total.top, band.top);
+	}
+
+	diff.differingPixels = total.differingPixels;
+	diff.maxChannelError = total.maxChannelError;
+
+	if (total.differingPixels == 0)
+	{
+		return diff;
+	}
+
+	diff.changedArea = DirtyRectangle{ total.left, total.bottom, total.right - total.left, total.top - total.bottom };
+
+	double channelCount = (double)width * height * (compareAlpha ? 4 : 3);
+	diff.meanSquaredError = (double)squaredErrorSum / channelCount;
+	diff.psnr = 10.0 * std::log10(255.0 * 255.0 / diff.meanSquaredError);
+
+	return diff;
+}
+
+unsigned long long differenceHash(const ImageBMP& image)
+{
+	vector<double> gray = shrinkToGray(image, 9, 8);
+	unsigned long long hash = 0;
+
+	for (unsigned int y = 0; y < 8; ++y)
+	{
+		for (unsigned int x = 0; x < 8; ++x)
+		{
+			hash = (hash << 1) | (gray[y * 9 + x] > gray[y * 9 + x + 1] ? 1 : 0);
+		}
+	}
+
+	return hash;
+}
+
+unsigned long long perceptualHash(const ImageBMP& image)
+{
+	constexpr unsigned int size = 32;
+	constexpr unsigned int kept = 8; //(the 8x8 lowest frequencies)
+
+	//DCT-II basis, only the rows that are kept:
+	static const vector<double> basis = []
+	{
+		vector<double> values(kept * size);
+		const double pi = 3.14159265358979323846;
+
+		for (unsigned int frequency = 0; frequency < kept; ++frequency)
+		{
+			for (unsigned int x = 0; x < size; ++x)
+			{
+				values[frequency * size + x] = std::cos((2.0 * x + 1.0) * frequency * pi / (2.0 * size));
+			}
+		}
+		return values;
+	}();
+
+	vector<double> gray = shrinkToGray(image, size, size);
+
+	//separable: along the rows first, then down the columns
+	vector<double> alongRows(size * kept, 0.0);
+
+	for (unsigned int y = 0; y < size; ++y)
+	{
+		for (unsigned int u = 0; u < kept; ++u)
+		{
+			double sum = 0;
+			for (unsigned int x = 0; x < size; ++x)
+			{
+				sum += basis[u * size + x] * gray[y * size + x];
+			}
+			alongRows[y * kept + u] = sum;
+		}
+	}
+
+	double coefficients[kept * kept];
+
+	for (unsigned int v = 0; v < kept; ++v)
+	{
+		for (unsigned int u = 0; u < kept; ++u)
+		{
+			double sum = 0;
+			for (unsigned int y = 0; y < size; ++y)
+			{
+				sum += basis[v * size + y] * alongRows[y * kept + u];
+			}
+			coefficients[v * kept + u] = sum;
+		}
+	}
+
+	//the median leaves out the DC term (the average brightness - it would skew everything):
+	double sorted[kept * kept - 1];
+	std::copy(coefficients + 1, coefficients + kept * kept, sorted);
+	std::nth_element(sorted, sorted + (kept * kept - 1) / 2, sorted + kept * kept - 1);
+	double median = sorted[(kept * kept - 1) / 2];
+
+	unsigned long long hash = 0;
+
+	for (unsigned int i = 0; i < kept * kept; ++i)
+	{
+		hash = (hash << 1) | (coefficients[i] > median ? 1 : 0);
+	}
+
+	return hash;
+}
+
+unsigned int hashDistance(unsigned long long firstHash, unsigned long long secondHash)
+{
+	return popCount(firstHash ^ secondHash);
+}
+
+vector<unsigned long long> differenceHashes(const vector<ImageBMP>& images)
+{
+	vector<unsigned long long> hashes(images.size());
+
+	ThreadPool::shared().parallelFor(0, images.size(), [&](size_t i)
+		{
+			hashes[i] = differenceHash(images[i]);
+		});
+
+	return hashes;
+}
+
+vector<std::pair<size_t, size_t>> findNearDuplicates(const vector<ImageBMP>& images, unsigned int maxDistance)
+{
+	vector<unsigned long long> hashes = differenceHashes(images);
+	vector<std::pair<size_t, size_t>> duplicates;
+
+	//(all pairs - but each is one xor and a bit count, so even thousands of images take no time next to hashing them)
+	for (size_t i = 0; i < hashes.size(); ++i)
+	{
+		for (size_t j = i + 1; j < hashes.size(); ++j)
+		{
+			if (hashDistance(hashes[i], hashes[j]) <= maxDistance)
+			{
+				duplicates.emplace_back(i, j);
+			}
+		}
+	}
+
+	return duplicates;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include<limits>
+#include<utility>
+#include<vector>
+
+#include "ImageBMP.h"
+
+/*what compareImages found - everything but sameSize is only meaningful if sameSize is true*/
+struct ImageDiff
+{
+	bool sameSize = true;
+
+	unsigned long long differingPixels = 0;
+	DirtyRectangle changedArea; //bounding box of the differing pixels (0 x 0 if there are none)
+
+	unsigned int maxChannelError = 0; //largest difference of any one channel (0-255)
+	double meanSquaredError = 0; //per channel
+	double psnr = std::numeric_limits<double>::infinity(); //in dB - infinite for identical images
+
+	bool identical() const { return sameSize && differingPixels == 0; }
+};
+
+/*pixel-exact comparison (eg: a rendered frame against its golden BMP) - the rows are compared in bands on ThreadPool::shared(),
+4 pixels at a time with SSE2
+- alpha is ignored unless compareAlpha is true (BMP files mostly don't carry it)*/
+ImageDiff compareImages(const ImageBMP& first, const ImageBMP& second, bool compareAlpha = false);
+
+/*64-bit perceptual hashes - similar images get hashes a few bits apart (see hashDistance), whatever their size
+- differenceHash ("dHash"): the image shrunk to 9x8 grays, one bit per pair of neighbours (is the left one brighter?)
+- perceptualHash ("pHash"): the image shrunk to 32x32 grays, one bit per low-frequency DCT coefficient (above the median?)
+- dHash is the cheaper one; pHash also survives gamma/contrast changes and light blurring*/
+unsigned long long differenceHash(const ImageBMP& image);
+unsigned long long perceptualHash(const ImageBMP& image);
+
+/*number of differing bits - 0 means (almost certainly) the same picture, more than ~10 a different one*/
+unsigned int hashDistance(unsigned long long firstHash, unsigned long long secondHash);
+
+/*differenceHash of every image, spread over ThreadPool::shared()*/
+vector<unsigned long long> differenceHashes(const vector<ImageBMP>& images);
+
+/*every pair (i < j) of images whose differenceHashes are at most maxDistance bits apart - eg: to dedup a sprite folder*/
+vector<std::pair<size_t, size_t>> findNearDuplicates(const vector<ImageBMP>& images, unsigned int maxDistance = 4);
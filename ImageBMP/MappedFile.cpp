@@ -0,0 +1,113 @@
+#include "MappedFile.h"
+
+#include<utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#define IMAGEBMP_HAS_MMAP 1
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	: bytes(std::exchange(other.bytes, nullptr)), length(std::exchange(other.length, 0)),
+	mapped(std::exchange(other.mapped, false)), buffer(std::move(other.buffer))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		bytes = std::exchange(other.bytes, nullptr);
+		length = std::exchange(other.length, 0);
+		mapped = std::exchange(other.mapped, false);
+		buffer = std::move(other.buffer);
+	}
+	return *this;
+}
+
+BMPStatus MappedFile::open(const string& path)
+{
+	close();
+
+#ifdef IMAGEBMP_HAS_MMAP
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0)
+	{
+		return BMPError::FileNotFound;
+	}
+
+	struct stat fileInfo {};
+
+	if (fstat(fd, &fileInfo) != 0)
+	{
+		::close(fd);
+		return BMPError::ReadFailed;
+	}
+
+	if (fileInfo.st_size == 0)
+	{
+		::close(fd);
+		return BMPError::None; //(nothing to map - an empty file)
+	}
+
+	void* address = mmap(nullptr, (size_t)fileInfo.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	::close(fd); //(the mapping keeps the file open)
+
+	if (address == MAP_FAILED)
+	{
+		return BMPError::ReadFailed;
+	}
+
+	bytes = static_cast<unsigned char*>(address);
+	length = (size_t)fileInfo.st_size;
+	mapped = true;
+	return BMPError::None;
+#else
+	ifstream fin{ path, std::ios::binary | std::ios::ate };
+
+	if (!fin)
+	{
+		return BMPError::FileNotFound;
+	}
+
+	std::streamoff size = fin.tellg();
+	fin.seekg(0, std::ios::beg);
+
+	buffer.resize(size > 0 ? (size_t)size : 0);
+
+	if (!fin.read(reinterpret_cast<char*>(buffer.data()), (std::streamsize)buffer.size()))
+	{
+		vector<unsigned char>().swap(buffer);
+		return BMPError::ReadFailed;
+	}
+
+	bytes = buffer.data();
+	length = buffer.size();
+	return BMPError::None;
+#endif
+}
+
+void MappedFile::close()
+{
+#ifdef IMAGEBMP_HAS_MMAP
+	if (mapped)
+	{
+		munmap(bytes, length);
+	}
+#endif
+
+	bytes = nullptr;
+	length = 0;
+	mapped = false;
+	vector<unsigned char>().swap(buffer);
+}
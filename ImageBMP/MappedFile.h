@@ -0,0 +1,41 @@
+#pragma once
+
+#include<cstddef>
+#include<string>
+#include<vector>
+
+#include "ImageBMP.h"
+
+/*a whole file, mapped into memory (mmap where there is one, otherwise simply read into a buffer)
+- the mapping is PRIVATE and writable: pages can be drawn on (they are copied on first write), the file itself never changes
+- pages are only read from disk when first touched, so opening even a big file is cheap*/
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/*FileNotFound / ReadFailed - on failure nothing is mapped*/
+	BMPStatus open(const string& path);
+
+	void close();
+
+	unsigned char* data() { return bytes; }
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+	/*false when the file was read into a buffer instead (no mmap on this platform)*/
+	bool isMapped() const { return mapped; }
+
+private:
+	unsigned char* bytes = nullptr;
+	size_t length = 0;
+	bool mapped = false;
+	vector<unsigned char> buffer; //(the fallback)
+};
@@ -0,0 +1,226 @@
+#include "MarkerBatch.h"
+
+#include<algorithm>
+#include<cmath>
+#include<cstdlib>
+#include<map>
+#include<tuple>
+
+#include "ThreadPool.h"
+
+#ifdef IMAGEBMP_HAS_SSE2
+#include<emmintrin.h>
+#endif
+
+namespace
+{
+	/*a marker's pixels: mask[row * size + col] is all ones where the marker is drawn, zero elsewhere
+	- rowSpans[row] is [first, end) of the drawn columns in that row, so empty parts are never even looked at*/
+	struct Stencil
+	{
+		unsigned int size = 0;
+		vector<unsigned int> mask;
+		vector<std::pair<unsigned int, unsigned int>> rowSpans;
+	};
+
+	using StencilKey = std::tuple<MarkerShape, unsigned int, unsigned int>;
+
+	Stencil rasterize(MarkerShape shape, unsigned int size, unsigned int thickness)
+	{
+		Stencil stencil;
+		stencil.size = size;
+		stencil.mask.assign((size_t)size * size, 0);
+		stencil.rowSpans.assign(size, { 0u, 0u });
+
+		double center = (size - 1) / 2.0;
+		double radius = size / 2.0;
+
+		for (unsigned int row = 0; row < size; ++row)
+		{
+			unsigned int first = size, end = 0;
+
+			for (unsigned int col = 0; col < size; ++col)
+			{
+				bool drawn = false;
+				double dx = col - center;
+				double dy = row - center;
+				double distance = std::sqrt(dx * dx + dy * dy);
+
+				switch (shape)
+				{
+				case MarkerShape::Cross:
+					drawn = std::abs((int)col - (int)row) < (int)thickness || std::abs((int)(col + row) - (int)(size - 1)) < (int)thickness;
+					break;
+				case MarkerShape::Ring:
+					drawn = distance < radius && distance >= radius - thickness;
+					break;
+				case MarkerShape::Disc:
+					drawn = distance < radius;
+					break;
+				case MarkerShape::Square:
+					drawn = true;
+					break;
+				}
+
+				if (drawn)
+				{
+					stencil.mask[(size_t)row * size + col] = 0xFFFFFFFFu;
+					first = std::min(first, col);
+					end = col + 1;
+				}
+			}
+
+			if (first < end)
+			{
+				stencil.rowSpans[row] = { first, end };
+			}
+		}
+
+		return stencil;
+	}
+
+	/*destination = color where the mask is set, unchanged elsewhere*/
+	void stampRow(Color* destination, const unsigned int* mask, size_t count, unsigned int color)
+	{
+		size_t i = 0;
+
+#ifdef IMAGEBMP_HAS_SSE2
+		__m128i colors = _mm_set1_epi32((int)color);
+
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i select = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + i));
+			__m128i* pixels = reinterpret_cast<__m128i*>(destination + i);
+
+			_mm_storeu_si128(pixels, _mm_or_si128(_mm_and_si128(select, colors), _mm_andnot_si128(select, _mm_loadu_si128(pixels))));
+		}
+#endif
+
+		for (; i < count; ++i)
+		{
+			destination[i].bgra = (color & mask[i]) | (destination[i].bgra & ~mask[i]);
+		}
+	}
+
+	/*left, bottom corner of a marker's box in the target*/
+	int boxLeft(const Marker& marker) { return marker.x - (int)(marker.size / 2); }
+	int boxBottom(const Marker& marker) { return marker.y - (int)(marker.size / 2); }
+
+	/*stamps the part of the marker inside rows [firstRow, endRow) of the target*/
+	void stamp(const ImageView& target, const Marker& marker, const Stencil& stencil, long long firstRow, long long endRow)
+	{
+		long long left = boxLeft(marker);
+		long long bottom = boxBottom(marker);
+
+		long long fromRow = std::max(firstRow, bottom);
+		long long toRow = std::min(endRow, bottom + (long long)stencil.size);
+
+		for (long long y = fromRow; y < toRow; ++y)
+		{
+			unsigned int stencilRow = (unsigned int)(y - bottom);
+			std::pair<unsigned int, unsigned int> span = stencil.rowSpans[stencilRow];
+
+			//the row's drawn span, clipped to the target:
+			long long fromCol = std::max<long long>(left + span.first, 0);
+			long long toCol = std::min<long long>(left + span.second, target.getWidth());
+
+			if (fromCol >= toCol)
+			{
+				continue;
+			}
+
+			stampRow(target[(unsigned int)y].data() + fromCol, &stencil.mask[(size_t)stencilRow * stencil.size + (size_t)(fromCol - left)],
+				(size_t)(toCol - fromCol), marker.color.bgra);
+		}
+	}
+}
+
+DirtyRectangle drawMarkers(const ImageView& target, const vector<Marker>& markers)
+{
+	//every stencil is made before any drawing starts, so the bands only ever read them:
+	std::map<StencilKey, Stencil> stencils;
+	vector<const Stencil*> stencilOf(markers.size(), nullptr);
+
+	long long left = target.getWidth(), right = 0, bottom = target.getHeight(), top = 0;
+
+	for (size_t i = 0; i < markers.size(); ++i)
+	{
+		const Marker& marker = markers[i];
+
+		if (marker.size == 0)
+		{
+			continue;
+		}
+
+		//(thickness only matters for the outlined shapes - the filled ones share one stencil per size)
+		unsigned int thickness = (marker.shape == MarkerShape::Cross || marker.shape == MarkerShape::Ring) ? std::max(marker.thickness, 1u) : 0;
+		StencilKey key{ marker.shape, marker.size, thickness };
+
+		auto found = stencils.find(key);
+		if (found == stencils.end())
+		{
+			found = stencils.emplace(key, rasterize(marker.shape, marker.size, thickness)).first;
+		}
+		stencilOf[i] = &found->second;
+
+		left = std::min<long long>(left, boxLeft(marker));
+		right = std::max<long long>(right, (long long)boxLeft(marker) + marker.size);
+		bottom = std::min<long long>(bottom, boxBottom(marker));
+		top = std::max<long long>(top, (long long)boxBottom(marker) + marker.size);
+	}
+
+	left = std::max<long long>(left, 0);
+	bottom = std::max<long long>(bottom, 0);
+	right = std::min<long long>(right, target.getWidth());
+	top = std::min<long long>(top, target.getHeight());
+
+	if (left >= right || bottom >= top)
+	{
+		return DirtyRectangle();
+	}
+
+	//bands of rows - a band only writes its own rows, so bands never touch each other's pixels
+	ThreadPool& pool = ThreadPool::shared();
+	unsigned int rowsDrawn = (unsigned int)(top - bottom);
+	unsigned int bandCount = std::max(1u, std::min(rowsDrawn / 16, (pool.getWorkerCount() + 1) * 2));
+
+	pool.parallelFor(0, bandCount, [&](size_t band)
+		{
+			long long firstRow = bottom + (long long)rowsDrawn * band / bandCount;
+			long long endRow = bottom + (long long)rowsDrawn * (band + 1) / bandCount;
+
+			for (size_t i = 0; i < markers.size(); ++i)
+			{
+				if (stencilOf[i] == nullptr)
+				{
+					continue;
+				}
+
+				long long markerBottom = boxBottom(markers[i]);
+				if (markerBottom >= endRow || markerBottom + (long long)markers[i].size <= firstRow)
+				{
+					continue;
+				}
+
+				stamp(target, markers[i], *stencilOf[i], firstRow, endRow);
+			}
+		});
+
+	return DirtyRectangle{ (unsigned int)left, (unsigned int)bottom, (unsigned int)(right - left), (unsigned int)(top - bottom) };
+}
+
+DirtyRectangle drawMarkers(ImageBMP& image, const vector<Marker>& markers)
+{
+	image.untilePixelData();
+
+	assert(image.pixelData.storageFormat == PixelFormat::BGRA32);
+
+	//(a view made here rather than with view(), which would count the whole image as changed)
+	ImageView whole(image.pixelData.pixelMatrix.data(), image.pixelData.pixelMatrix.getWidth(), image.pixelData.pixelMatrix.getHeight(),
+		image.pixelData.pixelMatrix.getWidth());
+
+	DirtyRectangle drawn = drawMarkers(whole, markers);
+	image.markDirty((int)drawn.x, (int)drawn.y, drawn.width, drawn.height);
+
+	return drawn;
+}
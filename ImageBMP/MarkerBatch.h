@@ -0,0 +1,35 @@
+#pragma once
+
+#include<vector>
+
+#include "ImageBMP.h"
+
+enum class MarkerShape
+{
+	Cross, //an X, corner to corner
+	Ring, //an O
+	Disc, //a filled circle
+	Square //a filled square
+};
+
+/*one marker, centered on (x, y) in a size x size box*/
+struct Marker
+{
+	MarkerShape shape = MarkerShape::Disc;
+	int x = 0;
+	int y = 0;
+	unsigned int size = 1;
+	Color color;
+	unsigned int thickness = 1; //(of the X's strokes and the O's ring)
+};
+
+/*draws many markers in one call (eg: a scatter plot, or every X and O of a board)
+- each distinct (shape, size, thickness) is rasterized ONCE into a stencil (a mask, plus the span of each of its rows),
+and markers are stamped from their stencil: clipped once per marker, then masked writes 4 pixels at a time with SSE2
+- the target is split into bands of rows drawn on ThreadPool::shared(); within a band markers are drawn in order,
+so where markers overlap the later one wins, as if they were drawn one by one
+- returns the box around everything drawn (0 x 0 if nothing landed in the target)*/
+DirtyRectangle drawMarkers(const ImageView& target, const vector<Marker>& markers);
+
+/*the same on a whole image - only the box around the markers is marked dirty*/
+DirtyRectangle drawMarkers(ImageBMP& image, const vector<Marker>& markers);
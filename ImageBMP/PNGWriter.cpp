@@ -0,0 +1,270 @@
+#include "PNGWriter.h"
+
+#include<algorithm>
+#include<cstdlib>
+
+#include "ThreadPool.h"
+
+namespace
+{
+	void appendBigEndian32(vector<unsigned char>& out, unsigned int value)
+	{
+		out.push_back((unsigned char)(value >> 24));
+		out.push_back((unsigned char)(value >> 16));
+		out.push_back((unsigned char)(value >> 8));
+		out.push_back((unsigned char)value);
+	}
+
+	/*length, type, data, CRC of type + data*/
+	void appendChunk(vector<unsigned char>& out, const char* type, const unsigned char* data, size_t size)
+	{
+		appendBigEndian32(out, (unsigned int)size);
+
+		size_t typeStart = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data, data + size);
+
+		appendBigEndian32(out, crc32(out.data() + typeStart, size + 4));
+	}
+
+	unsigned char paethPredictor(int left, int above, int aboveLeft)
+	{
+		int estimate = left + above - aboveLeft;
+		int toLeft = std::abs(estimate - left);
+		int toAbove = std::abs(estimate - above);
+		int toAboveLeft = std::abs(estimate - aboveLeft);
+
+		if (toLeft <= toAbove && toLeft <= toAboveLeft)
+		{
+			return (unsigned char)left;
+		}
+		return (unsigned char)(toAbove <= toAboveLeft ? above : aboveLeft);
+	}
+
+	/*the residuals of one filter into `destination`, and their sum of |residual| (as signed bytes) - `predict` gets the
+	left, above and above-left bytes (0 where they are outside the image)*/
+	template<typename Predict>
+	unsigned long long applyFilter(const unsigned char* row, const unsigned char* above, size_t rowBytes, size_t bytesPerPixel,
+		unsigned char* destination, Predict predict)
+	{
+		unsigned long long score = 0;
+		size_t i = 0;
+
+		//(the first pixel has nothing to its left - split off, so the main loop has no checks)
+		for (; i < bytesPerPixel && i < rowBytes; ++i)
+		{
+			destination[i] = (unsigned char)(row[i] - predict(0, above[i], 0));
+			score += (unsigned long long)std::abs((int)(signed char)destination[i]);
+		}
+		for (; i < rowBytes; ++i)
+		{
+			destination[i] = (unsigned char)(row[i] - predict(row[i - bytesPerPixel], above[i], above[i - bytesPerPixel]));
+			score += (unsigned long long)std::abs((int)(signed char)destination[i]);
+		}
+
+		return score;
+	}
+
+	/*one filtered row (filter type byte first) - `above` is the previous row's raw bytes (all zero for the first row)
+	- the filters are tried (only none/sub/up when allFilters is false - average and paeth cost the most), and the one
+	with the smallest sum of |residual| kept*/
+	void filterRow(const unsigned char* row, const unsigned char* above, size_t rowBytes, size_t bytesPerPixel, bool allFilters,
+		vector<unsigned char>& candidate, unsigned char* destination)
+	{
+		unsigned long long bestScore = ~0ull;
+
+		auto keepIfBest = [&](unsigned char filter, unsigned long long score)
+		{
+			if (score < bestScore)
+			{
+				bestScore = score;
+				destination[0] = filter;
+				std::copy(candidate.begin(), candidate.begin() + rowBytes, destination + 1);
+			}
+		};
+
+		keepIfBest(0, applyFilter(row, above, rowBytes, bytesPerPixel, candidate.data(),
+			[](int, int, int) { return 0; }));
+		keepIfBest(1, applyFilter(row, above, rowBytes, bytesPerPixel, candidate.data(),
+			[](int left, int, int) { return left; }));
+		keepIfBest(2, applyFilter(row, above, rowBytes, bytesPerPixel, candidate.data(),
+			[](int, int up, int) { return up; }));
+
+		if (!allFilters)
+		{
+			return;
+		}
+
+		keepIfBest(3, applyFilter(row, above, rowBytes, bytesPerPixel, candidate.data(),
+			[](int left, int up, int) { return (left + up) / 2; }));
+		keepIfBest(4, applyFilter(row, above, rowBytes, bytesPerPixel, candidate.data(),
+			[](int left, int up, int upLeft) { return (int)paethPredictor(left, up, upLeft); }));
+	}
+}
+
+vector<unsigned char> encodePNG(const ImageBMP& image, const PNGOptions& options)
+{
+	unsigned int width = image.infoHeader.imageWidth;
+	unsigned int height = image.infoHeader.imageHeight;
+
+	if (width == 0 || height == 0)
+	{
+		return vector<unsigned char>(); //(PNG has no empty images)
+	}
+
+	//channels from the output format - what writeImageFile would keep of each pixel:
+	short bitsPerPixel = image.infoHeader.getBitsPerPixel();
+	size_t bytesPerPixel = (bitsPerPixel == 32) ? 4 : (bitsPerPixel == 8) ? 1 : 3;
+	unsigned char colorType = (bytesPerPixel == 4) ? 6 : (bytesPerPixel == 1) ? 0 : 2;
+
+	size_t rowBytes = (size_t)width * bytesPerPixel;
+
+	//PNG rows go top to bottom - PNG row r is image row height - 1 - r
+	auto rawRow = [&](unsigned int pngRow, vector<Color>& pixels, unsigned char* destination)
+	{
+		unsigned int row = height - 1 - pngRow;
+		const Color* source = nullptr;
+
+		if (image.pixelData.isTiled())
+		{
+			image.pixelData.tiledPixels.copyRowTo(row, pixels.data());
+			source = pixels.data();
+		}
+		else if (image.pixelData.storageFormat == PixelFormat::RGB565)
+		{
+			convertRow<FormatRGB565, FormatBGRA32>(&image.pixelData.packedPixels[(size_t)row * width], &pixels.data()->bgra, width);
+			source = pixels.data();
+		}
+		else if (image.pixelData.storageFormat == PixelFormat::RGB555)
+		{
+			convertRow<FormatRGB555, FormatBGRA32>(&image.pixelData.packedPixels[(size_t)row * width], &pixels.data()->bgra, width);
+			source = pixels.data();
+		}
+		else
+		{
+			source = image.pixelData.pixelMatrix[row].data();
+		}
+
+		if (bytesPerPixel == 1)
+		{
+			convertRow<FormatBGRA32, FormatGray8>(&source->bgra, destination, width);
+			return;
+		}
+
+		for (unsigned int x = 0; x < width; ++x)
+		{
+			unsigned int bgra = source[x].bgra;
+			unsigned char* pixel = destination + x * bytesPerPixel;
+
+			pixel[0] = (unsigned char)(bgra >> 16); //R
+			pixel[1] = (unsigned char)(bgra >> 8); //G
+			pixel[2] = (unsigned char)bgra; //B
+
+			if (bytesPerPixel == 4)
+			{
+				pixel[3] = (unsigned char)(bgra >> 24); //A
+			}
+		}
+	};
+
+	//groups of rows, each filtered and deflated on its own:
+	size_t rowsPerPiece = std::max<size_t>(1, options.bytesPerPiece / (rowBytes + 1));
+	size_t pieceCount = (height + rowsPerPiece - 1) / rowsPerPiece;
+
+	struct Piece
+	{
+		vector<unsigned char> compressed;
+		unsigned int adler = 1;
+		size_t filteredSize = 0;
+	};
+	vector<Piece> pieces(pieceCount);
+
+	ThreadPool::shared().parallelFor(0, pieceCount, [&](size_t pieceIndex)
+		{
+			unsigned int firstRow = (unsigned int)(pieceIndex * rowsPerPiece);
+			unsigned int endRow = (unsigned int)std::min<size_t>(firstRow + rowsPerPiece, height);
+
+			vector<Color> pixels(width);
+			vector<unsigned char> above(rowBytes, 0), current(rowBytes), candidate(rowBytes);
+			vector<unsigned char> filtered((size_t)(endRow - firstRow) * (rowBytes + 1));
+
+			//(the row above the piece's first one is just recomputed - the filters need its raw bytes)
+			if (firstRow > 0)
+			{
+				rawRow(firstRow - 1, pixels, above.data());
+			}
+
+			for (unsigned int pngRow = firstRow; pngRow < endRow; ++pngRow)
+			{
+				rawRow(pngRow, pixels, current.data());
+				filterRow(current.data(), above.data(), rowBytes, bytesPerPixel, options.level != DeflateLevel::Fast, candidate,
+					filtered.data() + (size_t)(pngRow - firstRow) * (rowBytes + 1));
+				std::swap(above, current);
+			}
+
+			Piece& piece = pieces[pieceIndex];
+			piece.adler = adler32(filtered.data(), filtered.size());
+			piece.filteredSize = filtered.size();
+			deflatePiece(filtered.data(), filtered.size(), options.level, pieceIndex + 1 == pieceCount, piece.compressed);
+		});
+
+	vector<unsigned char> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	vector<unsigned char> header;
+	appendBigEndian32(header, width);
+	appendBigEndian32(header, height);
+	header.push_back(8); //bits per channel
+	header.push_back(colorType);
+	header.push_back(0); //deflate
+	header.push_back(0); //adaptive filtering
+	header.push_back(0); //not interlaced
+	appendChunk(png, "IHDR", header.data(), header.size());
+
+	//one zlib stream over all the IDATs: its 2-byte header goes in front of the first piece, the adler32 after the last
+	unsigned int adler = 1;
+	for (size_t pieceIndex = 0; pieceIndex < pieceCount; ++pieceIndex)
+	{
+		Piece& piece = pieces[pieceIndex];
+		adler = (pieceIndex == 0) ? piece.adler : adler32Combine(adler, piece.adler, piece.filteredSize);
+
+		if (pieceIndex == 0)
+		{
+			//CMF 0x78 (deflate, 32K window), FLG chosen so that CMF * 256 + FLG is a multiple of 31
+			unsigned char levelFlag = (options.level == DeflateLevel::Fast) ? 0x01 : 0x9C;
+			piece.compressed.insert(piece.compressed.begin(), { 0x78, levelFlag });
+		}
+		if (pieceIndex + 1 == pieceCount)
+		{
+			appendBigEndian32(piece.compressed, adler);
+		}
+
+		appendChunk(png, "IDAT", piece.compressed.data(), piece.compressed.size());
+		vector<unsigned char>().swap(piece.compressed);
+	}
+
+	appendChunk(png, "IEND", nullptr, 0);
+
+	return png;
+}
+
+BMPStatus writePNGFile(const ImageBMP& image, const string& filename, const PNGOptions& options)
+{
+	vector<unsigned char> png = encodePNG(image, options);
+
+	if (png.empty())
+	{
+		return BMPError::BadDimensions;
+	}
+
+	ofstream fout{ filename, std::ios::binary };
+
+	if (!fout)
+	{
+		return BMPError::CannotCreateFile;
+	}
+
+	fout.write(reinterpret_cast<const char*>(png.data()), (std::streamsize)png.size());
+	fout.close();
+
+	return fout.fail() ? BMPError::WriteFailed : BMPError::None;
+}
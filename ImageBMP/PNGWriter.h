@@ -0,0 +1,26 @@
+#pragma once
+
+#include<string>
+#include<vector>
+
+#include "Deflate.h"
+#include "ImageBMP.h"
+
+/*lossless PNG export, next to writeImageFile's BMP - much smaller for flat-colour renders
+- the channels follow the image's output format (see ImageBMP::setOutputFormat): 32-bit -> RGBA, 8-bit gray -> gray,
+anything else -> RGB
+- each row gets the PNG filter (none/sub/up/average/paeth - only the first three at DeflateLevel::Fast) that leaves
+the smallest residuals, and groups of rows
+are filtered and deflated independently on ThreadPool::shared() (see deflatePiece) - one IDAT chunk per group*/
+
+struct PNGOptions
+{
+	DeflateLevel level = DeflateLevel::Fast;
+	size_t bytesPerPiece = 256 * 1024; //(roughly how much filtered data each parallel piece gets)
+};
+
+/*the whole PNG file, in memory (empty for a 0 x 0 image - PNG has no empty images)*/
+vector<unsigned char> encodePNG(const ImageBMP& image, const PNGOptions& options = PNGOptions());
+
+/*BadDimensions for an empty image*/
+BMPStatus writePNGFile(const ImageBMP& image, const string& filename, const PNGOptions& options = PNGOptions());
@@ -0,0 +1,278 @@
+#include "PixelBufferPool.h"
+
+#include<algorithm>
+#include<utility>
+
+#include "ImageBMP.h"
+
+namespace
+{
+	using Key = std::tuple<unsigned int, unsigned int, PixelFormat>;
+
+	/*the calling thread's own few buffers (most recently released last)
+	- freed with the thread, never handed to other threads*/
+	template<typename PixelType>
+	struct ThreadCache
+	{
+		std::vector<std::pair<Key, std::vector<PixelType>>> entries;
+		std::atomic<size_t>* heldBytes = nullptr; //(the pool's - set when the first buffer comes in)
+
+		size_t bytes() const
+		{
+			size_t total = 0;
+			for (const auto& entry : entries)
+			{
+				total += entry.second.size() * sizeof(PixelType);
+			}
+			return total;
+		}
+
+		void clear()
+		{
+			if (heldBytes != nullptr)
+			{
+				*heldBytes -= bytes();
+			}
+			entries.clear();
+		}
+
+		~ThreadCache() { clear(); }
+	};
+
+	template<typename PixelType>
+	ThreadCache<PixelType>& threadCache()
+	{
+		thread_local ThreadCache<PixelType> cache;
+		return cache;
+	}
+}
+
+PixelBufferPool& PixelBufferPool::instance()
+{
+	static PixelBufferPool pool;
+	return pool;
+}
+
+template<typename PixelType>
+std::vector<PixelType> PixelBufferPool::acquire(Shelves<PixelType>& shelves, const Key& key)
+{
+	//1. this thread's cache - no lock:
+	auto& entries = threadCache<PixelType>().entries;
+
+	for (size_t i = entries.size(); i-- > 0; )
+	{
+		if (entries[i].first == key)
+		{
+			std::vector<PixelType> buffer = std::move(entries[i].second);
+			entries.erase(entries.begin() + i);
+			heldBytes -= buffer.size() * sizeof(PixelType);
+			++threadCacheHits;
+			return buffer;
+		}
+	}
+
+	//2. the shared shelves:
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto shelf = shelves.find(key);
+
+		if (shelf != shelves.end())
+		{
+			std::vector<PixelType> buffer = std::move(shelf->second.back());
+			shelf->second.pop_back();
+
+			if (shelf->second.empty())
+			{
+				shelves.erase(shelf); //(no empty shelves - the map only has keys with buffers on them)
+			}
+
+			pooledBytes -= buffer.size() * sizeof(PixelType);
+			heldBytes -= buffer.size() * sizeof(PixelType);
+			++sharedHits;
+			return buffer;
+		}
+	}
+
+	//3. a new one:
+	++misses;
+	return std::vector<PixelType>((size_t)std::get<0>(key) * std::get<1>(key));
+}
+
+template<typename PixelType>
+void PixelBufferPool::release(Shelves<PixelType>& shelves, const Key& key, std::vector<PixelType>&& buffer)
+{
+	//(a buffer of the wrong size - eg: one that was resized by its user - is just freed)
+	if (buffer.empty() || buffer.size() != (size_t)std::get<0>(key) * std::get<1>(key))
+	{
+		return;
+	}
+
+	if (!reserveBytes(buffer.size() * sizeof(PixelType)))
+	{
+		return; //the pool (shelves and thread caches together) is full
+	}
+
+	ThreadCache<PixelType>& cache = threadCache<PixelType>();
+	auto& entries = cache.entries;
+	size_t threadCacheSize = threadCacheLimit.load(std::memory_order_relaxed);
+
+	if (threadCacheSize == 0)
+	{
+		releaseToShelves(shelves, key, std::move(buffer));
+		return;
+	}
+
+	cache.heldBytes = &heldBytes;
+	entries.emplace_back(key, std::move(buffer));
+
+	//too many here? - the oldest one moves on to the shared shelves
+	if (entries.size() > threadCacheSize)
+	{
+		std::pair<Key, std::vector<PixelType>> oldest = std::move(entries.front());
+		entries.erase(entries.begin());
+		releaseToShelves(shelves, oldest.first, std::move(oldest.second));
+	}
+}
+
+template<typename PixelType>
+void PixelBufferPool::releaseToShelves(Shelves<PixelType>& shelves, const Key& key, std::vector<PixelType>&& buffer)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	size_t bytes = buffer.size() * sizeof(PixelType);
+	auto shelf = shelves.find(key);
+
+	//(the byte limit was checked by reserveBytes)
+	if (limits.maxBuffersPerKey == 0 || (shelf != shelves.end() && shelf->second.size() >= limits.maxBuffersPerKey))
+	{
+		heldBytes -= bytes;
+		return; //over a limit - the caller's buffer is freed as usual
+	}
+
+	//(only now is a shelf made for a new key - a rejected buffer leaves no empty shelf behind)
+	if (shelf == shelves.end())
+	{
+		shelf = shelves.emplace(key, std::vector<std::vector<PixelType>>()).first;
+	}
+
+	shelf->second.push_back(std::move(buffer));
+	pooledBytes += bytes;
+}
+
+template<typename PixelType>
+void PixelBufferPool::flushToShelves(Shelves<PixelType>& shelves)
+{
+	auto& entries = threadCache<PixelType>().entries;
+
+	//(cached buffers are already counted in heldBytes, as releaseToShelves expects)
+	for (auto& entry : entries)
+	{
+		releaseToShelves(shelves, entry.first, std::move(entry.second));
+	}
+	entries.clear();
+}
+
+bool PixelBufferPool::reserveBytes(size_t bytes)
+{
+	size_t limit = heldBytesLimit.load(std::memory_order_relaxed);
+
+	if (heldBytes.fetch_add(bytes) + bytes > limit)
+	{
+		heldBytes -= bytes;
+		return false;
+	}
+	return true;
+}
+
+template<typename PixelType>
+void PixelBufferPool::shrinkToLimits(Shelves<PixelType>& shelves)
+{
+	//(caller holds the mutex)
+	for (auto shelf = shelves.begin(); shelf != shelves.end(); )
+	{
+		auto& buffers = shelf->second;
+
+		//(the thread caches count towards maxPooledBytes too, but only the shelves can be freed from here)
+		while (!buffers.empty() && (buffers.size() > limits.maxBuffersPerKey || heldBytes > limits.maxPooledBytes))
+		{
+			pooledBytes -= buffers.back().size() * sizeof(PixelType);
+			heldBytes -= buffers.back().size() * sizeof(PixelType);
+			buffers.pop_back();
+		}
+
+		shelf = buffers.empty() ? shelves.erase(shelf) : std::next(shelf);
+	}
+}
+
+std::vector<Color> PixelBufferPool::acquireColors(unsigned int width, unsigned int height)
+{
+	return acquire(colorShelves, Key{ width, height, PixelFormat::BGRA32 });
+}
+
+void PixelBufferPool::releaseColors(unsigned int width, unsigned int height, std::vector<Color>&& buffer)
+{
+	release(colorShelves, Key{ width, height, PixelFormat::BGRA32 }, std::move(buffer));
+}
+
+std::vector<unsigned short> PixelBufferPool::acquirePacked(unsigned int width, unsigned int height, PixelFormat format)
+{
+	return acquire(packedShelves, Key{ width, height, format });
+}
+
+void PixelBufferPool::releasePacked(unsigned int width, unsigned int height, PixelFormat format, std::vector<unsigned short>&& buffer)
+{
+	release(packedShelves, Key{ width, height, format }, std::move(buffer));
+}
+
+void PixelBufferPool::setLimits(const Limits& newLimits)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	limits = newLimits;
+	threadCacheLimit = newLimits.threadCacheBuffers;
+	heldBytesLimit = newLimits.maxPooledBytes;
+
+	shrinkToLimits(colorShelves);
+	shrinkToLimits(packedShelves);
+}
+
+PixelBufferPool::Limits PixelBufferPool::getLimits() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return limits;
+}
+
+void PixelBufferPool::trim()
+{
+	threadCache<Color>().clear();
+	threadCache<unsigned short>().clear();
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	colorShelves.clear();
+	packedShelves.clear();
+	heldBytes -= pooledBytes;
+	pooledBytes = 0;
+}
+
+void PixelBufferPool::flushThreadCache()
+{
+	flushToShelves(colorShelves);
+	flushToShelves(packedShelves);
+}
+
+PixelBufferPool::Stats PixelBufferPool::getStats() const
+{
+	Stats stats;
+
+	stats.threadCacheHits = threadCacheHits;
+	stats.sharedHits = sharedHits;
+	stats.misses = misses;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	stats.pooledBytes = pooledBytes;
+	stats.threadCachedBytes = heldBytes - pooledBytes; //(exact unless another thread is releasing right now)
+
+	return stats;
+}
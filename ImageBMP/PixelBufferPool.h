@@ -0,0 +1,113 @@
+#pragma once
+
+#include<atomic>
+#include<cstddef>
+#include<map>
+#include<mutex>
+#include<tuple>
+#include<vector>
+
+#include "PixelFormat.h"
+
+struct Color;
+
+/*recycles pixel buffers of images that are created and thrown away at a high rate (eg: re-rendering the same board over and over)
+- buffers are keyed by (width, height, format), so a returned buffer is handed out again only for an identical image
+- each thread first uses its own small cache (no lock at all), and only then the shared shelves (one mutex)
+- everything above the limits is simply freed, so the pool never grows without bound
+(maxPooledBytes counts the thread caches too - though a buffer in some other thread's cache is only freed with that thread)
+
+usage: ImageBMP::makePooled(...) for canvases (their buffer goes back here when the image is destroyed),
+or acquire.../release... directly for scratch buffers
+- 16-bit storage uses the packed shelves by itself: 16-bit reads and compactPixelData acquire, expandPixelData releases*/
+class PixelBufferPool
+{
+public:
+	struct Limits
+	{
+		size_t maxBuffersPerKey = 8; //on the shared shelves, per (width, height, format)
+		size_t maxPooledBytes = 256u << 20; //total held on the shared shelves AND in all thread caches
+		size_t threadCacheBuffers = 4; //per thread, per pixel type
+	};
+
+	struct Stats
+	{
+		size_t threadCacheHits = 0;
+		size_t sharedHits = 0;
+		size_t misses = 0; //ie: fresh allocations
+		size_t pooledBytes = 0; //currently on the shared shelves
+		size_t threadCachedBytes = 0; //currently in the thread caches (all threads)
+	};
+
+	/*the one pool (thread caches are per thread, so there can't usefully be more than one)*/
+	static PixelBufferPool& instance();
+
+	PixelBufferPool(const PixelBufferPool&) = delete;
+	PixelBufferPool& operator=(const PixelBufferPool&) = delete;
+
+	/*a buffer of exactly width * height pixels - the CONTENTS are whatever the last user left*/
+	std::vector<Color> acquireColors(unsigned int width, unsigned int height);
+	void releaseColors(unsigned int width, unsigned int height, std::vector<Color>&& buffer);
+
+	/*same, for the 16-bit formats (RGB565/RGB555) and Gray16*/
+	std::vector<unsigned short> acquirePacked(unsigned int width, unsigned int height, PixelFormat format);
+	void releasePacked(unsigned int width, unsigned int height, PixelFormat format, std::vector<unsigned short>&& buffer);
+
+	/*lowering a limit frees whatever no longer fits on the shared shelves*/
+	void setLimits(const Limits& newLimits);
+	Limits getLimits() const;
+
+	/*frees everything on the shared shelves and in the CALLING thread's cache
+	(other threads' caches are theirs alone - they are freed when those threads end, and stay within maxPooledBytes meanwhile)*/
+	void trim();
+
+	/*moves the CALLING thread's cached buffers to the shared shelves, where any thread can get them
+	- for threads that only ever give buffers back (eg: AsyncImageWriter's I/O thread), whose own cache nobody would hit*/
+	void flushThreadCache();
+
+	Stats getStats() const;
+
+private:
+	PixelBufferPool() = default;
+
+	using Key = std::tuple<unsigned int, unsigned int, PixelFormat>;
+
+	template<typename PixelType>
+	using Shelves = std::map<Key, std::vector<std::vector<PixelType>>>;
+
+	template<typename PixelType>
+	std::vector<PixelType> acquire(Shelves<PixelType>& shelves, const Key& key);
+
+	template<typename PixelType>
+	void release(Shelves<PixelType>& shelves, const Key& key, std::vector<PixelType>&& buffer);
+
+	/*`buffer` is already counted in heldBytes (see reserveBytes)*/
+	template<typename PixelType>
+	void releaseToShelves(Shelves<PixelType>& shelves, const Key& key, std::vector<PixelType>&& buffer);
+
+	template<typename PixelType>
+	void flushToShelves(Shelves<PixelType>& shelves);
+
+	/*counts `bytes` as held - false (and nothing counted) if that would go over maxPooledBytes*/
+	bool reserveBytes(size_t bytes);
+
+	template<typename PixelType>
+	void shrinkToLimits(Shelves<PixelType>& shelves);
+
+	mutable std::mutex mutex; //guards the shelves, limits and pooledBytes
+	Shelves<Color> colorShelves;
+	Shelves<unsigned short> packedShelves;
+	Limits limits;
+	size_t pooledBytes = 0;
+
+	//(copies of limits.threadCacheBuffers/maxPooledBytes, so the lock-free thread cache path doesn't need the mutex)
+	std::atomic<size_t> threadCacheLimit{ Limits().threadCacheBuffers };
+	std::atomic<size_t> heldBytesLimit{ Limits().maxPooledBytes };
+
+	//everything held: the shelves (pooledBytes) plus every thread's cache
+	std::atomic<size_t> heldBytes{ 0 };
+
+	std::atomic<size_t> threadCacheHits{ 0 };
+	std::atomic<size_t> sharedHits{ 0 };
+	std::atomic<size_t> misses{ 0 };
+};
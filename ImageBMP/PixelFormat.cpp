@@ -0,0 +1,256 @@
+#include "PixelFormat.h"
+
+#ifdef IMAGEBMP_HAS_SSE2
+#include<emmintrin.h>
+#endif
+
+#ifdef IMAGEBMP_HAS_SSSE3
+#include<tmmintrin.h>
+#endif
+
+PixelFormat pixelFormatFromBitfieldMasks(unsigned int redMask, unsigned int greenMask, unsigned int blueMask)
+{
+	if (redMask == rgb565RedMask && greenMask == rgb565GreenMask && blueMask == rgb565BlueMask)
+	{
+		return PixelFormat::RGB565;
+	}
+
+	if (redMask == rgb555RedMask && greenMask == rgb555GreenMask && blueMask == rgb555BlueMask)
+	{
+		return PixelFormat::RGB555;
+	}
+
+	return PixelFormat::BGRA32;
+}
+
+#ifdef IMAGEBMP_HAS_SSE2
+#pragma region SSE2 kernels
+
+/*4 BGRA pixels -> 4 packed values (still one per 32-bit lane)*/
+static __m128i packFourPixels(__m128i bgra, bool is565)
+{
+	if (is565)
+	{
+		__m128i r = _mm_and_si128(_mm_srli_epi32(bgra, 8), _mm_set1_epi32(0xF800));
+		__m128i g = _mm_and_si128(_mm_srli_epi32(bgra, 5), _mm_set1_epi32(0x07E0));
+		__m128i b = _mm_and_si128(_mm_srli_epi32(bgra, 3), _mm_set1_epi32(0x001F));
+		return _mm_or_si128(_mm_or_si128(r, g), b);
+	}
+
+	__m128i r = _mm_and_si128(_mm_srli_epi32(bgra, 9), _mm_set1_epi32(0x7C00));
+	__m128i g = _mm_and_si128(_mm_srli_epi32(bgra, 6), _mm_set1_epi32(0x03E0));
+	__m128i b = _mm_and_si128(_mm_srli_epi32(bgra, 3), _mm_set1_epi32(0x001F));
+	return _mm_or_si128(_mm_or_si128(r, g), b);
+}
+
+/*5 (or 6) bit channel -> 8 bits by replicating the high bits into the low ones*/
+static __m128i widenChannel(__m128i channel, int bits)
+{
+	return _mm_or_si128(_mm_sll_epi32(channel, _mm_cvtsi32_si128(8 - bits)),
+		_mm_srl_epi32(channel, _mm_cvtsi32_si128(2 * bits - 8)));
+}
+
+/*4 packed values (one per 32-bit lane) -> 4 BGRA pixels*/
+static __m128i unpackFourPixels(__m128i packed, bool is565)
+{
+	__m128i fiveBits = _mm_set1_epi32(0x1F);
+	__m128i r, g, b;
+
+	if (is565)
+	{
+		r = widenChannel(_mm_and_si128(_mm_srli_epi32(packed, 11), fiveBits), 5);
+		g = widenChannel(_mm_and_si128(_mm_srli_epi32(packed, 5), _mm_set1_epi32(0x3F)), 6);
+	}
+	else
+	{
+		r = widenChannel(_mm_and_si128(_mm_srli_epi32(packed, 10), fiveBits), 5);
+		g = widenChannel(_mm_and_si128(_mm_srli_epi32(packed, 5), fiveBits), 5);
+	}
+	b = widenChannel(_mm_and_si128(packed, fiveBits), 5);
+
+	__m128i alpha = _mm_set1_epi32((int)0xFF'00'00'00);
+	return _mm_or_si128(_mm_or_si128(alpha, _mm_slli_epi32(r, 16)), _mm_or_si128(_mm_slli_epi32(g, 8), b));
+}
+
+/*4 BGRA pixels -> 4 lumas (one per 32-bit lane), same weights as lumaOfPixel*/
+static __m128i lumaOfFourPixels(__m128i bgra)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i weights = _mm_setr_epi16(29, 150, 77, 0, 29, 150, 77, 0);
+
+	//madd leaves (29b + 150g) and (77r + 0a) side by side for each pixel...
+	__m128 low = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(bgra, zero), weights));
+	__m128 high = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(bgra, zero), weights));
+
+	//...so gather the even and odd halves and add them:
+	__m128i blueGreen = _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+	__m128i red = _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+
+	return _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(blueGreen, red), _mm_set1_epi32(128)), 8);
+}
+
+/*16 lumas (four vectors of 4) -> 16 bytes*/
+static __m128i packSixteenLumas(__m128i l0, __m128i l1, __m128i l2, __m128i l3)
+{
+	return _mm_packus_epi16(_mm_packs_epi32(l0, l1), _mm_packs_epi32(l2, l3));
+}
+
+#pragma endregion
+#endif
+
+void packBGRA32To16Bit(const unsigned int* source, unsigned short* destination, size_t count, PixelFormat format)
+{
+	bool is565 = (format == PixelFormat::RGB565);
+	size_t i = 0;
+
+#ifdef IMAGEBMP_HAS_SSE2
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i low = packFourPixels(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)), is565);
+		__m128i high = packFourPixels(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i + 4)), is565);
+
+		//packs_epi32 saturates as SIGNED, so sign-extend the low 16 bits first to keep 0x8000+ intact:
+		low = _mm_srai_epi32(_mm_slli_epi32(low, 16), 16);
+		high = _mm_srai_epi32(_mm_slli_epi32(high, 16), 16);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_packs_epi32(low, high));
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		destination[i] = is565 ? packPixelTo565(source[i]) : packPixelTo555(source[i]);
+	}
+}
+
+void unpack16BitToBGRA32(const unsigned short* source, unsigned int* destination, size_t count, PixelFormat format)
+{
+	bool is565 = (format == PixelFormat::RGB565);
+	size_t i = 0;
+
+#ifdef IMAGEBMP_HAS_SSE2
+	__m128i zero = _mm_setzero_si128();
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i),
+			unpackFourPixels(_mm_unpacklo_epi16(words, zero), is565));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i + 4),
+			unpackFourPixels(_mm_unpackhi_epi16(words, zero), is565));
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		destination[i] = is565 ? unpackPixelFrom565(source[i]) : unpackPixelFrom555(source[i]);
+	}
+}
+
+void convertBGRA32ToGray8(const unsigned int* source, unsigned char* destination, size_t count)
+{
+	size_t i = 0;
+
+#ifdef IMAGEBMP_HAS_SSE2
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m128i* pixels = reinterpret_cast<const __m128i*>(source + i);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), packSixteenLumas(
+			lumaOfFourPixels(_mm_loadu_si128(pixels + 0)), lumaOfFourPixels(_mm_loadu_si128(pixels + 1)),
+			lumaOfFourPixels(_mm_loadu_si128(pixels + 2)), lumaOfFourPixels(_mm_loadu_si128(pixels + 3))));
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		destination[i] = lumaOfPixel(source[i]);
+	}
+}
+
+void convertBGR24ToGray8(const BGR* source, unsigned char* destination, size_t count)
+{
+	size_t i = 0;
+
+#ifdef IMAGEBMP_HAS_SSSE3
+	//spread 4 BGR pixels (12 bytes) into BGRA lanes (alpha = 0, and its weight is 0 anyway):
+	__m128i toBGRA = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(source);
+
+	//each 16-byte load only uses 12 bytes, so stop early enough that the last load stays inside the row:
+	for (; i + 18 <= count; i += 16)
+	{
+		const unsigned char* block = bytes + 3 * i;
+		__m128i l0 = lumaOfFourPixels(_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 0)), toBGRA));
+		__m128i l1 = lumaOfFourPixels(_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 12)), toBGRA));
+		__m128i l2 = lumaOfFourPixels(_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 24)), toBGRA));
+		__m128i l3 = lumaOfFourPixels(_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 36)), toBGRA));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), packSixteenLumas(l0, l1, l2, l3));
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		destination[i] = (unsigned char)((77 * source[i].r + 150 * source[i].g + 29 * source[i].b + 128) >> 8);
+	}
+}
+
+void expandGray8ToBGRA32(const unsigned char* source, unsigned int* destination, size_t count)
+{
+	size_t i = 0;
+
+#ifdef IMAGEBMP_HAS_SSE2
+	__m128i opaque = _mm_set1_epi8((char)0xFF);
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+
+		//(g, g) and (g, 0xFF) byte pairs, then interleaved into (g, g, g, 0xFF):
+		__m128i grayGrayLow = _mm_unpacklo_epi8(gray, gray);
+		__m128i grayGrayHigh = _mm_unpackhi_epi8(gray, gray);
+		__m128i grayAlphaLow = _mm_unpacklo_epi8(gray, opaque);
+		__m128i grayAlphaHigh = _mm_unpackhi_epi8(gray, opaque);
+
+		__m128i* output = reinterpret_cast<__m128i*>(destination + i);
+		_mm_storeu_si128(output + 0, _mm_unpacklo_epi16(grayGrayLow, grayAlphaLow));
+		_mm_storeu_si128(output + 1, _mm_unpackhi_epi16(grayGrayLow, grayAlphaLow));
+		_mm_storeu_si128(output + 2, _mm_unpacklo_epi16(grayGrayHigh, grayAlphaHigh));
+		_mm_storeu_si128(output + 3, _mm_unpackhi_epi16(grayGrayHigh, grayAlphaHigh));
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		destination[i] = grayToPixel(source[i]);
+	}
+}
+
+void expandGray8ToBGR24(const unsigned char* source, BGR* destination, size_t count)
+{
+	size_t i = 0;
+
+#ifdef IMAGEBMP_HAS_SSSE3
+	//16 gray bytes -> 48 output bytes, each output byte k taking gray[k / 3]:
+	__m128i first = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+	__m128i second = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+	__m128i third = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+		__m128i* output = reinterpret_cast<__m128i*>(destination + i);
+
+		_mm_storeu_si128(output + 0, _mm_shuffle_epi8(gray, first));
+		_mm_storeu_si128(output + 1, _mm_shuffle_epi8(gray, second));
+		_mm_storeu_si128(output + 2, _mm_shuffle_epi8(gray, third));
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		destination[i] = BGR{ source[i], source[i], source[i] };
+	}
+}
@@ -0,0 +1,304 @@
+#pragma once
+
+#include<cstddef>
+#include<cstring>
+
+/*SSE2 is part of every x64 target (and of x86 builds with /arch:SSE2 or -msse2)*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGEBMP_HAS_SSE2 1
+#endif
+
+/*SSSE3 (pshufb) has no MSVC macro of its own - /arch:AVX (or later) implies it*/
+#if defined(__SSSE3__) || defined(__AVX__)
+#define IMAGEBMP_HAS_SSSE3 1
+#endif
+
+/*pixel formats known to the library
+- BGRA32 is the "normal" one (one Color per pixel)
+- the 16-bit ones halve the footprint, but drop alpha and the low bits of each channel
+- PixelData itself only keeps BGRA32, RGB565 or RGB555; the others are for TypedImage (see TypedImage.h)*/
+enum class PixelFormat : unsigned int
+{
+	BGRA32,
+	RGB565,
+	RGB555,
+	BGR24,
+	Gray8,
+	Gray16
+};
+
+//BI_BITFIELDS masks (as stored in the BMP header) for the 16-bit formats:
+constexpr unsigned int rgb565RedMask = 0x00'00'F8'00;
+constexpr unsigned int rgb565GreenMask = 0x00'00'07'E0;
+constexpr unsigned int rgb565BlueMask = 0x00'00'00'1F;
+
+constexpr unsigned int rgb555RedMask = 0x00'00'7C'00;
+constexpr unsigned int rgb555GreenMask = 0x00'00'03'E0;
+constexpr unsigned int rgb555BlueMask = 0x00'00'00'1F;
+
+/*returns BGRA32 if the masks are neither 565 nor 555 (ie: not a layout we can pack/unpack)*/
+PixelFormat pixelFormatFromBitfieldMasks(unsigned int redMask, unsigned int greenMask, unsigned int blueMask);
+
+/*pack `count` BGRA32 pixels into 16-bit words (alpha is dropped)
+- uses SSE2 (8 pixels per iteration) when available*/
+void packBGRA32To16Bit(const unsigned int* source, unsigned short* destination, size_t count, PixelFormat format);
+
+/*the reverse - channels are widened by bit replication (so 0x1F becomes 0xFF, not 0xF8) and alpha is set to 255*/
+void unpack16BitToBGRA32(const unsigned short* source, unsigned int* destination, size_t count, PixelFormat format);
+
+#pragma region single-pixel conversions
+/*(the row functions above use these for leftover pixels, and the format structs below use them directly)*/
+
+inline unsigned short packPixelTo565(unsigned int bgra)
+{
+	//top 5 bits of R -> bits 11-15, top 6 of G -> 5-10, top 5 of B -> 0-4
+	return (unsigned short)(((bgra >> 8) & 0xF800) | ((bgra >> 5) & 0x07E0) | ((bgra >> 3) & 0x001F));
+}
+
+inline unsigned short packPixelTo555(unsigned int bgra)
+{
+	return (unsigned short)(((bgra >> 9) & 0x7C00) | ((bgra >> 6) & 0x03E0) | ((bgra >> 3) & 0x001F));
+}
+
+inline unsigned int unpackPixelFrom565(unsigned short packed)
+{
+	unsigned int r = (packed >> 11) & 0x1F;
+	unsigned int g = (packed >> 5) & 0x3F;
+	unsigned int b = packed & 0x1F;
+
+	r = (r << 3) | (r >> 2);
+	g = (g << 2) | (g >> 4);
+	b = (b << 3) | (b >> 2);
+
+	return 0xFF'00'00'00 | (r << 16) | (g << 8) | b;
+}
+
+inline unsigned int unpackPixelFrom555(unsigned short packed)
+{
+	unsigned int r = (packed >> 10) & 0x1F;
+	unsigned int g = (packed >> 5) & 0x1F;
+	unsigned int b = packed & 0x1F;
+
+	r = (r << 3) | (r >> 2);
+	g = (g << 3) | (g >> 2);
+	b = (b << 3) | (b >> 2);
+
+	return 0xFF'00'00'00 | (r << 16) | (g << 8) | b;
+}
+
+/*BT.601 luma with integer weights (77 + 150 + 29 = 256, so white stays 255)*/
+inline unsigned char lumaOfPixel(unsigned int bgra)
+{
+	unsigned int b = bgra & 0xFF;
+	unsigned int g = (bgra >> 8) & 0xFF;
+	unsigned int r = (bgra >> 16) & 0xFF;
+
+	return (unsigned char)((77 * r + 150 * g + 29 * b + 128) >> 8);
+}
+
+inline unsigned int grayToPixel(unsigned char gray)
+{
+	return 0xFF'00'00'00 | (gray << 16) | (gray << 8) | gray;
+}
+
+#pragma endregion
+
+#pragma region compile-time pixel formats
+/*each struct describes one format for TypedImage<Format>:
+- PixelType: what one pixel is stored as
+- format: the matching runtime PixelFormat
+- bitsPerPixel: size of one pixel IN MEMORY
+- FileFormat: the format whose PixelType array IS the bytes of a BMP row (itself for 32/24/16/8-bit)
+- fromBGRA/toBGRA: the "slow" per-pixel route every conversion can fall back on*/
+
+//one 24-bit BMP pixel, in file order:
+struct BGR
+{
+	unsigned char b = 0;
+	unsigned char g = 0;
+	unsigned char r = 0;
+};
+static_assert(sizeof(BGR) == 3, "BGR must not be padded - 24-bit rows are read straight into it");
+
+struct FormatBGRA32
+{
+	using PixelType = unsigned int;
+	using FileFormat = FormatBGRA32;
+	static constexpr PixelFormat format = PixelFormat::BGRA32;
+	static constexpr short bitsPerPixel = 32;
+
+	static PixelType fromBGRA(unsigned int bgra) { return bgra; }
+	static unsigned int toBGRA(PixelType pixel) { return pixel; }
+};
+
+struct FormatBGR24
+{
+	using PixelType = BGR;
+	using FileFormat = FormatBGR24;
+	static constexpr PixelFormat format = PixelFormat::BGR24;
+	static constexpr short bitsPerPixel = 24;
+
+	static PixelType fromBGRA(unsigned int bgra)
+	{
+		return BGR{ (unsigned char)(bgra & 0xFF), (unsigned char)((bgra >> 8) & 0xFF), (unsigned char)((bgra >> 16) & 0xFF) };
+	}
+	static unsigned int toBGRA(PixelType pixel)
+	{
+		return 0xFF'00'00'00 | ((unsigned int)pixel.r << 16) | ((unsigned int)pixel.g << 8) | pixel.b;
+	}
+};
+
+struct FormatRGB565
+{
+	using PixelType = unsigned short;
+	using FileFormat = FormatRGB565;
+	static constexpr PixelFormat format = PixelFormat::RGB565;
+	static constexpr short bitsPerPixel = 16;
+
+	static PixelType fromBGRA(unsigned int bgra) { return packPixelTo565(bgra); }
+	static unsigned int toBGRA(PixelType pixel) { return unpackPixelFrom565(pixel); }
+};
+
+struct FormatRGB555
+{
+	using PixelType = unsigned short;
+	using FileFormat = FormatRGB555;
+	static constexpr PixelFormat format = PixelFormat::RGB555;
+	static constexpr short bitsPerPixel = 16;
+
+	static PixelType fromBGRA(unsigned int bgra) { return packPixelTo555(bgra); }
+	static unsigned int toBGRA(PixelType pixel) { return unpackPixelFrom555(pixel); }
+};
+
+/*written as 8-bit BMPs with a 256-entry gray palette (so the palette index IS the gray level)*/
+struct FormatGray8
+{
+	using PixelType = unsigned char;
+	using FileFormat = FormatGray8;
+	static constexpr PixelFormat format = PixelFormat::Gray8;
+	static constexpr short bitsPerPixel = 8;
+
+	static PixelType fromBGRA(unsigned int bgra) { return lumaOfPixel(bgra); }
+	static unsigned int toBGRA(PixelType pixel) { return grayToPixel(pixel); }
+};
+
+struct FormatGray16
+{
+	using PixelType = unsigned short;
+	using FileFormat = FormatGray8; //BMP has no 16-bit gray, so the low byte is dropped
+	static constexpr PixelFormat format = PixelFormat::Gray16;
+	static constexpr short bitsPerPixel = 16;
+
+	static PixelType fromBGRA(unsigned int bgra) { return (PixelType)(lumaOfPixel(bgra) * 257); } //0xFF -> 0xFFFF
+	static unsigned int toBGRA(PixelType pixel) { return grayToPixel((unsigned char)(pixel >> 8)); }
+};
+
+/*converts a row of `count` pixels from one format to another
+- the general version goes through BGRA32 one pixel at a time (still no branches - it is all resolved at compile time)
+- the specializations below are the fast paths*/
+template<typename SourceFormat, typename DestinationFormat>
+struct RowConverter
+{
+	static void convert(const typename SourceFormat::PixelType* source, typename DestinationFormat::PixelType* destination, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			destination[i] = DestinationFormat::fromBGRA(SourceFormat::toBGRA(source[i]));
+		}
+	}
+};
+
+template<typename Format>
+struct RowConverter<Format, Format>
+{
+	static void convert(const typename Format::PixelType* source, typename Format::PixelType* destination, size_t count)
+	{
+		std::memcpy(destination, source, count * sizeof(typename Format::PixelType));
+	}
+};
+
+template<>
+struct RowConverter<FormatBGRA32, FormatRGB565>
+{
+	static void convert(const unsigned int* source, unsigned short* destination, size_t count)
+	{
+		packBGRA32To16Bit(source, destination, count, PixelFormat::RGB565);
+	}
+};
+
+template<>
+struct RowConverter<FormatBGRA32, FormatRGB555>
+{
+	static void convert(const unsigned int* source, unsigned short* destination, size_t count)
+	{
+		packBGRA32To16Bit(source, destination, count, PixelFormat::RGB555);
+	}
+};
+
+template<>
+struct RowConverter<FormatRGB565, FormatBGRA32>
+{
+	static void convert(const unsigned short* source, unsigned int* destination, size_t count)
+	{
+		unpack16BitToBGRA32(source, destination, count, PixelFormat::RGB565);
+	}
+};
+
+template<>
+struct RowConverter<FormatRGB555, FormatBGRA32>
+{
+	static void convert(const unsigned short* source, unsigned int* destination, size_t count)
+	{
+		unpack16BitToBGRA32(source, destination, count, PixelFormat::RGB555);
+	}
+};
+
+/*grayscale fast paths (SSE2 for BGRA32, SSSE3 for the 3-byte BGR24 layout - scalar otherwise)*/
+void convertBGRA32ToGray8(const unsigned int* source, unsigned char* destination, size_t count);
+void convertBGR24ToGray8(const BGR* source, unsigned char* destination, size_t count);
+void expandGray8ToBGRA32(const unsigned char* source, unsigned int* destination, size_t count);
+void expandGray8ToBGR24(const unsigned char* source, BGR* destination, size_t count);
+
+template<>
+struct RowConverter<FormatBGRA32, FormatGray8>
+{
+	static void convert(const unsigned int* source, unsigned char* destination, size_t count)
+	{
+		convertBGRA32ToGray8(source, destination, count);
+	}
+};
+
+template<>
+struct RowConverter<FormatBGR24, FormatGray8>
+{
+	static void convert(const BGR* source, unsigned char* destination, size_t count)
+	{
+		convertBGR24ToGray8(source, destination, count);
+	}
+};
+
+template<>
+struct RowConverter<FormatGray8, FormatBGRA32>
+{
+	static void convert(const unsigned char* source, unsigned int* destination, size_t count)
+	{
+		expandGray8ToBGRA32(source, destination, count);
+	}
+};
+
+template<>
+struct RowConverter<FormatGray8, FormatBGR24>
+{
+	static void convert(const unsigned char* source, BGR* destination, size_t count)
+	{
+		expandGray8ToBGR24(source, destination, count);
+	}
+};
+
+template<typename SourceFormat, typename DestinationFormat>
+void convertRow(const typename SourceFormat::PixelType* source, typename DestinationFormat::PixelType* destination, size_t count)
+{
+	RowConverter<SourceFormat, DestinationFormat>::convert(source, destination, count);
+}
+
+#pragma endregion
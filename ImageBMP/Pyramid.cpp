@@ -0,0 +1,347 @@
+#include "Pyramid.h"
+
+#include<algorithm>
+#include<filesystem>
+#include<future>
+#include<memory>
+
+#include "AsyncImageWriter.h"
+#include "BMPRegionReader.h"
+
+#ifdef IMAGEBMP_HAS_SSE2
+#include<emmintrin.h>
+#endif
+
+void halveRows(const Color* lower, const Color* upper, Color* destination, size_t count)
+{
+	size_t i = 0;
+
+#ifdef IMAGEBMP_HAS_SSE2
+	//2 output pixels per step: 4 pixels from each row, summed in 16-bit lanes
+	__m128i zero = _mm_setzero_si128();
+	__m128i rounding = _mm_set1_epi16(2);
+
+	for (; i + 2 <= count; i += 2)
+	{
+		__m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lower + 2 * i));
+		__m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(upper + 2 * i));
+
+		//pixels 0, 1 and pixels 2, 3 of both rows, added up vertically:
+		__m128i firstPair = _mm_add_epi16(_mm_unpacklo_epi8(bottom, zero), _mm_unpacklo_epi8(top, zero));
+		__m128i secondPair = _mm_add_epi16(_mm_unpackhi_epi8(bottom, zero), _mm_unpackhi_epi8(top, zero));
+
+		//...then each pair horizontally (its second pixel sits in the upper 8 bytes):
+		firstPair = _mm_add_epi16(firstPair, _mm_srli_si128(firstPair, 8));
+		secondPair = _mm_add_epi16(secondPair, _mm_srli_si128(secondPair, 8));
+
+		__m128i sums = _mm_unpacklo_epi64(firstPair, secondPair);
+		__m128i averages = _mm_srli_epi16(_mm_add_epi16(sums, rounding), 2);
+
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(destination + i), _mm_packus_epi16(averages, averages));
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		unsigned int a = lower[2 * i].bgra, b = lower[2 * i + 1].bgra, c = upper[2 * i].bgra, d = upper[2 * i + 1].bgra;
+		unsigned int average = 0;
+
+		for (int shift = 0; shift < 32; shift += 8)
+		{
+			unsigned int sum = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF) + ((c >> shift) & 0xFF) + ((d >> shift) & 0xFF);
+			average |= ((sum + 2) >> 2) << shift;
+		}
+
+		destination[i].bgra = average;
+	}
+}
+
+string pyramidTilePath(const string& outputFolder, unsigned int level, unsigned int x, unsigned int y)
+{
+	return (std::filesystem::path(outputFolder) / std::to_string(level) / (std::to_string(x) + "_" + std::to_string(y) + ".bmp")).string();
+}
+
+namespace
+{
+	/*one level while the pyramid is being built: rows come in bottom to top, go into the strip, and every second one
+	(with the one before it) is reduced into the next level*/
+	class LevelBuilder
+	{
+	public:
+		LevelBuilder(unsigned int index, const PyramidLevel& size, const string& outputFolder, const PyramidOptions& options,
+			AsyncImageWriter& writer, vector<std::future<BMPStatus>>& writes, LevelBuilder* next)
+			: index(index), size(size), outputFolder(outputFolder), options(options), writer(writer), writes(writes), next(next),
+			strip(size.width, std::min(options.tileSize, size.height)),
+			pendingRow(evenWidth()), incomingRow(evenWidth()), reducedRow(next ? next->size.width : 0)
+		{
+		}
+
+		/*`row` has size.width pixels (more may follow - they are ignored)*/
+		void addRow(const Color* row)
+		{
+			std::copy_n(row, size.width, strip[rowsInStrip].data());
+			++rowsInStrip;
+
+			if (rowsInStrip == strip.getHeight())
+			{
+				flushStrip();
+			}
+
+			if (next == nullptr)
+			{
+				return;
+			}
+
+			if (!hasPendingRow)
+			{
+				copyPadded(row, pendingRow);
+				hasPendingRow = true;
+				return;
+			}
+
+			copyPadded(row, incomingRow);
+			halveRows(pendingRow.data(), incomingRow.data(), reducedRow.data(), reducedRow.size());
+			hasPendingRow = false;
+
+			next->addRow(reducedRow.data());
+		}
+
+		/*after the last row: an odd last row is reduced with itself, and the levels above are finished too*/
+		void finish()
+		{
+			if (rowsInStrip > 0)
+			{
+				flushStrip();
+			}
+
+			if (next == nullptr)
+			{
+				return;
+			}
+
+			if (hasPendingRow)
+			{
+				halveRows(pendingRow.data(), pendingRow.data(), reducedRow.data(), reducedRow.size());
+				hasPendingRow = false;
+				next->addRow(reducedRow.data());
+			}
+
+			next->finish();
+		}
+
+	private:
+		size_t evenWidth() const { return (size_t)size.width + (size.width & 1); }
+
+		/*an odd-width row gets its last pixel repeated, so every output pixel has a full 2 x 2 block*/
+		void copyPadded(const Color* row, vector<Color>& destination) const
+		{
+			std::copy_n(row, size.width, destination.data());
+
+			if (destination.size() > size.width)
+			{
+				destination[size.width] = row[size.width - 1];
+			}
+		}
+
+		void flushStrip()
+		{
+			unsigned int tileY = stripIndex;
+
+			for (unsigned int tileX = 0; tileX < size.tilesAcross; ++tileX)
+			{
+				unsigned int x0 = tileX * options.tileSize;
+				unsigned int tileWidth = std::min(options.tileSize, size.width - x0);
+
+				ImageBMP tile = ImageBMP::makePooled(tileWidth, rowsInStrip, Color());
+
+				for (unsigned int row = 0; row < rowsInStrip; ++row)
+				{
+					std::copy_n(strip[row].data() + x0, tileWidth, tile.pixelData.pixelMatrix[row].data());
+				}
+
+				tile.setOutputFormat(options.tileFormat);
+				writes.push_back(writer.save(std::move(tile), pyramidTilePath(outputFolder, index, tileX, tileY)));
+			}
+
+			++stripIndex;
+			rowsInStrip = 0;
+		}
+
+		unsigned int index;
+		PyramidLevel size;
+		const string& outputFolder;
+		const PyramidOptions& options;
+		AsyncImageWriter& writer;
+		vector<std::future<BMPStatus>>& writes;
+		LevelBuilder* next;
+
+		PixelMatrix strip; //(rows bottom-up, like every pixelMatrix)
+		unsigned int rowsInStrip = 0;
+		unsigned int stripIndex = 0;
+
+		vector<Color> pendingRow;
+		vector<Color> incomingRow;
+		bool hasPendingRow = false;
+		vector<Color> reducedRow;
+	};
+}
+
+BMPStatus buildPyramid(const string& sourcePath, const string& outputFolder, const PyramidOptions& options, vector<PyramidLevel>* levels)
+{
+	if (options.tileSize == 0)
+	{
+		return BMPError::BadDimensions;
+	}
+
+	BMPRegionReader reader;
+	BMPStatus status = reader.open(sourcePath);
+
+	if (!status)
+	{
+		return status;
+	}
+
+	//level sizes first: halve (rounding up) until everything fits in one tile
+	vector<PyramidLevel> sizes;
+	unsigned int width = reader.getWidth(), height = reader.getHeight();
+
+	while (true)
+	{
+		sizes.push_back(PyramidLevel{ width, height, (width + options.tileSize - 1) / options.tileSize, (height + options.tileSize - 1) / options.tileSize });
+
+		if (width <= options.tileSize && height <= options.tileSize)
+		{
+			break;
+		}
+
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+
+	std::error_code error;
+	for (size_t level = 0; level < sizes.size(); ++level)
+	{
+		std::filesystem::create_directories(std::filesystem::path(outputFolder) / std::to_string(level), error);
+
+		if (error)
+		{
+			return BMPError::CannotCreateFile;
+		}
+	}
+
+	{
+		//(the writer finishes every queued tile before it is destroyed - so before the futures are looked at)
+		AsyncImageWriter writer(8);
+		vector<std::future<BMPStatus>> writes;
+
+		//built top level first, so each builder can point at the (smaller) level after it:
+		vector<std::unique_ptr<LevelBuilder>> builders(sizes.size());
+		for (size_t level = sizes.size(); level-- > 0;)
+		{
+			LevelBuilder* next = (level + 1 < sizes.size()) ? builders[level + 1].get() : nullptr;
+			builders[level] = std::make_unique<LevelBuilder>((unsigned int)level, sizes[level], outputFolder, options, writer, writes, next);
+		}
+
+		//the single pass over the source, bottom row first:
+		vector<Color> sourceRow(reader.getWidth());
+
+		for (unsigned int row = 0; row < reader.getHeight() && status; ++row)
+		{
+			status = reader.readRegion(0, row, ImageView(sourceRow.data(), reader.getWidth(), 1, reader.getWidth()));
+
+			if (status)
+			{
+				builders[0]->addRow(sourceRow.data());
+			}
+		}
+
+		if (status)
+		{
+			builders[0]->finish();
+		}
+
+		writer.waitUntilIdle();
+
+		for (auto& write : writes)
+		{
+			BMPStatus written = write.get();
+
+			if (status && !written)
+			{
+				status = written;
+			}
+		}
+	}
+
+	if (!status)
+	{
+		return status;
+	}
+
+	ofstream index{ (std::filesystem::path(outputFolder) / "pyramid.txt").string() };
+
+	index << "BMPPYRAMID 1\n";
+	index << "size " << reader.getWidth() << " " << reader.getHeight() << "\n";
+	index << "tileSize " << options.tileSize << "\n";
+	index << "levels " << sizes.size() << "\n";
+
+	for (size_t level = 0; level < sizes.size(); ++level)
+	{
+		index << "level " << level << " " << sizes[level].width << " " << sizes[level].height << " "
+			<< sizes[level].tilesAcross << " " << sizes[level].tilesUp << "\n";
+	}
+
+	index.close();
+
+	if (index.fail())
+	{
+		return BMPError::WriteFailed;
+	}
+
+	if (levels != nullptr)
+	{
+		*levels = sizes;
+	}
+
+	return BMPError::None;
+}
+
+BMPStatus readPyramidIndex(const string& outputFolder, unsigned int& tileSize, vector<PyramidLevel>& levels)
+{
+	ifstream index{ (std::filesystem::path(outputFolder) / "pyramid.txt").string() };
+
+	if (!index)
+	{
+		return BMPError::FileNotFound;
+	}
+
+	string keyword;
+	int version = 0;
+	unsigned int sourceWidth = 0, sourceHeight = 0;
+	size_t levelCount = 0;
+
+	if (!(index >> keyword >> version) || keyword != "BMPPYRAMID" || version != 1
+		|| !(index >> keyword >> sourceWidth >> sourceHeight) || keyword != "size"
+		|| !(index >> keyword >> tileSize) || keyword != "tileSize"
+		|| !(index >> keyword >> levelCount) || keyword != "levels" || levelCount == 0 || levelCount > 64)
+	{
+		return BMPError::NotABMP;
+	}
+
+	levels.assign(levelCount, PyramidLevel());
+
+	for (size_t level = 0; level < levelCount; ++level)
+	{
+		size_t levelIndex = 0;
+		PyramidLevel& size = levels[level];
+
+		if (!(index >> keyword >> levelIndex >> size.width >> size.height >> size.tilesAcross >> size.tilesUp)
+			|| keyword != "level" || levelIndex != level)
+		{
+			levels.clear();
+			return BMPError::NotABMP;
+		}
+	}
+
+	return BMPError::None;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include<string>
+#include<vector>
+
+#include "ImageBMP.h"
+
+/*a multi-resolution pyramid for deep-zoom viewing: level 0 is the source image, each level after it half the width and height
+(rounded up) of the one before, down to the first level that fits in a single tile
+
+on disk, in outputFolder:
+	pyramid.txt            the index (see below)
+	<level>/<x>_<y>.bmp    tile x (from the left), y (from the BOTTOM - row 0 is the bottom everywhere in this library)
+edge tiles are smaller than tileSize x tileSize
+
+pyramid.txt:
+	BMPPYRAMID 1
+	size <source width> <source height>
+	tileSize <tileSize>
+	levels <level count>
+	level <index> <width> <height> <tiles across> <tiles up>      (one line per level)
+
+the source is read ONCE, row by row (see BMPRegionReader), and never held in memory whole: each level keeps one strip of
+tileSize rows (written as tiles as soon as it is full) plus the row waiting for its pair to be reduced into the next level
+- so a gigapixel scan needs about 2 x (its width x tileSize) pixels of memory*/
+
+struct PyramidOptions
+{
+	unsigned int tileSize = 256;
+	PixelFormat tileFormat = PixelFormat::BGR24; //(what the tiles are written as - see ImageBMP::setOutputFormat)
+};
+
+struct PyramidLevel
+{
+	unsigned int width = 0;
+	unsigned int height = 0;
+	unsigned int tilesAcross = 0;
+	unsigned int tilesUp = 0;
+};
+
+/*writes the pyramid of the BMP file at sourcePath into outputFolder (created if needed)
+- levels (if not null) gets the size of every level, level 0 first*/
+BMPStatus buildPyramid(const string& sourcePath, const string& outputFolder, const PyramidOptions& options = PyramidOptions(),
+	vector<PyramidLevel>* levels = nullptr);
+
+/*reads pyramid.txt back - NotABMP if it is not a pyramid index*/
+BMPStatus readPyramidIndex(const string& outputFolder, unsigned int& tileSize, vector<PyramidLevel>& levels);
+
+/*where tile (x, y) of `level` is (or would be) written*/
+string pyramidTilePath(const string& outputFolder, unsigned int level, unsigned int x, unsigned int y);
+
+/*a row of 2 * count pixels from each of two rows -> count pixels, each the rounded average of its 2 x 2 block*/
+void halveRows(const Color* lower, const Color* upper, Color* destination, size_t count);
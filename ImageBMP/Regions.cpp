@@ -0,0 +1,321 @@
+#include "Regions.h"
+
+#include<algorithm>
+#include<cstdlib>
+
+namespace
+{
+	bool withinTolerance(unsigned int first, unsigned int second, unsigned int tolerance)
+	{
+		if (((first ^ second) & 0x00FFFFFF) == 0)
+		{
+			return true;
+		}
+
+		for (unsigned int shift = 0; shift < 24; shift += 8)
+		{
+			int difference = (int)((first >> shift) & 0xFF) - (int)((second >> shift) & 0xFF);
+
+			if ((unsigned int)std::abs(difference) > tolerance)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/*a span of row y, [left, right], whose row y + direction still has to be looked at*/
+	struct PendingSpan
+	{
+		int left;
+		int right;
+		int y;
+		int direction;
+	};
+
+	/*union-find over provisional labels (parent[label] == label for a root)*/
+	class LabelForest
+	{
+		vector<unsigned int> parent{ 0 }; //(label 0 = background, never merged)
+
+	public:
+		unsigned int makeLabel()
+		{
+			parent.push_back((unsigned int)parent.size());
+			return (unsigned int)parent.size() - 1;
+		}
+
+		unsigned int find(unsigned int label)
+		{
+			unsigned int root = label;
+			while (parent[root] != root)
+			{
+				root = parent[root];
+			}
+
+			//path compression - every label on the way now points straight at the root:
+			while (parent[label] != root)
+			{
+				unsigned int next = parent[label];
+				parent[label] = root;
+				label = next;
+			}
+			return root;
+		}
+
+		/*the smaller root wins, so roots are numbered in the order their regions were first met*/
+		unsigned int merge(unsigned int first, unsigned int second)
+		{
+			first = find(first);
+			second = find(second);
+
+			if (first < second)
+			{
+				parent[second] = first;
+				return first;
+			}
+			parent[first] = second;
+			return second;
+		}
+
+		size_t size() const { return parent.size(); }
+	};
+
+	/*the two passes - isForeground(x, y) and connected(x, y, neighbourX, neighbourY) say what a region is*/
+	template<typename IsForeground, typename Connected>
+	ComponentLabels labelComponents(unsigned int width, unsigned int height, Connectivity connectivity,
+		IsForeground isForeground, Connected connected)
+	{
+		ComponentLabels result;
+		result.width = width;
+		result.height = height;
+		result.labels.assign((size_t)width * height, 0);
+
+		LabelForest forest;
+
+		//pass 1: neighbours already visited are the left one and (the row below) the ones underneath
+		for (unsigned int y = 0; y < height; ++y)
+		{
+			unsigned int* row = &result.labels[(size_t)y * width];
+			const unsigned int* below = (y > 0) ? row - width : nullptr;
+
+			for (unsigned int x = 0; x < width; ++x)
+			{
+				if (!isForeground(x, y))
+				{
+					continue;
+				}
+
+				unsigned int label = 0;
+
+				auto join = [&](unsigned int neighbourLabel, unsigned int neighbourX, unsigned int neighbourY)
+				{
+					if (neighbourLabel != 0 && connected(x, y, neighbourX, neighbourY))
+					{
+						label = (label == 0) ? forest.find(neighbourLabel) : forest.merge(label, neighbourLabel);
+					}
+				};
+
+				if (x > 0)
+				{
+					join(row[x - 1], x - 1, y);
+				}
+				if (below != nullptr)
+				{
+					join(below[x], x, y - 1);
+
+					if (connectivity == Connectivity::Eight)
+					{
+						if (x > 0)
+						{
+							join(below[x - 1], x - 1, y - 1);
+						}
+						if (x + 1 < width)
+						{
+							join(below[x + 1], x + 1, y - 1);
+						}
+					}
+				}
+
+				row[x] = (label != 0) ? label : forest.makeLabel();
+			}
+		}
+
+		//pass 2: each provisional label -> its root -> a final label (1, 2, ... in order of first appearance)
+		vector<unsigned int> finalLabel(forest.size(), 0);
+
+		for (unsigned int y = 0; y < height; ++y)
+		{
+			unsigned int* row = &result.labels[(size_t)y * width];
+
+			for (unsigned int x = 0; x < width; ++x)
+			{
+				if (row[x] == 0)
+				{
+					continue;
+				}
+
+				unsigned int root = forest.find(row[x]);
+
+				if (finalLabel[root] == 0)
+				{
+					finalLabel[root] = (unsigned int)result.components.size() + 1;
+
+					Component component;
+					component.label = finalLabel[root];
+					component.bounds = DirtyRectangle{ x, y, 1, 1 };
+					result.components.push_back(component);
+				}
+
+				row[x] = finalLabel[root];
+
+				Component& component = result.components[row[x] - 1];
+				DirtyRectangle& bounds = component.bounds;
+
+				++component.area;
+
+				unsigned int left = std::min(bounds.x, x);
+				unsigned int right = std::max(bounds.x + bounds.width, x + 1);
+				bounds.x = left;
+				bounds.width = right - left;
+				bounds.height = y + 1 - bounds.y; //(rows only ever go up)
+			}
+		}
+
+		return result;
+	}
+}
+
+FillResult floodFill(const ImageView& target, int x, int y, const Color& fillColor, unsigned int tolerance)
+{
+	FillResult result;
+
+	if (!target.contains(x, y))
+	{
+		return result;
+	}
+
+	int width = (int)target.getWidth();
+	int height = (int)target.getHeight();
+	unsigned int seedColor = target[(unsigned int)y][(size_t)x].bgra;
+
+	//if fillColor itself counts as "inside", filled pixels can't be told from unfilled ones by color - so keep track:
+	bool fillColorMatches = withinTolerance(fillColor.bgra, seedColor, tolerance);
+
+	if (fillColorMatches && tolerance == 0 && fillColor.bgra == seedColor)
+	{
+		return result; //(nothing would change)
+	}
+
+	vector<unsigned char> filled(fillColorMatches ? (size_t)width * height : 0, 0);
+
+	int left = x, right = x, bottom = y, top = y;
+
+	auto inside = [&](int px, int py)
+	{
+		if (px < 0 || py < 0 || px >= width || py >= height)
+		{
+			return false;
+		}
+		if (fillColorMatches && filled[(size_t)py * width + px])
+		{
+			return false;
+		}
+		return withinTolerance(target[(unsigned int)py][(size_t)px].bgra, seedColor, tolerance);
+	};
+
+	auto set = [&](int px, int py)
+	{
+		target[(unsigned int)py][(size_t)px] = fillColor;
+
+		if (fillColorMatches)
+		{
+			filled[(size_t)py * width + px] = 1;
+		}
+
+		++result.filledPixels;
+		left = std::min(left, px);
+		right = std::max(right, px);
+		bottom = std::min(bottom, py);
+		top = std::max(top, py);
+	};
+
+	vector<PendingSpan> stack;
+	stack.push_back(PendingSpan{ x, x, y, 1 });
+	stack.push_back(PendingSpan{ x, x, y - 1, -1 });
+
+	while (!stack.empty())
+	{
+		PendingSpan span = stack.back();
+		stack.pop_back();
+
+		int x1 = span.left;
+		int x2 = span.right;
+		int row = span.y;
+		int direction = span.direction;
+		int runStart = x1;
+
+		//a run that starts left of the span - extend it leftwards (and its far side needs looking at):
+		if (inside(runStart, row))
+		{
+			while (inside(runStart - 1, row))
+			{
+				set(runStart - 1, row);
+				--runStart;
+			}
+			if (runStart < x1)
+			{
+				stack.push_back(PendingSpan{ runStart, x1 - 1, row - direction, -direction });
+			}
+		}
+
+		while (x1 <= x2)
+		{
+			while (inside(x1, row))
+			{
+				set(x1, row);
+				++x1;
+			}
+
+			if (x1 > runStart)
+			{
+				stack.push_back(PendingSpan{ runStart, x1 - 1, row + direction, direction });
+			}
+			if (x1 - 1 > x2)
+			{
+				stack.push_back(PendingSpan{ x2 + 1, x1 - 1, row - direction, -direction });
+			}
+
+			++x1;
+			while (x1 < x2 && !inside(x1, row))
+			{
+				++x1;
+			}
+			runStart = x1;
+		}
+	}
+
+	if (result.filledPixels > 0)
+	{
+		result.bounds = DirtyRectangle{ (unsigned int)left, (unsigned int)bottom, (unsigned int)(right - left + 1), (unsigned int)(top - bottom + 1) };
+	}
+
+	return result;
+}
+
+ComponentLabels labelColorRegions(const ImageView& image, unsigned int tolerance, Connectivity connectivity)
+{
+	return labelComponents(image.getWidth(), image.getHeight(), connectivity,
+		[](unsigned int, unsigned int) { return true; },
+		[&image, tolerance](unsigned int x, unsigned int y, unsigned int neighbourX, unsigned int neighbourY)
+		{
+			return withinTolerance(image[y][x].bgra, image[neighbourY][neighbourX].bgra, tolerance);
+		});
+}
+
+ComponentLabels labelMaskComponents(const unsigned char* mask, unsigned int width, unsigned int height, Connectivity connectivity)
+{
+	return labelComponents(width, height, connectivity,
+		[mask, width](unsigned int x, unsigned int y) { return mask[(size_t)y * width + x] != 0; },
+		[](unsigned int, unsigned int, unsigned int, unsigned int) { return true; });
+}
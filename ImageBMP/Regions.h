@@ -0,0 +1,55 @@
+#pragma once
+
+#include<vector>
+
+#include "ImageBMP.h"
+
+/*what a flood fill changed*/
+struct FillResult
+{
+	unsigned long long filledPixels = 0;
+	DirtyRectangle bounds; //(0 x 0 if nothing was filled)
+};
+
+/*span-based seed fill: everything connected (4-way) to (x, y) whose color is within `tolerance` of the seed's
+(in every one of R, G and B - alpha is ignored) becomes fillColor
+- whole runs of a row are filled at once, and the spans still to look at are kept on an explicit stack,
+so the stack grows with the shape's complexity - never with its size - and huge regions can't overflow it*/
+FillResult floodFill(const ImageView& target, int x, int y, const Color& fillColor, unsigned int tolerance = 0);
+
+enum class Connectivity
+{
+	Four, //left/right/up/down neighbours
+	Eight //...and the diagonal ones
+};
+
+/*one connected region found by a labeller*/
+struct Component
+{
+	unsigned int label = 0;
+	unsigned long long area = 0;
+	DirtyRectangle bounds;
+};
+
+/*labels[y * width + x] = the label of pixel (x, y) - 1, 2, ... (0 = background, for masks only)
+- components[label - 1] describes that label*/
+struct ComponentLabels
+{
+	unsigned int width = 0;
+	unsigned int height = 0;
+	vector<unsigned int> labels;
+	vector<Component> components;
+
+	unsigned int at(unsigned int x, unsigned int y) const { return labels[(size_t)y * width + x]; }
+};
+
+/*two-pass labelling with union-find: the first pass gives each pixel a provisional label from its already-visited
+neighbours (and records which labels turn out to be the same region), the second replaces each label by its region's*/
+
+/*regions of (nearly) the same color - neighbours within `tolerance` of each other in R, G and B are one region
+(eg: the squares of a chessboard)*/
+ComponentLabels labelColorRegions(const ImageView& image, unsigned int tolerance = 0, Connectivity connectivity = Connectivity::Four);
+
+/*regions of nonzero mask values (mask[y * width + x], row 0 = bottom) - zeros are background (label 0)*/
+ComponentLabels labelMaskComponents(const unsigned char* mask, unsigned int width, unsigned int height,
+	Connectivity connectivity = Connectivity::Eight);
@@ -0,0 +1,166 @@
+#pragma once
+
+#include<algorithm>
+#include<array>
+#include<utility>
+
+#include "ImageBMP.h"
+
+/*a W x H image whose pixels live INSIDE the object (no heap, no headers) - for glyphs, icons and small sprites
+- row 0 is the bottom row, as in ImageBMP
+- constexpr all the way, so a sprite can be baked in at compile time:
+
+	constexpr auto arrow = SmallImage<4, 4>::fromPattern({
+		"..#.",
+		"####",
+		"####",
+		"..#." }, Color(ColorEnum::Red));
+
+- blitted with a fixed-size copy per row (unrolled over the rows when the whole image lands inside the target)*/
+template<unsigned int W, unsigned int H>
+class SmallImage
+{
+	static_assert(W > 0 && H > 0, "SmallImage - needs at least one pixel");
+
+	std::array<Color, (size_t)W * H> pixels{};
+
+	template<unsigned int... Rows>
+	void copyRows(const ImageView& target, unsigned int x, unsigned int y, std::integer_sequence<unsigned int, Rows...>) const
+	{
+		(std::copy_n(rowData(Rows), W, target[y + Rows].data() + x), ...);
+	}
+
+public:
+	static constexpr unsigned int width = W;
+	static constexpr unsigned int height = H;
+
+	constexpr SmallImage() = default;
+
+	constexpr explicit SmallImage(const Color& fillColor)
+	{
+		for (Color& pixel : pixels)
+		{
+			pixel = fillColor;
+		}
+	}
+
+	/*H strings of W characters, TOP row first (as the image reads) - ' ' and '.' are `background`, anything else is `ink`*/
+	static constexpr SmallImage fromPattern(const char* const(&pattern)[H], const Color& ink, const Color& background = Color())
+	{
+		SmallImage image;
+
+		for (unsigned int row = 0; row < H; ++row)
+		{
+			for (unsigned int col = 0; col < W; ++col)
+			{
+				char symbol = pattern[H - 1 - row][col];
+				image.at(col, row) = (symbol == ' ' || symbol == '.') ? background : ink;
+			}
+		}
+		return image;
+	}
+
+	constexpr Color& at(unsigned int x, unsigned int y) { return pixels[(size_t)y * W + x]; }
+	constexpr const Color& at(unsigned int x, unsigned int y) const { return pixels[(size_t)y * W + x]; }
+
+	constexpr Color* rowData(unsigned int y) { return pixels.data() + (size_t)y * W; }
+	constexpr const Color* rowData(unsigned int y) const { return pixels.data() + (size_t)y * W; }
+
+	/*to use the view-based drawing functions on it*/
+	ImageView view() { return ImageView(pixels.data(), W, H, W); }
+
+	/*(x, y) is where our bottom-left pixel goes; clipped to the target*/
+	void blitTo(const ImageView& target, int x, int y) const
+	{
+		if (x >= 0 && y >= 0 && (long long)x + W <= target.getWidth() && (long long)y + H <= target.getHeight())
+		{
+			copyRows(target, (unsigned int)x, (unsigned int)y, std::make_integer_sequence<unsigned int, H>());
+			return;
+		}
+
+		unsigned int firstCol = (unsigned int)std::max(-x, 0);
+		long long endCol = std::min<long long>(W, (long long)target.getWidth() - x);
+
+		for (unsigned int row = (unsigned int)std::max(-y, 0); row < H && (long long)y + row < target.getHeight(); ++row)
+		{
+			if ((long long)firstCol < endCol)
+			{
+				std::copy(rowData(row) + firstCol, rowData(row) + endCol, target[(unsigned int)(y + (int)row)].data() + (x + (int)firstCol));
+			}
+		}
+	}
+
+	/*the same, leaving the target alone wherever we are transparentColor*/
+	void blitTo(const ImageView& target, int x, int y, const Color& transparentColor) const
+	{
+		for (unsigned int row = 0; row < H; ++row)
+		{
+			for (unsigned int col = 0; col < W; ++col)
+			{
+				if (at(col, row).bgra != transparentColor.bgra)
+				{
+					target.setPixel(x + (int)col, y + (int)row, at(col, row));
+				}
+			}
+		}
+	}
+
+	/*draws `color` wherever we are NOT transparentColor - one glyph mask, any ink*/
+	void stampTo(const ImageView& target, int x, int y, const Color& color, const Color& transparentColor = Color()) const
+	{
+		for (unsigned int row = 0; row < H; ++row)
+		{
+			for (unsigned int col = 0; col < W; ++col)
+			{
+				if (at(col, row).bgra != transparentColor.bgra)
+				{
+					target.setPixel(x + (int)col, y + (int)row, color);
+				}
+			}
+		}
+	}
+
+	//on a whole image - only the covered rectangle is marked dirty:
+	void blitTo(ImageBMP& target, int x, int y) const
+	{
+		ImageView covered;
+		if (coveredView(target, x, y, covered))
+		{
+			blitTo(covered, x - (int)covered.getOriginX(), y - (int)covered.getOriginY());
+		}
+	}
+
+	void blitTo(ImageBMP& target, int x, int y, const Color& transparentColor) const
+	{
+		ImageView covered;
+		if (coveredView(target, x, y, covered))
+		{
+			blitTo(covered, x - (int)covered.getOriginX(), y - (int)covered.getOriginY(), transparentColor);
+		}
+	}
+
+	/*an ImageBMP copy (eg: to save it)*/
+	ImageBMP toImageBMP() const
+	{
+		ImageBMP image(W, H, Color());
+		blitTo(image.view(0, 0, W, H), 0, 0);
+		return image;
+	}
+
+private:
+	static bool coveredView(ImageBMP& target, int x, int y, ImageView& covered)
+	{
+		long long left = std::max<long long>(x, 0);
+		long long bottom = std::max<long long>(y, 0);
+		long long right = std::min<long long>((long long)x + W, target.infoHeader.imageWidth);
+		long long top = std::min<long long>((long long)y + H, target.infoHeader.imageHeight);
+
+		if (left >= right || bottom >= top)
+		{
+			return false;
+		}
+
+		covered = target.view((unsigned int)left, (unsigned int)bottom, (unsigned int)(right - left), (unsigned int)(top - bottom));
+		return true;
+	}
+};
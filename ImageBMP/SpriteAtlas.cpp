@@ -0,0 +1,503 @@
+#include "SpriteAtlas.h"
+
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+#include<numeric>
+
+namespace
+{
+	/*the atlas file:
+		"BMPATLAS", version, width, height, sprite count, offset of the pixels (8 bytes)
+		then per sprite: x, y, width, height, name length, name
+		then zeros up to the pixel offset (a multiple of atlasPageSize, so the mapped pixels start on a page)
+		then width * height BGRA32 pixels, bottom row first - exactly PixelMatrix's layout
+	(all little-endian, like the BMP headers)*/
+	const char atlasMagic[8] = { 'B', 'M', 'P', 'A', 'T', 'L', 'A', 'S' };
+	constexpr unsigned int atlasVersion = 1;
+	constexpr size_t atlasHeaderSize = 32;
+	constexpr size_t atlasPageSize = 4096;
+
+	/*the top edge of everything packed so far, as segments from left to right (always covering the whole width)*/
+	struct SkylineSegment
+	{
+		unsigned int x = 0;
+		unsigned int y = 0;
+		unsigned int width = 0;
+	};
+
+	/*lowest y for a rectangle `rectangleWidth` wide with its left edge at segment `first` - false if it would stick out on the right*/
+	bool fitOnSkyline(const vector<SkylineSegment>& skyline, size_t first, unsigned int rectangleWidth, unsigned int atlasWidth, unsigned int& y)
+	{
+		if ((unsigned long long)skyline[first].x + rectangleWidth > atlasWidth)
+		{
+			return false;
+		}
+
+		y = 0;
+		unsigned int remaining = rectangleWidth;
+
+		for (size_t i = first; remaining > 0; ++i)
+		{
+			y = std::max(y, skyline[i].y);
+			remaining -= std::min(remaining, skyline[i].width);
+		}
+
+		return true;
+	}
+
+	/*raises the skyline over [x, x + rectangleWidth) to `top`*/
+	void addToSkyline(vector<SkylineSegment>& skyline, size_t first, unsigned int rectangleWidth, unsigned int top)
+	{
+		unsigned int x = skyline[first].x;
+		unsigned int right = x + rectangleWidth;
+
+		skyline.insert(skyline.begin() + first, SkylineSegment{ x, top, rectangleWidth });
+
+		//the segments now (partly) underneath it:
+		size_t i = first + 1;
+		while (i < skyline.size() && skyline[i].x < right)
+		{
+			unsigned int segmentRight = skyline[i].x + skyline[i].width;
+
+			if (segmentRight <= right)
+			{
+				skyline.erase(skyline.begin() + i);
+			}
+			else
+			{
+				skyline[i].width = segmentRight - right;
+				skyline[i].x = right;
+				break;
+			}
+		}
+
+		//neighbours at the same height become one segment:
+		for (i = 0; i + 1 < skyline.size();)
+		{
+			if (skyline[i].y == skyline[i + 1].y)
+			{
+				skyline[i].width += skyline[i + 1].width;
+				skyline.erase(skyline.begin() + i + 1);
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+
+	template<typename T>
+	void appendRaw(string& bytes, const T& value)
+	{
+		bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	template<typename T>
+	T readRaw(const unsigned char* bytes)
+	{
+		T value;
+		std::memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+}
+
+SpriteAtlas SpriteAtlas::build(const vector<std::pair<string, ImageBMP>>& images, unsigned int atlasWidth, unsigned int padding)
+{
+	SpriteAtlas atlas;
+
+	//one entry per name (the first one), tallest first - tall sprites placed early leave a flatter skyline
+	//(equal sizes go by name, so the layout doesn't depend on the order a folder happened to list its files in):
+	vector<size_t> order;
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		if (atlas.index.emplace(images[i].first, AtlasRect()).second)
+		{
+			order.push_back(i);
+		}
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&images](size_t a, size_t b)
+		{
+			const InfoHeader& first = images[a].second.infoHeader;
+			const InfoHeader& second = images[b].second.infoHeader;
+
+			if (first.imageHeight != second.imageHeight)
+			{
+				return first.imageHeight > second.imageHeight;
+			}
+			if (first.imageWidth != second.imageWidth)
+			{
+				return first.imageWidth > second.imageWidth;
+			}
+			return images[a].first < images[b].first;
+		});
+
+	unsigned long long paddedArea = 0;
+	unsigned int widestSprite = 0;
+
+	for (size_t i : order)
+	{
+		const InfoHeader& header = images[i].second.infoHeader;
+		paddedArea += (unsigned long long)(header.imageWidth + padding) * (header.imageHeight + padding);
+		widestSprite = std::max(widestSprite, header.imageWidth + padding);
+	}
+
+	if (atlasWidth == 0)
+	{
+		atlasWidth = (unsigned int)std::ceil(std::sqrt((double)paddedArea));
+	}
+	atlasWidth = std::max(atlasWidth, widestSprite);
+
+	//place everything first (only rectangles), so the atlas is allocated once, at its final height:
+	vector<SkylineSegment> skyline{ SkylineSegment{ 0, 0, atlasWidth } };
+	unsigned int atlasHeight = 0;
+
+	for (size_t i : order)
+	{
+		const InfoHeader& header = images[i].second.infoHeader;
+		unsigned int paddedWidth = header.imageWidth + padding;
+		unsigned int paddedHeight = header.imageHeight + padding;
+
+		size_t bestSegment = 0;
+		unsigned int bestY = 0;
+		bool found = false;
+
+		for (size_t segment = 0; segment < skyline.size(); ++segment)
+		{
+			unsigned int y = 0;
+
+			if (fitOnSkyline(skyline, segment, paddedWidth, atlasWidth, y) && (!found || y < bestY))
+			{
+				bestSegment = segment;
+				bestY = y;
+				found = true;
+			}
+		}
+
+		//(always found: the atlas is at least as wide as the widest sprite, and segment 0 starts at x = 0)
+		atlas.index[images[i].first] = AtlasRect{ skyline[bestSegment].x, bestY, header.imageWidth, header.imageHeight };
+
+		addToSkyline(skyline, bestSegment, paddedWidth, bestY + paddedHeight);
+		atlasHeight = std::max(atlasHeight, bestY + paddedHeight);
+	}
+
+	atlas.width = atlasWidth;
+	atlas.height = atlasHeight;
+	atlas.ownPixels.assign(atlasWidth, atlasHeight, Color());
+	atlas.pixels = atlas.ownPixels.data();
+
+	for (size_t i : order)
+	{
+		const ImageBMP* image = &images[i].second;
+		ImageBMP expanded;
+
+		if (image->pixelData.storageFormat != PixelFormat::BGRA32 && !image->pixelData.isTiled())
+		{
+			expanded = image->clone();
+			expanded.expandPixelData();
+			image = &expanded;
+		}
+
+		const AtlasRect& rect = atlas.index[images[i].first];
+
+		for (unsigned int row = 0; row < rect.height; ++row)
+		{
+			Color* destination = atlas.pixels + (size_t)(rect.y + row) * atlasWidth + rect.x;
+
+			if (image->pixelData.isTiled())
+			{
+				image->pixelData.tiledPixels.copyRowTo(row, destination); //(gathered straight into the atlas)
+				continue;
+			}
+
+			PixelRow<const Color> source = image->pixelData.pixelMatrix[row];
+			std::copy(source.begin(), source.end(), destination);
+		}
+	}
+
+	return atlas;
+}
+
+SpriteAtlas SpriteAtlas::buildFromFolder(const string& folderName, unsigned int atlasWidth, unsigned int padding)
+{
+	return build(getAllNamedImagesInFolder(folderName), atlasWidth, padding);
+}
+
+SpriteAtlas SpriteAtlas::loadOrBuild(const string& atlasPath, const string& folderName)
+{
+	std::error_code error;
+	auto atlasTime = std::filesystem::last_write_time(atlasPath, error);
+
+	if (!error)
+	{
+		//(same folder convention as getAllImagesInFolder - relative to the current directory)
+		std::filesystem::path folderPath = std::filesystem::current_path().string() + folderName;
+
+		//the folder's own time changes when files are added, removed or renamed:
+		bool upToDate = std::filesystem::last_write_time(folderPath, error) <= atlasTime && !error;
+
+		for (auto it = std::filesystem::directory_iterator(folderPath, error); upToDate && !error && it != std::filesystem::directory_iterator(); it.increment(error))
+		{
+			upToDate = it->last_write_time(error) <= atlasTime && !error;
+		}
+
+		SpriteAtlas atlas;
+
+		if (upToDate && !error && atlas.load(atlasPath))
+		{
+			return atlas;
+		}
+	}
+
+	SpriteAtlas atlas = buildFromFolder(folderName);
+	atlas.save(atlasPath);
+
+	return atlas;
+}
+
+BMPStatus SpriteAtlas::save(const string& path) const
+{
+	string bytes(atlasMagic, sizeof(atlasMagic));
+	appendRaw(bytes, atlasVersion);
+	appendRaw(bytes, width);
+	appendRaw(bytes, height);
+	appendRaw(bytes, (unsigned int)index.size());
+	appendRaw(bytes, (unsigned long long)0); //(pixel offset - filled in below)
+
+	//sorted by name - the index is an unordered_map, and the same atlas should always make the same file
+	vector<const std::pair<const string, AtlasRect>*> entries;
+	entries.reserve(index.size());
+	for (const auto& entry : index)
+	{
+		entries.push_back(&entry);
+	}
+	std::sort(entries.begin(), entries.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+
+	for (const auto* entry : entries)
+	{
+		const string& name = entry->first;
+		const AtlasRect& rect = entry->second;
+
+		appendRaw(bytes, rect.x);
+		appendRaw(bytes, rect.y);
+		appendRaw(bytes, rect.width);
+		appendRaw(bytes, rect.height);
+		appendRaw(bytes, (unsigned int)name.size());
+		bytes += name;
+	}
+
+	unsigned long long pixelOffset = (bytes.size() + atlasPageSize - 1) / atlasPageSize * atlasPageSize;
+	std::memcpy(&bytes[24], &pixelOffset, sizeof(pixelOffset));
+	bytes.resize((size_t)pixelOffset, '\0');
+
+	ofstream fout{ path, std::ios::binary };
+
+	if (!fout)
+	{
+		return BMPError::CannotCreateFile;
+	}
+
+	fout.write(bytes.data(), (std::streamsize)bytes.size());
+	fout.write(reinterpret_cast<const char*>(pixels), (std::streamsize)((size_t)width * height * sizeof(Color)));
+	fout.close();
+
+	return fout.fail() ? BMPError::WriteFailed : BMPError::None;
+}
+
+BMPStatus SpriteAtlas::load(const string& path)
+{
+	*this = SpriteAtlas();
+
+	MappedFile file;
+	BMPStatus status = file.open(path);
+
+	if (!status)
+	{
+		return status;
+	}
+
+	const unsigned char* bytes = file.data();
+	size_t length = file.size();
+
+	if (length < atlasHeaderSize || std::memcmp(bytes, atlasMagic, sizeof(atlasMagic)) != 0
+		|| readRaw<unsigned int>(bytes + 8) != atlasVersion)
+	{
+		return length < sizeof(atlasMagic) ? BMPError::TruncatedHeader : BMPError::NotABMP;
+	}
+
+	unsigned int atlasWidth = readRaw<unsigned int>(bytes + 12);
+	unsigned int atlasHeight = readRaw<unsigned int>(bytes + 16);
+	unsigned int spriteCount = readRaw<unsigned int>(bytes + 20);
+	unsigned long long pixelOffset = readRaw<unsigned long long>(bytes + 24);
+
+	//(the index lies between the header and the pixels - so pixelOffset - position below never wraps)
+	if (pixelOffset % atlasPageSize != 0 || pixelOffset < atlasHeaderSize || pixelOffset > length)
+	{
+		return BMPError::BadPixelDataOffset;
+	}
+	//(width * height fits in 64 bits, width * height * 4 may not)
+	if ((unsigned long long)atlasWidth * atlasHeight > (length - pixelOffset) / sizeof(Color))
+	{
+		return BMPError::TruncatedPixelData;
+	}
+
+	std::unordered_map<string, AtlasRect> loadedIndex;
+	size_t position = atlasHeaderSize;
+
+	for (unsigned int i = 0; i < spriteCount; ++i)
+	{
+		if (pixelOffset - position < 20)
+		{
+			return BMPError::TruncatedHeader;
+		}
+
+		AtlasRect rect{ readRaw<unsigned int>(bytes + position), readRaw<unsigned int>(bytes + position + 4),
+			readRaw<unsigned int>(bytes + position + 8), readRaw<unsigned int>(bytes + position + 12) };
+		unsigned int nameLength = readRaw<unsigned int>(bytes + position + 16);
+		position += 20;
+
+		if (pixelOffset - position < nameLength)
+		{
+			return BMPError::TruncatedHeader;
+		}
+		if ((unsigned long long)rect.x + rect.width > atlasWidth || (unsigned long long)rect.y + rect.height > atlasHeight)
+		{
+			return BMPError::BadDimensions;
+		}
+
+		loadedIndex.emplace(string(reinterpret_cast<const char*>(bytes + position), nameLength), rect);
+		position += nameLength;
+	}
+
+	width = atlasWidth;
+	height = atlasHeight;
+	index = std::move(loadedIndex);
+	mappedFile = std::move(file);
+	pixels = reinterpret_cast<Color*>(mappedFile.data() + pixelOffset);
+
+	return BMPError::None;
+}
+
+const AtlasRect* SpriteAtlas::find(const string& name) const
+{
+	auto found = index.find(name);
+	return found == index.end() ? nullptr : &found->second;
+}
+
+ImageView SpriteAtlas::view()
+{
+	return ImageView(pixels, width, height, width);
+}
+
+ImageView SpriteAtlas::spriteView(const string& name)
+{
+	const AtlasRect* rect = find(name);
+
+	if (rect == nullptr)
+	{
+		return ImageView();
+	}
+	return view().subView(rect->x, rect->y, rect->width, rect->height);
+}
+
+bool SpriteAtlas::drawSprite(const string& name, const ImageView& target, int x, int y) const
+{
+	return drawSpriteClipped(name, target, x, y, nullptr);
+}
+
+bool SpriteAtlas::drawSprite(const string& name, ImageBMP& target, int x, int y) const
+{
+	return drawSpriteClipped(name, target, x, y, nullptr);
+}
+
+bool SpriteAtlas::drawSprite(const string& name, const ImageView& target, int x, int y, const Color& transparentColor) const
+{
+	return drawSpriteClipped(name, target, x, y, &transparentColor);
+}
+
+bool SpriteAtlas::drawSprite(const string& name, ImageBMP& target, int x, int y, const Color& transparentColor) const
+{
+	return drawSpriteClipped(name, target, x, y, &transparentColor);
+}
+
+bool SpriteAtlas::drawSpriteClipped(const string& name, const ImageView& target, int x, int y, const Color* transparentColor) const
+{
+	const AtlasRect* rect = find(name);
+
+	if (rect == nullptr)
+	{
+		return false;
+	}
+
+	//the part of the sprite that lands inside the target (64-bit, so x + width can't wrap):
+	long long firstCol = std::max<long long>(0, -(long long)x);
+	long long endCol = std::min<long long>(rect->width, (long long)target.getWidth() - x);
+	long long firstRow = std::max<long long>(0, -(long long)y);
+	long long endRow = std::min<long long>(rect->height, (long long)target.getHeight() - y);
+
+	//(entirely beside, above or below the target - the column range would be reversed)
+	if (firstCol >= endCol || firstRow >= endRow)
+	{
+		return true;
+	}
+
+	for (long long row = firstRow; row < endRow; ++row)
+	{
+		const Color* source = pixels + (size_t)(rect->y + row) * width + rect->x;
+		PixelRow<Color> destination = target[(unsigned int)(y + row)];
+
+		if (transparentColor == nullptr)
+		{
+			std::copy(source + firstCol, source + endCol, destination.begin() + (x + firstCol));
+			continue;
+		}
+
+		for (long long col = firstCol; col < endCol; ++col)
+		{
+			if (source[col].bgra != transparentColor->bgra)
+			{
+				destination[(size_t)(x + col)] = source[col];
+			}
+		}
+	}
+
+	return true;
+}
+
+bool SpriteAtlas::drawSpriteClipped(const string& name, ImageBMP& target, int x, int y, const Color* transparentColor) const
+{
+	const AtlasRect* rect = find(name);
+
+	if (rect == nullptr)
+	{
+		return false;
+	}
+
+	//a view of just the covered rectangle - so only that is marked dirty in the target:
+	long long left = std::max<long long>(x, 0);
+	long long bottom = std::max<long long>(y, 0);
+	long long right = std::min<long long>((long long)x + rect->width, target.infoHeader.imageWidth);
+	long long top = std::min<long long>((long long)y + rect->height, target.infoHeader.imageHeight);
+
+	if (left >= right || bottom >= top)
+	{
+		return true;
+	}
+
+	ImageView covered = target.view((unsigned int)left, (unsigned int)bottom, (unsigned int)(right - left), (unsigned int)(top - bottom));
+
+	return drawSpriteClipped(name, covered, (int)(x - left), (int)(y - bottom), transparentColor);
+}
+
+ImageBMP SpriteAtlas::toImageBMP() const
+{
+	ImageBMP image(width, height, Color());
+
+	if (width > 0 && height > 0)
+	{
+		std::copy(pixels, pixels + (size_t)width * height, image.pixelData.pixelMatrix.data());
+	}
+
+	return image;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include<string>
+#include<unordered_map>
+#include<utility>
+#include<vector>
+
+#include "ImageBMP.h"
+#include "MappedFile.h"
+
+/*where one sprite sits in the atlas (x = column, y = row, row 0 = bottom - like everywhere else)*/
+struct AtlasRect
+{
+	unsigned int x = 0;
+	unsigned int y = 0;
+	unsigned int width = 0;
+	unsigned int height = 0;
+};
+
+/*many small images (eg: the chess pieces) packed into ONE contiguous BGRA32 texture, with a name -> rectangle index
+
+	SpriteAtlas pieces = SpriteAtlas::loadOrBuild("pieces.atlas", "/pieces");
+	pieces.drawSprite("WKnight", board, x, y, Color(ColorEnum::WKnightBgrdColor));
+
+the atlas file is the index followed by the raw pixels, starting on a page boundary - load() maps it, so a warm start
+reads no more than the pages actually drawn from, and decodes nothing*/
+class SpriteAtlas
+{
+public:
+	SpriteAtlas() = default;
+
+	SpriteAtlas(SpriteAtlas&&) noexcept = default;
+	SpriteAtlas& operator=(SpriteAtlas&&) noexcept = default;
+
+	/*packs the images atlasWidth pixels wide (0 -> roughly square), tallest first, each at the lowest free spot along
+	the skyline (the top edge of what is packed so far) - `padding` empty pixels are kept between sprites
+	- the first image of any given name wins*/
+	static SpriteAtlas build(const vector<std::pair<string, ImageBMP>>& images, unsigned int atlasWidth = 0, unsigned int padding = 0);
+
+	/*every readable BMP in the folder, named after its file (see getAllNamedImagesInFolder)*/
+	static SpriteAtlas buildFromFolder(const string& folderName, unsigned int atlasWidth = 0, unsigned int padding = 0);
+
+	/*loads atlasPath if it is newer than every file in the folder; otherwise builds from the folder and saves to atlasPath
+	(failing to save only means the next start builds again)*/
+	static SpriteAtlas loadOrBuild(const string& atlasPath, const string& folderName);
+
+	BMPStatus save(const string& path) const;
+
+	/*maps the file - the pixels are not copied (drawing on the atlas changes only this process's copy of the pages)*/
+	BMPStatus load(const string& path);
+
+	/*nullptr if there is no sprite of that name*/
+	const AtlasRect* find(const string& name) const;
+
+	/*the whole atlas, or one sprite of it (an empty view if there is no such sprite)*/
+	ImageView view();
+	ImageView spriteView(const string& name);
+
+	/*copies the sprite to (x, y) of the target, clipped - false if there is no such sprite*/
+	bool drawSprite(const string& name, const ImageView& target, int x, int y) const;
+	bool drawSprite(const string& name, ImageBMP& target, int x, int y) const;
+
+	/*the same, leaving the target alone wherever the sprite is transparentColor (eg: the background around a chess piece)*/
+	bool drawSprite(const string& name, const ImageView& target, int x, int y, const Color& transparentColor) const;
+	bool drawSprite(const string& name, ImageBMP& target, int x, int y, const Color& transparentColor) const;
+
+	/*a copy of the whole atlas, eg: to look at with writeImageFile*/
+	ImageBMP toImageBMP() const;
+
+	unsigned int getWidth() const { return width; }
+	unsigned int getHeight() const { return height; }
+	size_t getSpriteCount() const { return index.size(); }
+	const std::unordered_map<string, AtlasRect>& getIndex() const { return index; }
+
+private:
+	bool drawSpriteClipped(const string& name, const ImageView& target, int x, int y, const Color* transparentColor) const;
+	bool drawSpriteClipped(const string& name, ImageBMP& target, int x, int y, const Color* transparentColor) const;
+
+	unsigned int width = 0;
+	unsigned int height = 0;
+	std::unordered_map<string, AtlasRect> index;
+
+	//the pixels are in ONE of these (built -> ownPixels, loaded -> mappedFile); `pixels` points at them either way
+	PixelMatrix ownPixels;
+	MappedFile mappedFile;
+	Color* pixels = nullptr;
+};
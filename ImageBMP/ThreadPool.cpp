@@ -0,0 +1,238 @@
+#include "ThreadPool.h"
+
+#include<algorithm>
+#include<exception>
+
+namespace
+{
+	//which pool (if any) the current thread works for, and its queue there:
+	thread_local const ThreadPool* currentPool = nullptr;
+	thread_local size_t currentQueue = 0;
+
+	//spreads the chunks of calls made from OUTSIDE the pool over the queues:
+	std::atomic<size_t> nextOutsideQueue{ 0 };
+}
+
+ThreadPool::ThreadPool(unsigned int workerCount)
+{
+	if (workerCount == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = (hardwareThreads > 1) ? hardwareThreads - 1 : 0;
+	}
+
+	for (unsigned int i = 0; i < workerCount; ++i)
+	{
+		queues.push_back(std::make_unique<TaskQueue>());
+	}
+
+	//(all queues exist before the first worker can try to steal from them)
+	for (unsigned int i = 0; i < workerCount; ++i)
+	{
+		workers.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+unsigned int ThreadPool::getWorkerCount() const
+{
+	return (unsigned int)workers.size();
+}
+
+void ThreadPool::workerLoop(size_t index)
+{
+	currentPool = this;
+	currentQueue = index;
+
+	while (true)
+	{
+		if (runOneTask(index))
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wakeUp.wait(lock, [this] { return stopping || queuedTasks > 0; });
+
+		if (stopping && queuedTasks == 0)
+		{
+			return;
+		}
+	}
+}
+
+bool ThreadPool::runOneTask(size_t preferredQueue)
+{
+	std::function<void()> task;
+
+	for (size_t attempt = 0; attempt < queues.size() && !task; ++attempt)
+	{
+		TaskQueue& queue = *queues[(preferredQueue + attempt) % queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (queue.tasks.empty())
+		{
+			continue;
+		}
+
+		//own queue: newest first; someone else's: oldest first
+		if (attempt == 0)
+		{
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+		}
+		else
+		{
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+		}
+	}
+
+	if (!task)
+	{
+		return false;
+	}
+
+	--queuedTasks;
+	task();
+	return true;
+}
+
+void ThreadPool::push(size_t queueIndex, std::function<void()> task)
+{
+	{
+		TaskQueue& queue = *queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+
+	++queuedTasks;
+
+	std::lock_guard<std::mutex> lock(sleepMutex);
+	wakeUp.notify_one();
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+	if (workers.empty())
+	{
+		task();
+		return;
+	}
+
+	size_t queueIndex = (currentPool == this) ? currentQueue : nextOutsideQueue++ % queues.size();
+	push(queueIndex, std::move(task));
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, const std::function<void(size_t)>& body, size_t grainSize)
+{
+	if (begin >= end)
+	{
+		return;
+	}
+
+	size_t count = end - begin;
+	grainSize = std::max<size_t>(grainSize, 1);
+
+	//a few chunks per thread, so a slow chunk can be balanced out by stealing the others:
+	size_t chunkCount = std::min((count + grainSize - 1) / grainSize, (workers.size() + 1) * 4);
+
+	if (workers.empty() || chunkCount <= 1)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			body(i);
+		}
+		return;
+	}
+
+	size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+	chunkCount = (count + chunkSize - 1) / chunkSize;
+
+	//what the chunks report back to this call
+	//(shared with the tasks - a worker may still be destroying its copy of a finished task after we have returned)
+	struct LoopState
+	{
+		std::atomic<size_t> remaining{ 0 };
+		std::mutex mutex;
+		std::condition_variable finished;
+		std::exception_ptr firstError;
+	};
+
+	auto state = std::make_shared<LoopState>();
+	state->remaining = chunkCount;
+
+	auto runChunk = [state, &body, begin, end, chunkSize](size_t chunk)
+	{
+		size_t chunkBegin = begin + chunk * chunkSize;
+		size_t chunkEnd = std::min(chunkBegin + chunkSize, end);
+
+		try
+		{
+			for (size_t i = chunkBegin; i < chunkEnd; ++i)
+			{
+				body(i);
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			if (!state->firstError)
+			{
+				state->firstError = std::current_exception();
+			}
+		}
+
+		if (--state->remaining == 0)
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->finished.notify_all();
+		}
+	};
+
+	size_t homeQueue = (currentPool == this) ? currentQueue : nextOutsideQueue++ % queues.size();
+
+	for (size_t chunk = 1; chunk < chunkCount; ++chunk)
+	{
+		push((homeQueue + chunk) % queues.size(), [runChunk, chunk] { runChunk(chunk); });
+	}
+
+	//the caller does the first chunk itself, then helps with whatever is still queued:
+	runChunk(0);
+
+	while (state->remaining > 0)
+	{
+		if (runOneTask(homeQueue))
+		{
+			continue;
+		}
+
+		//nothing left to take - the last chunks are running on other threads
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->finished.wait(lock, [&state] { return state->remaining == 0; });
+	}
+
+	if (state->firstError)
+	{
+		std::rethrow_exception(state->firstError);
+	}
+}
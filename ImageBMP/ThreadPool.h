@@ -0,0 +1,63 @@
+#pragma once
+
+#include<atomic>
+#include<condition_variable>
+#include<cstddef>
+#include<deque>
+#include<functional>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+/*a fixed set of worker threads, each with its own task queue
+- a worker takes from the BACK of its own queue (newest first - still warm in cache)
+and, when that is empty, steals from the FRONT of the others (oldest - usually the biggest piece of work left)
+- the thread that calls parallelFor works too, so calling it from inside a task (nested loops) can't deadlock*/
+class ThreadPool
+{
+public:
+	/*0 -> one worker per hardware thread, minus one for the caller (which joins in)*/
+	explicit ThreadPool(unsigned int workerCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/*the process-wide pool (created on first use)*/
+	static ThreadPool& shared();
+
+	unsigned int getWorkerCount() const;
+
+	/*calls body(i) for every i in [begin, end), spread over the workers, and returns when all are done
+	- indices are handed out in chunks of at least grainSize (use > 1 when body is tiny)
+	- the first exception thrown by body is rethrown here (the remaining chunks still run)*/
+	void parallelFor(size_t begin, size_t end, const std::function<void(size_t)>& body, size_t grainSize = 1);
+
+	/*runs `task` on some worker later (fire and forget - task must not throw)
+	- a pool with no workers runs it right away, on the calling thread*/
+	void submit(std::function<void()> task);
+
+private:
+	struct TaskQueue
+	{
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	void workerLoop(size_t index);
+
+	/*runs one task - from queue `preferredQueue` if it has any, otherwise stolen from another
+	- false if every queue was empty*/
+	bool runOneTask(size_t preferredQueue);
+
+	void push(size_t queueIndex, std::function<void()> task);
+
+	std::vector<std::unique_ptr<TaskQueue>> queues;
+	std::vector<std::thread> workers;
+
+	std::mutex sleepMutex;
+	std::condition_variable wakeUp;
+	std::atomic<size_t> queuedTasks{ 0 };
+	bool stopping = false; //(guarded by sleepMutex)
+};
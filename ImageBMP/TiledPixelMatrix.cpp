@@ -0,0 +1,191 @@
+#include "ImageBMP.h"
+#include "ThreadPool.h"
+
+#include<algorithm>
+
+TiledPixelMatrix::TiledPixelMatrix(unsigned int width, unsigned int height, const Color& fillColor)
+	: width(width), height(height),
+	tilesAcross((width + tileSize - 1) >> tileShift), tilesUp((height + tileSize - 1) >> tileShift)
+{
+	pixels.assign((size_t)tilesAcross * tilesUp * pixelsPerTile, fillColor);
+}
+
+TiledPixelMatrix TiledPixelMatrix::fromRows(const PixelMatrix& rows)
+{
+	TiledPixelMatrix tiled(rows.getWidth(), rows.getHeight());
+
+	//one row of tiles per task - every tile row is written by exactly one task:
+	ThreadPool::shared().parallelFor(0, tiled.tilesUp, [&](size_t tileY)
+		{
+			unsigned int firstRow = (unsigned int)tileY << tileShift;
+			unsigned int endRow = std::min(firstRow + tileSize, tiled.height);
+
+			for (unsigned int y = firstRow; y < endRow; ++y)
+			{
+				tiled.copyRowFrom(y, rows[y].data());
+			}
+		});
+
+	return tiled;
+}
+
+PixelMatrix TiledPixelMatrix::toRows() const
+{
+	PixelMatrix rows(width, height);
+
+	ThreadPool::shared().parallelFor(0, tilesUp, [&](size_t tileY)
+		{
+			unsigned int firstRow = (unsigned int)tileY << tileShift;
+			unsigned int endRow = std::min(firstRow + tileSize, height);
+
+			for (unsigned int y = firstRow; y < endRow; ++y)
+			{
+				copyRowTo(y, rows[y].data());
+			}
+		});
+
+	return rows;
+}
+
+void TiledPixelMatrix::copyRowTo(unsigned int y, Color* destination) const
+{
+	for (unsigned int tileX = 0; tileX < tilesAcross; ++tileX)
+	{
+		const Color* source = tileData(tileX, y >> tileShift) + ((size_t)(y & (tileSize - 1)) << tileShift);
+		destination = std::copy_n(source, tileWidth(tileX), destination);
+	}
+}
+
+void TiledPixelMatrix::copyRowFrom(unsigned int y, const Color* source)
+{
+	for (unsigned int tileX = 0; tileX < tilesAcross; ++tileX)
+	{
+		Color* destination = tileData(tileX, y >> tileShift) + ((size_t)(y & (tileSize - 1)) << tileShift);
+		unsigned int count = tileWidth(tileX);
+
+		std::copy_n(source, count, destination);
+		source += count;
+	}
+}
+
+void TiledPixelMatrix::release()
+{
+	//(clear() alone would keep the memory)
+	vector<Color>().swap(pixels);
+	width = 0;
+	height = 0;
+	tilesAcross = 0;
+	tilesUp = 0;
+}
+
+void TiledPixelMatrix::fillRectangle(int x0, int y0, unsigned int rectangleWidth, unsigned int rectangleHeight, const Color& color)
+{
+	long long left = std::max<long long>(x0, 0);
+	long long bottom = std::max<long long>(y0, 0);
+	long long right = std::min<long long>((long long)x0 + rectangleWidth, width);
+	long long top = std::min<long long>((long long)y0 + rectangleHeight, height);
+
+	if (left >= right || bottom >= top)
+	{
+		return;
+	}
+
+	//inside a single tile (small squares, short edges) - no per-tile bookkeeping:
+	if ((left >> tileShift) == ((right - 1) >> tileShift) && (bottom >> tileShift) == ((top - 1) >> tileShift))
+	{
+		Color* line = &(*this)((unsigned int)left, (unsigned int)bottom);
+		unsigned int spanWidth = (unsigned int)(right - left);
+
+		for (long long row = bottom; row < top; ++row, line += tileSize)
+		{
+			for (unsigned int col = 0; col < spanWidth; ++col)
+			{
+				line[col] = color;
+			}
+		}
+		return;
+	}
+
+	//tile by tile, so each tile's block is filled while it is in cache:
+	for (unsigned int tileY = (unsigned int)(bottom >> tileShift); tileY <= (unsigned int)((top - 1) >> tileShift); ++tileY)
+	{
+		long long tileBottom = (long long)tileY << tileShift;
+		long long fromRow = std::max(bottom, tileBottom) - tileBottom;
+		long long toRow = std::min(top, tileBottom + tileSize) - tileBottom;
+
+		for (unsigned int tileX = (unsigned int)(left >> tileShift); tileX <= (unsigned int)((right - 1) >> tileShift); ++tileX)
+		{
+			long long tileLeft = (long long)tileX << tileShift;
+			long long fromCol = std::max(left, tileLeft) - tileLeft;
+			long long toCol = std::min(right, tileLeft + tileSize) - tileLeft;
+
+			Color* line = tileData(tileX, tileY) + (fromRow << tileShift);
+
+			//(a plain loop - most spans here are short: outlines, columns, small squares)
+			for (long long row = fromRow; row < toRow; ++row, line += tileSize)
+			{
+				for (long long col = fromCol; col < toCol; ++col)
+				{
+					line[col] = color;
+				}
+			}
+		}
+	}
+}
+
+void TiledPixelMatrix::drawRectangleOutline(int x0, int y0, unsigned int rectangleWidth, unsigned int rectangleHeight, const Color& color)
+{
+	if (rectangleWidth == 0 || rectangleHeight == 0)
+	{
+		return;
+	}
+
+	//four 1-pixel-wide rectangles (each clipped on its own):
+	fillRectangle(x0, y0, rectangleWidth, 1, color);
+	fillRectangle(x0, y0 + (int)rectangleHeight - 1, rectangleWidth, 1, color);
+	fillRectangle(x0, y0, 1, rectangleHeight, color);
+	fillRectangle(x0 + (int)rectangleWidth - 1, y0, 1, rectangleHeight, color);
+}
+
+void TiledPixelMatrix::fillSquare(int x, int y, unsigned int thickness, const Color& color)
+{
+	fillRectangle(x - (int)thickness, y - (int)thickness, 2 * thickness + 1, 2 * thickness + 1, color);
+}
+
+TiledPixelMatrix TiledPixelMatrix::rotatedClockwise() const
+{
+	//(x, y) -> (y, width - 1 - x): the new image is height wide and width tall
+	TiledPixelMatrix rotated(height, width);
+
+	//one task per row of destination tiles - each destination tile is written by one task only
+	//(it reads one tile row of the source, from one source tile column - or two where width isn't a multiple of tileSize):
+	ThreadPool::shared().parallelFor(0, rotated.tilesUp, [&](size_t destinationTileY)
+		{
+			for (unsigned int destinationTileX = 0; destinationTileX < rotated.tilesAcross; ++destinationTileX)
+			{
+				//the destination tile's rows [y0, y0 + 64) are source columns width - 1 - y, its columns are source rows
+				unsigned int destinationBottom = (unsigned int)destinationTileY << tileShift;
+				unsigned int destinationLeft = destinationTileX << tileShift;
+
+				unsigned int rowCount = rotated.tileHeight((unsigned int)destinationTileY);
+				unsigned int colCount = rotated.tileWidth(destinationTileX);
+
+				Color* destination = rotated.tileData(destinationTileX, (unsigned int)destinationTileY);
+
+				for (unsigned int row = 0; row < rowCount; ++row)
+				{
+					unsigned int sourceX = width - 1 - (destinationBottom + row);
+					const Color* sourceColumn = &(*this)(sourceX, destinationLeft);
+
+					//down a source tile column - consecutive source rows are tileSize apart inside one tile
+					//(destinationLeft is a multiple of tileSize, and colCount never crosses into the next tile)
+					for (unsigned int col = 0; col < colCount; ++col)
+					{
+						destination[((size_t)row << tileShift) + col] = sourceColumn[(size_t)col << tileShift];
+					}
+				}
+			}
+		});
+
+	return rotated;
+}
@@ -0,0 +1,75 @@
+#include "TypedImage.h"
+
+AnyImage::AnyImage(PixelFormat format, unsigned int width, unsigned int height, const Color& fillColor)
+{
+	withPixelFormat(format, [&](auto formatTag)
+		{
+			using Format = decltype(formatTag);
+			image = TypedImage<Format>(width, height, fillColor);
+		});
+}
+
+PixelFormat AnyImage::getFormat() const
+{
+	return visit([](const auto& typedImage)
+		{
+			using Format = typename std::decay_t<decltype(typedImage)>::FormatType;
+			return Format::format;
+		});
+}
+
+unsigned int AnyImage::getWidth() const
+{
+	return visit([](const auto& typedImage) { return typedImage.getWidth(); });
+}
+
+unsigned int AnyImage::getHeight() const
+{
+	return visit([](const auto& typedImage) { return typedImage.getHeight(); });
+}
+
+void AnyImage::fill(const Color& color)
+{
+	visit([&](auto& typedImage) { typedImage.fill(color); });
+}
+
+void AnyImage::fillRectangle(int x0, int y0, unsigned int rectangleWidth, unsigned int rectangleHeight, const Color& color)
+{
+	visit([&](auto& typedImage)
+		{
+			using Format = typename std::decay_t<decltype(typedImage)>::FormatType;
+			typedImage.fillRectangle(x0, y0, rectangleWidth, rectangleHeight, Format::fromBGRA(color.bgra));
+		});
+}
+
+void AnyImage::blit(const AnyImage& source, int x, int y)
+{
+	//double dispatch - every (source, destination) pair gets its own converting blit:
+	std::visit([&](auto& destination, const auto& typedSource) { destination.blit(typedSource, x, y); }, image, source.image);
+}
+
+AnyImage AnyImage::convertTo(PixelFormat format) const
+{
+	return withPixelFormat(format, [&](auto formatTag)
+		{
+			using Format = decltype(formatTag);
+			return visit([](const auto& typedImage) { return AnyImage(typedImage.template convertTo<Format>()); });
+		});
+}
+
+BMPStatus AnyImage::readBMP(const string& filename, PixelFormat format)
+{
+	return withPixelFormat(format, [&](auto formatTag)
+		{
+			using Format = decltype(formatTag);
+			TypedImage<Format> typedImage;
+			BMPStatus status = typedImage.readBMP(filename);
+			image = std::move(typedImage);
+			return status;
+		});
+}
+
+BMPStatus AnyImage::writeBMP(const string& filename) const
+{
+	return visit([&](const auto& typedImage) { return typedImage.writeBMP(filename); });
+}
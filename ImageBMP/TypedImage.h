@@ -0,0 +1,418 @@
+#pragma once
+
+#include<utility>
+#include<variant>
+
+#include "ImageBMP.h"
+
+/*an image whose pixel format is fixed at compile time (see the Format structs in PixelFormat.h)
+- pixels are one contiguous block, row-major, bottom row first (same row order as ImageBMP and the BMP file)
+- x is the column and y is the row, like plotPixel in main.cpp
+- fills, blits, conversions and BMP I/O are all instantiated per format, so no loop checks the format per pixel*/
+template<typename Format>
+class TypedImage
+{
+	unsigned int width = 0;
+	unsigned int height = 0;
+	vector<typename Format::PixelType> pixels;
+
+	template<typename FileFormat>
+	BMPStatus readRowsFromFile(ifstream& fin, bool topDown);
+	BMPStatus readPalettedRowsFromFile(ifstream& fin, const vector<unsigned int>& palette, bool topDown);
+
+public:
+	using FormatType = Format;
+	using PixelType = typename Format::PixelType;
+
+	TypedImage() = default;
+
+	TypedImage(unsigned int width, unsigned int height, PixelType fillValue = PixelType{});
+
+	TypedImage(unsigned int width, unsigned int height, const Color& fillColor);
+
+	unsigned int getWidth() const { return width; }
+	unsigned int getHeight() const { return height; }
+
+	PixelType* row(unsigned int y) { return pixels.data() + (size_t)y * width; }
+	const PixelType* row(unsigned int y) const { return pixels.data() + (size_t)y * width; }
+
+	PixelType& at(unsigned int x, unsigned int y);
+	const PixelType& at(unsigned int x, unsigned int y) const;
+
+	void fill(PixelType value);
+	void fill(const Color& color) { fill(Format::fromBGRA(color.bgra)); }
+
+	/*clipped to the image - parts outside are silently skipped*/
+	void fillRectangle(int x0, int y0, unsigned int rectangleWidth, unsigned int rectangleHeight, PixelType value);
+
+	/*copies `source` with its bottom-left corner at (x, y), converting pixels if the formats differ (clipped)*/
+	template<typename SourceFormat>
+	void blit(const TypedImage<SourceFormat>& source, int x, int y);
+
+	template<typename OtherFormat>
+	TypedImage<OtherFormat> convertTo() const;
+
+	static TypedImage fromImageBMP(const ImageBMP& image);
+	ImageBMP toImageBMP() const;
+
+	/*any 32/24/16/8-bit file is converted to Format while reading
+	- headers are validated first (see BMPError for what gets rejected), and a file bigger than `limits` allows
+	fails with ExceedsDecodeLimits before its pixels are allocated*/
+	BMPStatus readBMP(const string& filename, const DecodeLimits& limits = DecodeLimits());
+
+	/*written as Format::FileFormat by default (8-bit with a gray palette for the gray formats)
+	- pass another file format to convert on the way out, eg: gray.writeBMP<FormatBGR24>("scan.bmp")*/
+	template<typename FileFormat = typename Format::FileFormat>
+	BMPStatus writeBMP(const string& filename) const;
+};
+
+/*single-channel mode for scans, masks and OCR input - 1 byte per pixel instead of 4*/
+using GrayImage = TypedImage<FormatGray8>;
+
+/*a runtime-selected format - wraps one TypedImage instantiation in a std::variant,
+so an operation dispatches ONCE on the format and then runs the specialized loop*/
+class AnyImage
+{
+public:
+	using Variant = std::variant<
+		TypedImage<FormatBGRA32>,
+		TypedImage<FormatBGR24>,
+		TypedImage<FormatRGB565>,
+		TypedImage<FormatRGB555>,
+		TypedImage<FormatGray8>,
+		TypedImage<FormatGray16>>;
+
+	AnyImage() = default;
+
+	AnyImage(PixelFormat format, unsigned int width, unsigned int height, const Color& fillColor = Color());
+
+	template<typename Format>
+	AnyImage(TypedImage<Format> image)
+		:image(std::move(image))
+	{
+	}
+
+	PixelFormat getFormat() const;
+	unsigned int getWidth() const;
+	unsigned int getHeight() const;
+
+	void fill(const Color& color);
+	void fillRectangle(int x0, int y0, unsigned int rectangleWidth, unsigned int rectangleHeight, const Color& color);
+	void blit(const AnyImage& source, int x, int y);
+
+	AnyImage convertTo(PixelFormat format) const;
+
+	BMPStatus readBMP(const string& filename, PixelFormat format);
+	BMPStatus writeBMP(const string& filename) const;
+
+	/*nullptr unless the image currently holds that format*/
+	template<typename Format>
+	TypedImage<Format>* getIf() { return std::get_if<TypedImage<Format>>(&image); }
+
+	template<typename Visitor>
+	decltype(auto) visit(Visitor&& visitor) { return std::visit(std::forward<Visitor>(visitor), image); }
+
+	template<typename Visitor>
+	decltype(auto) visit(Visitor&& visitor) const { return std::visit(std::forward<Visitor>(visitor), image); }
+
+private:
+	Variant image;
+};
+
+/*calls callback(FormatXxx{}) for the Format struct matching `format`*/
+template<typename Callback>
+decltype(auto) withPixelFormat(PixelFormat format, Callback&& callback)
+{
+	switch (format)
+	{
+	case PixelFormat::BGR24: return callback(FormatBGR24{});
+	case PixelFormat::RGB565: return callback(FormatRGB565{});
+	case PixelFormat::RGB555: return callback(FormatRGB555{});
+	case PixelFormat::Gray8: return callback(FormatGray8{});
+	case PixelFormat::Gray16: return callback(FormatGray16{});
+	default: return callback(FormatBGRA32{});
+	}
+}
+
+
+
+
+#pragma region TypedImage definitions
+
+template<typename Format>
+TypedImage<Format>::TypedImage(unsigned int width, unsigned int height, PixelType fillValue)
+	:width(width), height(height), pixels((size_t)width * height, fillValue)
+{
+}
+
+template<typename Format>
+TypedImage<Format>::TypedImage(unsigned int width, unsigned int height, const Color& fillColor)
+	:TypedImage(width, height, Format::fromBGRA(fillColor.bgra))
+{
+}
+
+template<typename Format>
+typename Format::PixelType& TypedImage<Format>::at(unsigned int x, unsigned int y)
+{
+	assert(x < width && y < height);
+	return pixels[(size_t)y * width + x];
+}
+
+template<typename Format>
+const typename Format::PixelType& TypedImage<Format>::at(unsigned int x, unsigned int y) const
+{
+	assert(x < width && y < height);
+	return pixels[(size_t)y * width + x];
+}
+
+template<typename Format>
+void TypedImage<Format>::fill(PixelType value)
+{
+	std::fill(pixels.begin(), pixels.end(), value);
+}
+
+template<typename Format>
+void TypedImage<Format>::fillRectangle(int x0, int y0, unsigned int rectangleWidth, unsigned int rectangleHeight, PixelType value)
+{
+	long long firstCol = std::max<long long>(x0, 0);
+	long long firstRow = std::max<long long>(y0, 0);
+	long long lastCol = std::min<long long>((long long)x0 + rectangleWidth, width);
+	long long lastRow = std::min<long long>((long long)y0 + rectangleHeight, height);
+
+	for (long long y = firstRow; y < lastRow; ++y)
+	{
+		std::fill(row((unsigned int)y) + firstCol, row((unsigned int)y) + lastCol, value);
+	}
+}
+
+template<typename Format>
+template<typename SourceFormat>
+void TypedImage<Format>::blit(const TypedImage<SourceFormat>& source, int x, int y)
+{
+	//the part of source that lands inside this image:
+	long long firstCol = std::max<long long>(-(long long)x, 0);
+	long long firstRow = std::max<long long>(-(long long)y, 0);
+	long long lastCol = std::min<long long>(source.getWidth(), (long long)width - x);
+	long long lastRow = std::min<long long>(source.getHeight(), (long long)height - y);
+
+	if (firstCol >= lastCol)
+	{
+		return;
+	}
+
+	for (long long sourceRow = firstRow; sourceRow < lastRow; ++sourceRow)
+	{
+		convertRow<SourceFormat, Format>(source.row((unsigned int)sourceRow) + firstCol,
+			row((unsigned int)(sourceRow + y)) + x + firstCol, (size_t)(lastCol - firstCol));
+	}
+}
+
+template<typename Format>
+template<typename OtherFormat>
+TypedImage<OtherFormat> TypedImage<Format>::convertTo() const
+{
+	TypedImage<OtherFormat> converted(width, height);
+
+	//rows are contiguous with no padding, so the whole image is one long row:
+	if (!pixels.empty())
+	{
+		convertRow<Format, OtherFormat>(pixels.data(), converted.row(0), pixels.size());
+	}
+
+	return converted;
+}
+
+template<typename Format>
+TypedImage<Format> TypedImage<Format>::fromImageBMP(const ImageBMP& image)
+{
+	TypedImage converted(image.infoHeader.imageWidth, image.infoHeader.imageHeight);
+
+	if (converted.pixels.empty())
+	{
+		return converted;
+	}
+
+	switch (image.pixelData.storageFormat)
+	{
+	case PixelFormat::RGB565:
+		convertRow<FormatRGB565, Format>(image.pixelData.packedPixels.data(), converted.pixels.data(), converted.pixels.size());
+		break;
+
+	case PixelFormat::RGB555:
+		convertRow<FormatRGB555, Format>(image.pixelData.packedPixels.data(), converted.pixels.data(), converted.pixels.size());
+		break;
+
+	default:
+		if (image.pixelData.isTiled())
+		{
+			//row by row, each gathered from the tiles first
+			vector<Color> row(converted.width);
+
+			for (unsigned int y = 0; y < converted.height; ++y)
+			{
+				image.pixelData.tiledPixels.copyRowTo(y, row.data());
+				convertRow<FormatBGRA32, Format>(reinterpret_cast<const unsigned int*>(row.data()),
+					converted.row(y), converted.width);
+			}
+			break;
+		}
+
+		//(pixelMatrix is one unpadded block, so the whole image converts as one long row)
+		convertRow<FormatBGRA32, Format>(reinterpret_cast<const unsigned int*>(image.pixelData.pixelMatrix.data()),
+			converted.pixels.data(), converted.pixels.size());
+		break;
+	}
+
+	return converted;
+}
+
+template<typename Format>
+ImageBMP TypedImage<Format>::toImageBMP() const
+{
+	ImageBMP image(width, height, Color());
+
+	convertRow<Format, FormatBGRA32>(pixels.data(), reinterpret_cast<unsigned int*>(image.pixelData.pixelMatrix.data()), pixels.size());
+
+	image.setOutputFormat(Format::FileFormat::format);
+
+	return image;
+}
+
+template<typename Format>
+template<typename FileFormat>
+BMPStatus TypedImage<Format>::readRowsFromFile(ifstream& fin, bool topDown)
+{
+	size_t bytesPerRow = ((size_t)width * FileFormat::bitsPerPixel + 31) / 32 * 4;
+	vector<unsigned char> rowBytes(bytesPerRow);
+
+	for (unsigned int fileRow = 0; fileRow < height; ++fileRow)
+	{
+		unsigned int y = topDown ? height - 1 - fileRow : fileRow;
+
+		fin.read(reinterpret_cast<char*>(rowBytes.data()), bytesPerRow);
+
+		if (fin.fail())
+		{
+			return BMPError::TruncatedPixelData;
+		}
+
+		convertRow<FileFormat, Format>(reinterpret_cast<const typename FileFormat::PixelType*>(rowBytes.data()), row(y), width);
+	}
+
+	return BMPError::None;
+}
+
+template<typename Format>
+BMPStatus TypedImage<Format>::readBMP(const string& filename, const DecodeLimits& limits)
+{
+	ifstream fin{ filename, std::ios::binary };
+
+	if (!fin)
+	{
+		return BMPError::FileNotFound;
+	}
+
+	ImageBMP headers;
+	BMPStatus status = headers.readHeadersFromFile(fin);
+
+	if (!status)
+	{
+		return status;
+	}
+
+	if (!limits.allows(headers.infoHeader.imageWidth, headers.infoHeader.imageHeight))
+	{
+		return BMPError::ExceedsDecodeLimits;
+	}
+
+	width = headers.infoHeader.imageWidth;
+	height = headers.infoHeader.imageHeight;
+	pixels.assign((size_t)width * height, PixelType{});
+
+	//(readHeadersFromFile has left `fin` at the first pixel row)
+	bool topDown = headers.infoHeader.isTopDown();
+
+	//one runtime decision per file - the row loops below are specialized on (file format, Format):
+	switch (headers.infoHeader.getBitsPerPixel())
+	{
+	case 32: return readRowsFromFile<FormatBGRA32>(fin, topDown);
+	case 24: return readRowsFromFile<FormatBGR24>(fin, topDown);
+	case 16:
+		switch (headers.infoHeader.getSixteenBitLayout())
+		{
+		case PixelFormat::RGB565: return readRowsFromFile<FormatRGB565>(fin, topDown);
+		case PixelFormat::RGB555: return readRowsFromFile<FormatRGB555>(fin, topDown);
+		default: return BMPError::UnsupportedCompression;
+		}
+	case 8: return readPalettedRowsFromFile(fin, headers.infoHeader.getColorPalette(), topDown);
+	default: return BMPError::UnsupportedBitDepth;
+	}
+}
+
+template<typename Format>
+BMPStatus TypedImage<Format>::readPalettedRowsFromFile(ifstream& fin, const vector<unsigned int>& palette, bool topDown)
+{
+	//the palette converted to Format once, so each pixel is a single table lookup:
+	array<PixelType, 256> lookup{};
+	for (size_t i = 0; i < palette.size() && i < lookup.size(); ++i)
+	{
+		lookup[i] = Format::fromBGRA(palette[i] | 0xFF'00'00'00);
+	}
+
+	size_t bytesPerRow = ((size_t)width * 8 + 31) / 32 * 4;
+	vector<unsigned char> rowBytes(bytesPerRow);
+
+	for (unsigned int fileRow = 0; fileRow < height; ++fileRow)
+	{
+		unsigned int y = topDown ? height - 1 - fileRow : fileRow;
+
+		fin.read(reinterpret_cast<char*>(rowBytes.data()), bytesPerRow);
+
+		if (fin.fail())
+		{
+			return BMPError::TruncatedPixelData;
+		}
+
+		PixelType* destination = row(y);
+		for (unsigned int x = 0; x < width; ++x)
+		{
+			destination[x] = lookup[rowBytes[x]];
+		}
+	}
+
+	return BMPError::None;
+}
+
+template<typename Format>
+template<typename FileFormat>
+BMPStatus TypedImage<Format>::writeBMP(const string& filename) const
+{
+	ofstream fout{ filename, std::ios::binary };
+
+	if (!fout)
+	{
+		return BMPError::CannotCreateFile;
+	}
+
+	//an ImageBMP without pixels, used only for its headers:
+	ImageBMP headers;
+	headers.infoHeader.imageWidth = width;
+	headers.infoHeader.imageHeight = height;
+	headers.setOutputFormat(FileFormat::format);
+	headers.writeHeadersToFile(fout);
+
+	size_t bytesPerRow = ((size_t)width * FileFormat::bitsPerPixel + 31) / 32 * 4;
+	vector<unsigned char> rowBytes(bytesPerRow, 0); //padding stays zero
+
+	for (unsigned int y = 0; y < height; ++y)
+	{
+		convertRow<Format, FileFormat>(row(y), reinterpret_cast<typename FileFormat::PixelType*>(rowBytes.data()), width);
+		fout.write(reinterpret_cast<const char*>(rowBytes.data()), bytesPerRow);
+	}
+
+	fout.close();
+
+	return fout.fail() ? BMPError::WriteFailed : BMPError::None;
+}
+
+#pragma endregion
@@ -20,6 +20,7 @@ public:
             return;
         }
         pixelData.pixelMatrix[y][x] = color;
+        markDirty(x, y, 1, 1);
     }
 
     // Draw a line from (x0, y0) to (x1, y1)
@@ -193,6 +194,8 @@ int main() {
             } else {
                 drawO(boardImage, row, col, cellSize, Color(ColorEnum::Blue));
             }
+            // Snapshot: only the rows this move touched are rewritten
+            boardImage.saveChanges("tictactoe.bmp");
             moves++;
             if (checkWin(board, currentPlayer)) {
                 cout << "Player " << currentPlayer << " wins!\n";
@@ -205,7 +208,7 @@ int main() {
             // Switch players.
             currentPlayer = (currentPlayer == 'X') ? 'O' : 'X';
         }
-        boardImage.writeImageFile("tictactoe.bmp");
+        boardImage.saveChanges("tictactoe.bmp");
         cout << "Tic Tac Toe board has been saved.\n";
     } else {
         cout << "Invalid option.\n";
@@ -0,0 +1,156 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../ImageBMP/ImageBMP.h"
+
+using namespace std;
+
+/*
+AllocationTest - checks that loading, scaling, copying and writing images make no buffer allocations beyond the ones
+they need (one per image buffer they produce), by replacing the global operator new and counting the big allocations
+
+    g++ -std=c++17 -O2 -pthread Tests/AllocationTest.cpp <the ImageBMP .cpp files, except main.cpp> -o AllocationTest
+    ./AllocationTest                (writes a few files to AllocationTest_scratch/ in the current folder, then deletes it)
+
+Prints one line per check and exits with 1 if any failed. "Big" means at least a quarter of the test image's pixel
+buffer - row buffers, headers, strings and thread pool tasks are all far below that, whole-image buffers never are.
+*/
+
+namespace {
+    const unsigned int imageWidth = 1000;
+    const unsigned int imageHeight = 800;
+    const size_t bigAllocation = (size_t)imageWidth * imageHeight * sizeof(Color) / 4;
+
+    atomic<size_t> bigAllocations{ 0 };
+    atomic<size_t> bigBytes{ 0 };
+
+    void* countedAllocation(size_t size) {
+        if (size >= bigAllocation) {
+            ++bigAllocations;
+            bigBytes += size;
+        }
+        if (void* memory = malloc(size > 0 ? size : 1)) {
+            return memory;
+        }
+        throw bad_alloc();
+    }
+
+    int failures = 0;
+
+    // runs `body` and checks how many big allocations it made
+    void expectBigAllocations(const string& name, size_t expected, const function<void()>& body) {
+        size_t before = bigAllocations;
+        body();
+        size_t made = bigAllocations - before;
+
+        bool passed = (made == expected);
+        failures += passed ? 0 : 1;
+        cout << (passed ? "PASS  " : "FAIL  ") << name << ": " << made << " buffer allocation(s), expected " << expected << "\n";
+    }
+}
+
+void* operator new(size_t size) { return countedAllocation(size); }
+void* operator new[](size_t size) { return countedAllocation(size); }
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete[](void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+void operator delete[](void* memory, size_t) noexcept { free(memory); }
+
+int main() {
+    // (under the current folder - the convention getAllImagesInFolder uses)
+    const string folderName = "/AllocationTest_scratch";
+    filesystem::path folder = filesystem::current_path().string() + folderName;
+    filesystem::create_directories(folder);
+    string path32 = (folder / "test32.bmp").string();
+    string path24 = (folder / "test24.bmp").string();
+
+    ImageBMP image;
+
+    expectBigAllocations("construct", 1, [&] {
+        image = ImageBMP(imageWidth, imageHeight, Color(10, 20, 30));
+    });
+
+    expectBigAllocations("move construct and move assign", 0, [&] {
+        ImageBMP moved(std::move(image));
+        image = std::move(moved);
+    });
+
+    expectBigAllocations("clone", 1, [&] {
+        ImageBMP copy = image.clone();
+    });
+
+    expectBigAllocations("write 32-bit", 0, [&] {
+        image.tryWriteImageFile(path32);
+    });
+
+    expectBigAllocations("write 24-bit", 0, [&] {
+        ImageBMP moved(std::move(image));
+        moved.setOutputFormat(PixelFormat::BGR24);
+        moved.tryWriteImageFile(path24);
+        moved.setOutputFormat(PixelFormat::BGRA32);
+        image = std::move(moved);
+    });
+
+    expectBigAllocations("read 32-bit", 1, [&] {
+        ImageBMP loaded;
+        loaded.tryReadImageBMP(path32);
+    });
+
+    expectBigAllocations("read 24-bit", 1, [&] {
+        ImageBMP loaded;
+        loaded.tryReadImageBMP(path24);
+    });
+
+    expectBigAllocations("doublescale", 1, [&] {
+        image.doublescaleImageBMP();
+    });
+
+    expectBigAllocations("write doubled", 0, [&] {
+        image.tryWriteImageFile(path32);
+    });
+
+    vector<unsigned char> encoded;
+    expectBigAllocations("encodeToBuffer (exact size)", 1, [&] {
+        image.encodeToBuffer(encoded);
+    });
+
+    expectBigAllocations("encodeToBuffer again (vector reused)", 0, [&] {
+        image.encodeToBuffer(encoded);
+    });
+
+    expectBigAllocations("decodeFromMemory", 1, [&] {
+        ImageBMP decoded;
+        decoded.decodeFromMemory(encoded.data(), encoded.size());
+    });
+
+    expectBigAllocations("images moved into a vector", 3, [&] {
+        vector<ImageBMP> images;
+        images.reserve(3);
+        for (int i = 0; i < 3; ++i) {
+            images.push_back(ImageBMP(imageWidth, imageHeight, Color()));
+        }
+        images.erase(images.begin()); // (the others move down - no copies)
+    });
+
+    expectBigAllocations("makePooled, released and made again", 1, [&] {
+        { ImageBMP canvas = ImageBMP::makePooled(imageWidth, imageHeight, Color()); }
+        { ImageBMP canvas = ImageBMP::makePooled(imageWidth, imageHeight, Color()); }
+    });
+
+    // (the folder holds test32.bmp and test24.bmp - one buffer each, moved into the result)
+    expectBigAllocations("getAllImagesInFolder", 2, [&] {
+        vector<ImageBMP> images = getAllImagesInFolder(folderName);
+    });
+
+    filesystem::remove_all(folder);
+
+    cout << (failures == 0 ? "all checks passed\n" : to_string(failures) + " check(s) failed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "../ImageBMP/ImageBMP.h"
+
+using namespace std;
+
+/*
+DecodeThroughput - decode speed regression test: decodes an in-memory 1920x1080 file of each bit depth
+(decodeFromMemory, so the disk is left out) and reports the decoded megapixels per second
+
+    g++ -std=c++17 -O2 -pthread Tests/DecodeThroughput.cpp <the ImageBMP .cpp files, except main.cpp> -o DecodeThroughput
+    ./DecodeThroughput --save baseline.txt            measure and record a baseline (on the machine that will check it)
+    ./DecodeThroughput --check baseline.txt [--tolerance 20]
+                                                      exits with 1 if any bit depth got more than 20% slower than recorded
+
+With no options it only prints the numbers. Each figure is the best of several rounds, to keep other load out of it.
+*/
+
+namespace {
+    const unsigned int imageWidth = 1920;
+    const unsigned int imageHeight = 1080;
+    const int rounds = 5;
+    const int decodesPerRound = 10;
+
+    struct FileKind {
+        string name;
+        PixelFormat format;
+    };
+
+    const vector<FileKind> fileKinds = {
+        { "32-bit", PixelFormat::BGRA32 },
+        { "24-bit", PixelFormat::BGR24 },
+        { "16-bit 565", PixelFormat::RGB565 },
+        { "16-bit 555", PixelFormat::RGB555 },
+        { "8-bit gray", PixelFormat::Gray8 },
+    };
+
+    // a gradient with some noise, so no format gets an easy all-one-color image
+    vector<unsigned char> makeFile(PixelFormat format) {
+        ImageBMP image(imageWidth, imageHeight, Color());
+        unsigned int noise = 12345;
+        for (unsigned int y = 0; y < imageHeight; ++y) {
+            for (unsigned int x = 0; x < imageWidth; ++x) {
+                noise = noise * 1103515245 + 12345;
+                image.pixelData.pixelMatrix[y][x] = Color((unsigned char)(x * 255 / imageWidth), (unsigned char)(y * 255 / imageHeight),
+                    (unsigned char)(noise >> 24), 255);
+            }
+        }
+        image.setOutputFormat(format);
+
+        vector<unsigned char> bytes;
+        image.encodeToBuffer(bytes);
+        return bytes;
+    }
+
+    // best-of-rounds megapixels per second, or 0 if the file didn't decode
+    double measure(const vector<unsigned char>& file) {
+        double best = 0;
+        for (int round = 0; round < rounds; ++round) {
+            auto start = chrono::steady_clock::now();
+            for (int i = 0; i < decodesPerRound; ++i) {
+                ImageBMP image;
+                if (!image.decodeFromMemory(file.data(), file.size())) {
+                    return 0;
+                }
+            }
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            best = max(best, (double)imageWidth * imageHeight * decodesPerRound / 1e6 / seconds);
+        }
+        return best;
+    }
+
+    // one "<megapixels per second> <name>" line per bit depth
+    bool readBaseline(const string& path, map<string, double>& baseline) {
+        ifstream fin(path);
+        double speed;
+        string name;
+        while (fin >> speed && (fin >> ws) && getline(fin, name)) {
+            baseline[name] = speed;
+        }
+        return !baseline.empty();
+    }
+
+    void printUsage() {
+        cerr << "usage: DecodeThroughput [--save <baseline file> | --check <baseline file> [--tolerance <percent>]]\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    string savePath;
+    string checkPath;
+    double tolerance = 20;
+
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+        if (argument == "--save" && i + 1 < argc) {
+            savePath = argv[++i];
+        } else if (argument == "--check" && i + 1 < argc) {
+            checkPath = argv[++i];
+        } else if (argument == "--tolerance" && i + 1 < argc) {
+            tolerance = stod(argv[++i]);
+        } else {
+            printUsage();
+            return 2;
+        }
+    }
+
+    map<string, double> baseline;
+    if (!checkPath.empty() && !readBaseline(checkPath, baseline)) {
+        cerr << "Cannot read a baseline from " << checkPath << "\n";
+        return 2;
+    }
+
+    map<string, double> measured;
+    int failures = 0;
+
+    for (const FileKind& kind : fileKinds) {
+        double speed = measure(makeFile(kind.format));
+        measured[kind.name] = speed;
+        cout << setw(12) << kind.name << ": " << fixed << setprecision(1) << speed << " Mpixels/s";
+
+        if (speed == 0) {
+            cout << "  FAIL (did not decode)";
+            ++failures;
+        } else if (baseline.count(kind.name)) {
+            double floor = baseline[kind.name] * (1 - tolerance / 100);
+            bool passed = speed >= floor;
+            failures += passed ? 0 : 1;
+            cout << (passed ? "  PASS" : "  FAIL") << " (baseline " << baseline[kind.name] << ", at least " << floor << ")";
+        }
+        cout << "\n";
+    }
+
+    if (!savePath.empty()) {
+        ofstream fout(savePath);
+        for (const auto& [name, speed] : measured) {
+            fout << speed << " " << name << "\n";
+        }
+        if (!fout) {
+            cerr << "Cannot write " << savePath << "\n";
+            return 2;
+        }
+    }
+
+    if (failures > 0) {
+        cout << failures << " bit depth(s) failed\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+#include "../ImageBMP/ImageBMP.h"
+
+using namespace std;
+
+/*
+FuzzDecode - libFuzzer harness for decodeFromMemory: any bytes must either decode or fail with a status,
+never crash, hang or read outside the buffer (run it under the sanitizers)
+
+    clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined Tests/FuzzDecode.cpp <the ImageBMP .cpp files, except main.cpp> -o FuzzDecode
+    ./FuzzDecode corpus/ -max_len=65536           (corpus/ can start with a few small .bmp files of each bit depth)
+
+Without libFuzzer (eg: to replay a crash with g++), add -DFUZZ_DECODE_MAIN and pass the files to decode:
+
+    g++ -std=c++17 -g -fsanitize=address,undefined -DFUZZ_DECODE_MAIN -pthread Tests/FuzzDecode.cpp <...> -o FuzzDecode
+    ./FuzzDecode crash-1234 small.bmp
+
+Whatever decodes must also encode, and decode again to the same size.
+*/
+
+namespace {
+    // small enough that one input can't make the fuzzer run out of memory (or spend seconds on one image)
+    const DecodeLimits fuzzLimits{ 4096, 4096, 4'000'000 };
+
+    void decodeAndCheck(const unsigned char* data, size_t size, bool keep16BitStorage) {
+        ImageBMP image;
+        if (!image.decodeFromMemory(data, size, keep16BitStorage, fuzzLimits)) {
+            return;
+        }
+
+        vector<unsigned char> encoded;
+        if (!image.encodeToBuffer(encoded)) {
+            abort();  // a decoded image must always be writable
+        }
+
+        ImageBMP again;
+        if (!again.decodeFromMemory(encoded.data(), encoded.size(), keep16BitStorage)
+            || again.infoHeader.imageWidth != image.infoHeader.imageWidth
+            || again.infoHeader.imageHeight != image.infoHeader.imageHeight) {
+            abort();  // ...and what it writes must read back
+        }
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    decodeAndCheck(data, size, false);
+    decodeAndCheck(data, size, true);
+    return 0;
+}
+
+#ifdef FUZZ_DECODE_MAIN
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        ifstream fin(argv[i], ios::binary);
+        vector<unsigned char> bytes((istreambuf_iterator<char>(fin)), istreambuf_iterator<char>());
+        LLVMFuzzerTestOneInput(bytes.data(), bytes.size());
+        cout << argv[i] << ": ok\n";
+    }
+    return 0;
+}
+#endif